@@ -0,0 +1,384 @@
+// Throughput of OBJLoader::Loader on synthetic OBJ files.
+//
+// For each scenario (shape of the file), the file is generated once, then loaded
+// with each parser mode: a first untimed load (file in the system cache), then
+// `repeat` timed loads. The load time, the peak resident memory, MB/s and
+// triangles/s are printed and written in a JSON file, to compare the runs.
+//
+// Usage: ObjLoaderBenchmark [options]
+//   --triangles N    Triangles per file (default 1000000)
+//   --repeat N       Timed loads per scenario and mode (default 5)
+//   --threads N      Loader::setThreadCount (default 0: one per hardware thread)
+//   --indexed        Load indexed meshes (Loader::setIndexed)
+//   --scenario NAME  Only run this scenario (can be repeated), see Scenarios below
+//   --dir PATH       Directory of the generated files (default: current directory)
+//   --output FILE    JSON results (default objloader_benchmark.json)
+//   --keep           Keep the generated files
+
+#include "OBJLoader.h"
+#include "SyntheticObj.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    struct Scenario
+    {
+        const char* name;
+        const char* description;
+        int polygonSides;
+        std::size_t groups;
+        std::size_t materials;
+        bool normals;
+        bool uvs;
+    };
+
+    const Scenario Scenarios[] = {
+        { "triangles",      "v/vt/vn triangles",                       3, 1,    0,  true,  true },
+        { "quads",          "v/vt/vn quads",                           4, 1,    0,  true,  true },
+        { "ngons",          "v/vt/vn octagons",                        8, 1,    0,  true,  true },
+        { "groups",         "1000 groups cycling over 16 materials",   3, 1000, 16, true,  true },
+        { "no_normals",     "v/vt triangles (normals generated)",      3, 1,    0,  false, true },
+        { "no_uvs",         "v//vn triangles",                         3, 1,    0,  true,  false },
+        { "positions_only", "v triangles (normals generated)",         3, 1,    0,  false, false },
+    };
+
+    struct Mode
+    {
+        const char* name;
+        OBJLoader::ParseMode mode;
+    };
+
+    const Mode Modes[] = {
+        { "Stream",   OBJLoader::ParseMode::Stream },
+        { "Mapped",   OBJLoader::ParseMode::Mapped },
+        { "Parallel", OBJLoader::ParseMode::Parallel },
+    };
+
+    struct Options
+    {
+        std::size_t triangles = 1000000;
+        std::size_t repeat = 5;
+        unsigned int threads = 0;
+        bool indexed = false;
+        std::vector<std::string> scenarios; // Empty: all
+        std::string dir = ".";
+        std::string output = "objloader_benchmark.json";
+        bool keep = false;
+    };
+
+    struct Result
+    {
+        const Scenario* scenario;
+        const Mode* mode;
+        SyntheticObjInfo file;
+        bool loaded = false;
+        std::size_t meshes = 0;
+        std::size_t triangles = 0; // Loaded
+        std::size_t vertices = 0;
+        std::vector<double> seconds;
+        std::size_t peakRss = 0; // Bytes
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Peak resident memory. On Linux the peak is reset before each load (/proc/self/clear_refs),
+    // elsewhere it is the peak of the whole process so far.
+    bool resetPeakRss()
+    {
+#if defined(__linux__)
+        std::FILE* file = std::fopen("/proc/self/clear_refs", "w");
+        if (file == nullptr)
+            return false;
+        const bool reset = std::fputs("5", file) >= 0;
+        return (std::fclose(file) == 0) && reset;
+#else
+        return false;
+#endif
+    }
+
+    std::size_t peakRss()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.PeakWorkingSetSize;
+        return 0;
+#else
+#if defined(__linux__)
+        std::FILE* file = std::fopen("/proc/self/status", "r");
+        if (file != nullptr) {
+            char line[256];
+            std::size_t kB = 0;
+            bool found = false;
+            while (!found && std::fgets(line, sizeof(line), file) != nullptr)
+                found = std::sscanf(line, "VmHWM: %zu kB", &kB) == 1;
+            std::fclose(file);
+            if (found)
+                return kB * 1024;
+        }
+#endif
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#if defined(__APPLE__)
+        return std::size_t(usage.ru_maxrss); // Bytes
+#else
+        return std::size_t(usage.ru_maxrss) * 1024; // kB
+#endif
+#endif
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double median(std::vector<double> values)
+    {
+        if (values.empty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        const std::size_t n = values.size();
+        return (n % 2 == 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+    }
+
+    std::string jsonString(const std::string& s)
+    {
+        std::string escaped = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+    bool parseCount(const char* arg, std::size_t& value)
+    {
+        char* end = nullptr;
+        const unsigned long long v = std::strtoull(arg, &end, 10);
+        if (end == arg || *end != '\0')
+            return false;
+        value = std::size_t(v);
+        return true;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            std::size_t count = 0;
+            if (arg == "--triangles" && hasValue && parseCount(argv[i + 1], count) && count > 0) {
+                options.triangles = count;
+                ++i;
+            }
+            else if (arg == "--repeat" && hasValue && parseCount(argv[i + 1], count) && count > 0) {
+                options.repeat = count;
+                ++i;
+            }
+            else if (arg == "--threads" && hasValue && parseCount(argv[i + 1], count)) {
+                options.threads = unsigned(count);
+                ++i;
+            }
+            else if (arg == "--indexed") {
+                options.indexed = true;
+            }
+            else if (arg == "--scenario" && hasValue) {
+                options.scenarios.push_back(argv[++i]);
+            }
+            else if (arg == "--dir" && hasValue) {
+                options.dir = argv[++i];
+            }
+            else if (arg == "--output" && hasValue) {
+                options.output = argv[++i];
+            }
+            else if (arg == "--keep") {
+                options.keep = true;
+            }
+            else {
+                std::cout << "Error: Invalid argument " << arg << std::endl;
+                return false;
+            }
+        }
+
+        for (const std::string& name : options.scenarios) {
+            const bool known = std::any_of(std::begin(Scenarios), std::end(Scenarios),
+                [&](const Scenario& s) { return name == s.name; });
+            if (!known) {
+                std::cout << "Error: Unknown scenario " << name << " (";
+                for (const Scenario& s : Scenarios)
+                    std::cout << " " << s.name;
+                std::cout << " )" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // One load of the file, timed (the meshes are counted and freed after)
+    double load(const std::string& filename, const Mode& mode, const Options& options, Result& result)
+    {
+        resetPeakRss();
+        const auto start = std::chrono::steady_clock::now();
+        OBJLoader::Loader loader;
+        loader.setIndexed(options.indexed);
+        loader.setThreadCount(options.threads);
+        result.loaded = loader.loadFile(filename, mode.mode);
+        const auto end = std::chrono::steady_clock::now();
+        result.peakRss = std::max(result.peakRss, peakRss());
+
+        result.meshes = loader.getMeshes().size();
+        result.triangles = 0;
+        result.vertices = 0;
+        for (const OBJLoader::Mesh& mesh : loader.getMeshes()) {
+            result.triangles += mesh.numElements() / 3;
+            result.vertices += mesh.vertices.size();
+        }
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    bool writeJson(const std::string& filename, const Options& options, bool peakPerLoad, const std::vector<Result>& results)
+    {
+        std::ofstream file(filename);
+        if (!file)
+            return false;
+
+        char date[32] = "";
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+#ifdef NDEBUG
+        const bool optimized = true;
+#else
+        const bool optimized = false;
+#endif
+
+        file << "{\n";
+        file << "  \"date\": " << jsonString(date) << ",\n";
+        file << "  \"config\": {\n";
+        file << "    \"triangles\": " << options.triangles << ",\n";
+        file << "    \"repeat\": " << options.repeat << ",\n";
+        file << "    \"threads\": " << options.threads << ",\n";
+        file << "    \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+        file << "    \"indexed\": " << (options.indexed ? "true" : "false") << ",\n";
+        file << "    \"optimizedBuild\": " << (optimized ? "true" : "false") << ",\n";
+        file << "    \"peakRssScope\": " << (peakPerLoad ? "\"load\"" : "\"process\"") << "\n";
+        file << "  },\n";
+        file << "  \"results\": [";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            const double med = median(r.seconds);
+            const double best = r.seconds.empty() ? 0.0 : *std::min_element(r.seconds.begin(), r.seconds.end());
+            file << (i == 0 ? "\n" : ",\n");
+            file << "    {\n";
+            file << "      \"scenario\": " << jsonString(r.scenario->name) << ",\n";
+            file << "      \"mode\": " << jsonString(r.mode->name) << ",\n";
+            file << "      \"loaded\": " << (r.loaded ? "true" : "false") << ",\n";
+            file << "      \"fileBytes\": " << r.file.bytes << ",\n";
+            file << "      \"fileTriangles\": " << r.file.triangles << ",\n";
+            file << "      \"meshes\": " << r.meshes << ",\n";
+            file << "      \"triangles\": " << r.triangles << ",\n";
+            file << "      \"vertices\": " << r.vertices << ",\n";
+            file << "      \"seconds\": [";
+            for (std::size_t k = 0; k < r.seconds.size(); ++k)
+                file << (k == 0 ? "" : ", ") << r.seconds[k];
+            file << "],\n";
+            file << "      \"bestSeconds\": " << best << ",\n";
+            file << "      \"medianSeconds\": " << med << ",\n";
+            file << "      \"mbPerSecond\": " << (med > 0.0 ? double(r.file.bytes) / 1e6 / med : 0.0) << ",\n";
+            file << "      \"trianglesPerSecond\": " << (med > 0.0 ? double(r.triangles) / med : 0.0) << ",\n";
+            file << "      \"peakRssBytes\": " << r.peakRss << "\n";
+            file << "    }";
+        }
+        file << "\n  ]\n}\n";
+        return bool(file);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+#ifndef NDEBUG
+    std::cout << "Warning: Not an optimized build, the timings are not representative" << std::endl;
+#endif
+    const bool peakPerLoad = resetPeakRss();
+
+    std::vector<Result> results;
+    std::printf("%-15s %-9s %10s %12s %10s %10s %14s %10s\n",
+        "scenario", "mode", "MB", "triangles", "median ms", "MB/s", "triangles/s", "peak MB");
+    for (const Scenario& scenario : Scenarios) {
+        if (!options.scenarios.empty() &&
+            std::find(options.scenarios.begin(), options.scenarios.end(), scenario.name) == options.scenarios.end())
+            continue;
+
+        // Generate the file
+        SyntheticObjOptions objOptions;
+        objOptions.triangles = options.triangles;
+        objOptions.polygonSides = scenario.polygonSides;
+        objOptions.groups = scenario.groups;
+        objOptions.materials = scenario.materials;
+        objOptions.normals = scenario.normals;
+        objOptions.uvs = scenario.uvs;
+        const std::string filename = options.dir + "/objloader_benchmark_" + scenario.name + ".obj";
+        SyntheticObjInfo info;
+        if (!writeSyntheticObj(filename, objOptions, info))
+            return 1;
+
+        for (const Mode& mode : Modes) {
+            Result result;
+            result.scenario = &scenario;
+            result.mode = &mode;
+            result.file = info;
+
+            // Warm up (file in the system cache), then the timed loads
+            load(filename, mode, options, result);
+            result.peakRss = 0;
+            for (std::size_t i = 0; i < options.repeat && result.loaded; ++i)
+                result.seconds.push_back(load(filename, mode, options, result));
+
+            const double med = median(result.seconds);
+            if (!result.loaded)
+                std::cout << "Error: " << mode.name << " failed to load " << filename << std::endl;
+            else if (result.triangles != info.triangles)
+                std::cout << "Warning: " << result.triangles << " triangles loaded instead of " << info.triangles << std::endl;
+            std::printf("%-15s %-9s %10.1f %12zu %10.1f %10.1f %14.0f %10.1f\n",
+                scenario.name, mode.name, double(info.bytes) / 1e6, result.triangles, 1000.0 * med,
+                med > 0.0 ? double(info.bytes) / 1e6 / med : 0.0,
+                med > 0.0 ? double(result.triangles) / med : 0.0,
+                double(result.peakRss) / 1e6);
+            std::fflush(stdout);
+            results.push_back(std::move(result));
+        }
+
+        if (!options.keep) {
+            std::remove(filename.c_str());
+            if (scenario.materials != 0)
+                std::remove((filename + ".mtl").c_str());
+        }
+    }
+
+    if (!writeJson(options.output, options, peakPerLoad, results)) {
+        std::cout << "Error: Cannot write " << options.output << std::endl;
+        return 1;
+    }
+    std::cout << "Results written in " << options.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "SyntheticObj.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+
+    // Height field over [-1, 1] x [-1, 1] (y up), with its normal
+    float height(double x, double z)
+    {
+        return float(0.05 * std::sin(6.0 * x) * std::cos(6.0 * z));
+    }
+
+    void normal(double x, double z, float n[3])
+    {
+        const double dx = 0.3 * std::cos(6.0 * x) * std::cos(6.0 * z);
+        const double dz = -0.3 * std::sin(6.0 * x) * std::sin(6.0 * z);
+        const double length = std::sqrt(dx * dx + 1.0 + dz * dz);
+        n[0] = float(-dx / length);
+        n[1] = float(1.0 / length);
+        n[2] = float(-dz / length);
+    }
+
+    // fprintf counting the written bytes
+    class Writer
+    {
+    public:
+        explicit Writer(std::FILE* file) : m_file(file) {}
+
+        template <typename... Args>
+        void print(const char* format, Args... args) {
+            const int n = std::fprintf(m_file, format, args...);
+            if (n < 0)
+                m_failed = true;
+            else
+                m_bytes += std::size_t(n);
+        }
+
+        // v, v/vt, v//vn or v/vt/vn (the three indices are the same)
+        void corner(std::size_t index, bool uvs, bool normals) {
+            if (uvs && normals)
+                print(" %zu/%zu/%zu", index, index, index);
+            else if (uvs)
+                print(" %zu/%zu", index, index);
+            else if (normals)
+                print(" %zu//%zu", index, index);
+            else
+                print(" %zu", index);
+        }
+
+        void vertex(double x, double z, bool uvs, bool normals) {
+            print("v %.6f %.6f %.6f\n", x, double(height(x, z)), z);
+            if (uvs)
+                print("vt %.6f %.6f\n", 0.5 * (x + 1.0), 0.5 * (z + 1.0));
+            if (normals) {
+                float n[3];
+                normal(x, z, n);
+                print("vn %.6f %.6f %.6f\n", double(n[0]), double(n[1]), double(n[2]));
+            }
+        }
+
+        std::size_t bytes() const { return m_bytes; }
+        bool failed() const { return m_failed || std::ferror(m_file) != 0; }
+
+    private:
+        std::FILE* m_file;
+        std::size_t m_bytes = 0;
+        bool m_failed = false;
+    };
+
+    bool writeMtl(const std::string& filename, std::size_t materials)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        Writer writer(file);
+        for (std::size_t m = 0; m < materials; ++m) {
+            const double t = double(m) / double(materials);
+            writer.print("newmtl material%zu\n", m);
+            writer.print("Kd %.3f %.3f %.3f\nKs 0.5 0.5 0.5\nNs 32\n\n", t, 1.0 - t, 0.5);
+        }
+        const bool failed = writer.failed();
+        return std::fclose(file) == 0 && !failed;
+    }
+}
+
+bool writeSyntheticObj(const std::string& filename, const SyntheticObjOptions& options, SyntheticObjInfo& info)
+{
+    info = SyntheticObjInfo();
+    const std::size_t sides = std::size_t(std::max(options.polygonSides, 3));
+    const bool sharedVertices = sides <= 4;
+
+    // One cell of the grid per n-gon, per quad or per pair of triangles
+    const std::size_t trianglesPerCell = sharedVertices ? 2 : sides - 2;
+    const std::size_t cells = std::max<std::size_t>(1, (options.triangles + trianglesPerCell - 1) / trianglesPerCell);
+    const std::size_t width = std::size_t(std::ceil(std::sqrt(double(cells))));
+    const std::size_t depth = (cells + width - 1) / width;
+    const double cellSize = 2.0 / double(std::max(width, depth));
+    const std::size_t facesPerCell = (sides == 3) ? 2 : 1;
+    const std::size_t numFaces = cells * facesPerCell;
+    const std::size_t groups = std::clamp<std::size_t>(options.groups, 1, numFaces);
+
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Error: Cannot write " << filename << std::endl;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    Writer writer(file);
+
+    writer.print("# Synthetic OBJ file: %zu faces of %zu vertices\n", numFaces, sides);
+    std::string mtlFilename;
+    if (options.materials != 0) {
+        mtlFilename = filename + ".mtl";
+        const std::size_t slash = mtlFilename.find_last_of("/\\");
+        writer.print("mtllib %s\n", mtlFilename.substr(slash == std::string::npos ? 0 : slash + 1).c_str());
+    }
+
+    // Vertices
+    if (sharedVertices) {
+        for (std::size_t j = 0; j <= depth; ++j)
+            for (std::size_t i = 0; i <= width; ++i)
+                writer.vertex(-1.0 + i * cellSize, -1.0 + j * cellSize, options.uvs, options.normals);
+    }
+    else {
+        for (std::size_t c = 0; c < cells; ++c) {
+            const double cx = -1.0 + (double(c % width) + 0.5) * cellSize;
+            const double cz = -1.0 + (double(c / width) + 0.5) * cellSize;
+            // Clockwise in the xz plane, so the faces point up
+            for (std::size_t k = 0; k < sides; ++k) {
+                const double angle = -2.0 * Pi * double(k) / double(sides);
+                writer.vertex(cx + 0.45 * cellSize * std::cos(angle), cz + 0.45 * cellSize * std::sin(angle), options.uvs, options.normals);
+            }
+        }
+    }
+
+    // Faces, spread evenly between the groups
+    std::size_t group = 0;
+    for (std::size_t f = 0; f < numFaces; ++f) {
+        if (f == group * numFaces / groups) {
+            writer.print("g group%zu\n", group);
+            if (options.materials != 0)
+                writer.print("usemtl material%zu\n", group % options.materials);
+            ++group;
+        }
+
+        const std::size_t c = f / facesPerCell;
+        writer.print("f");
+        if (sharedVertices) {
+            // Quad (a, b, c, d), counterclockwise seen from above (1-based indices)
+            const std::size_t i = c % width, j = c / width;
+            const std::size_t a = j * (width + 1) + i + 1;
+            const std::size_t b = a + width + 1;
+            const std::size_t quad[4] = { a, b, b + 1, a + 1 };
+            if (sides == 4) {
+                for (std::size_t k = 0; k < 4; ++k)
+                    writer.corner(quad[k], options.uvs, options.normals);
+            }
+            else {
+                const std::size_t first = (f % 2 == 0) ? 1 : 2;
+                writer.corner(quad[0], options.uvs, options.normals);
+                writer.corner(quad[first], options.uvs, options.normals);
+                writer.corner(quad[first + 1], options.uvs, options.normals);
+            }
+        }
+        else {
+            for (std::size_t k = 0; k < sides; ++k)
+                writer.corner(c * sides + k + 1, options.uvs, options.normals);
+        }
+        writer.print("\n");
+    }
+
+    const bool failed = writer.failed();
+    if (std::fclose(file) != 0 || failed) {
+        std::cout << "Error: Cannot write " << filename << std::endl;
+        return false;
+    }
+    if (options.materials != 0 && !writeMtl(mtlFilename, options.materials)) {
+        std::cout << "Error: Cannot write " << mtlFilename << std::endl;
+        return false;
+    }
+
+    info.bytes = writer.bytes();
+    info.faces = numFaces;
+    info.triangles = cells * trianglesPerCell;
+    return true;
+}
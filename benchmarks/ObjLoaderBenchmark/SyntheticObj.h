@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Shape of a generated OBJ file: a wavy height field of about `triangles` triangles,
+// with a position, normal and uv per vertex.
+struct SyntheticObjOptions
+{
+    std::size_t triangles = 1000000; // Once triangulated (rounded to whole faces)
+    int polygonSides = 3;            // 3: triangles, 4: quads sharing the grid vertices,
+                                     // more: separate convex n-gons (fans of polygonSides - 2 triangles)
+    std::size_t groups = 1;          // g statements, the faces are spread evenly between them
+    std::size_t materials = 0;       // usemtl statements cycled over the groups, with a .mtl file (0: none)
+    bool normals = true;             // vn statements (without them, the loader generates the normals)
+    bool uvs = true;                 // vt statements
+};
+
+// Result of writeSyntheticObj
+struct SyntheticObjInfo
+{
+    std::size_t bytes = 0;     // Size of the OBJ file
+    std::size_t triangles = 0; // Triangles once the faces are triangulated
+    std::size_t faces = 0;
+};
+
+// Write the OBJ file (and filename.mtl when options.materials != 0).
+// Return false if the file cannot be written.
+bool writeSyntheticObj(const std::string& filename, const SyntheticObjOptions& options, SyntheticObjInfo& info);
@@ -13,6 +13,7 @@
 #include <glm/gtx/euler_angles.hpp>
 
 #include "OBJLoader.h"
+#include "MeshOptimizer.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
@@ -111,13 +112,22 @@ int MainWindow::InitializeGL()
 		return 4;
 	}
 
-	OBJLoader::Loader object(directory + "susane.obj");
+	// Indexed: vertices shared by several triangles are stored once
+	OBJLoader::Loader object;
+	object.setIndexed(true);
+	object.loadFile(directory + "susane.obj");
 	if (!object.isLoaded()) {
 		std::cerr << "Impossible de load the object (susane.obj)\n";
 		return 5;
 	}
 	std::cout << "Object loaded\n";
 
+	// Reorder the triangles and vertices for the GPU caches
+	std::vector<OBJLoader::MeshOptimizationStats> stats;
+	object.optimizeMeshes(&stats);
+	std::cout << "Vertex cache: ACMR " << stats[0].before.acmr << " -> " << stats[0].after.acmr
+		<< ", ATVR " << stats[0].before.atvr << " -> " << stats[0].after.atvr << "\n";
+
 	// Get the first mesh
 	OBJLoader::Mesh m = object.getMeshes()[0];
 	const float scale = 0.7f;
@@ -125,12 +135,14 @@ int MainWindow::InitializeGL()
 	// -- Put all vertices inside a vector
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;
-	m_nbVertices = 0;
 	for (const OBJLoader::Vertex& v : m.vertices) {
 		positions.push_back(glm::vec3(v.position[0], v.position[1], v.position[2]) * scale + offset);
 		normals.push_back(glm::vec3(v.normal[0], v.normal[1], v.normal[2]));
-		m_nbVertices += 1;
 	}
+	// -- Indices (16 or 32 bits)
+	std::vector<std::uint8_t> indices = m.packedIndices();
+	m_nbVertices = m.numElements();
+	m_indexType = m.indexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	glCreateVertexArrays(NumVAOs, m_VAOs);
 	glCreateBuffers(NumBuffers, m_VBOs);
@@ -139,6 +151,8 @@ int MainWindow::InitializeGL()
 		positions.data(), GL_STATIC_DRAW);
 	glNamedBufferData(m_VBOs[Normal], sizeof(glm::vec3) * normals.size(),
 		normals.data(), GL_STATIC_DRAW);
+	glNamedBufferData(m_VBOs[Indices], indices.size(), indices.data(), GL_STATIC_DRAW);
+	glVertexArrayElementBuffer(m_VAOs[Triangles], m_VBOs[Indices]);
 	std::cout << "Data transfered\n";
 
 	// Position
@@ -245,7 +259,7 @@ void MainWindow::RenderScene()
 
 	m_mainShader->setMat4(SHADER_MATRIX, m);
 	m_mainShader->setMat3(SHADER_MATRIX_NORMAL, glm::inverseTranspose(glm::mat3(m)));
-	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)m_nbVertices);
+	glDrawElements(GL_TRIANGLES, (GLsizei)m_nbVertices, m_indexType, nullptr);
 
 	if (m_showNormal) {
 		m_normalShader->bind();
@@ -253,7 +267,7 @@ void MainWindow::RenderScene()
 		m_normalShader->setMat3(SHADER_MATRIX_NORMAL, glm::inverseTranspose(glm::mat3(m)));
 		m_normalShader->setFloat(SHADER_SCALE, m_scale);
 		m_normalShader->setBool(SHADER_SHOWCENTER, m_showCenter);
-		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)m_nbVertices);
+		glDrawElements(GL_TRIANGLES, (GLsizei)m_nbVertices, m_indexType, nullptr);
 	}
 }
 
@@ -50,8 +50,9 @@ private:
 	float m_scale = 0.3f;
 
 	enum VAO_IDs { Triangles, NumVAOs };
-	enum Buffer_IDs { Position, Normal, NumBuffers };
-	size_t m_nbVertices = 3; 
+	enum Buffer_IDs { Position, Normal, Indices, NumBuffers };
+	size_t m_nbVertices = 3; // Number of indices
+	GLenum m_indexType = GL_UNSIGNED_INT;
 
 	GLuint m_VAOs[NumVAOs];
 	GLuint m_VBOs[NumBuffers];
@@ -9,8 +9,11 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "OBJLoader.h"
+#include "AsyncMeshLoader.h"
+#include "Camera.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
@@ -98,7 +101,7 @@ int MainWindow::InitializeGL()
 	const std::string directory = SHADERS_DIR;
 	m_mainShader = std::make_unique<ShaderProgram>();
 	bool mainShaderSuccess = true;
-	mainShaderSuccess &= m_mainShader->addShaderFromSource(GL_VERTEX_SHADER, directory + "basicShader.vert");
+	mainShaderSuccess &= m_mainShader->addShaderFromSource(GL_VERTEX_SHADER, directory + (m_quantizedVertices ? "basicShaderQuantized.vert" : "basicShader.vert"));
 	mainShaderSuccess &= m_mainShader->addShaderFromSource(GL_FRAGMENT_SHADER, directory + "basicShader.frag");
 	mainShaderSuccess &= m_mainShader->link();
 	if (!mainShaderSuccess) {
@@ -119,6 +122,21 @@ int MainWindow::InitializeGL()
 		return 5;
 	}
 
+	// Cluster culling shader
+	m_cullShader = std::make_unique<ShaderProgram>();
+	bool cullShaderSuccess = true;
+	cullShaderSuccess &= m_cullShader->addShaderFromSource(GL_COMPUTE_SHADER, directory + "clusterCull.comp");
+	cullShaderSuccess &= m_cullShader->link();
+	if (!cullShaderSuccess) {
+		std::cerr << "Error when loading cluster culling shader\n";
+		return 6;
+	}
+	for (StatsBuffer& stats : m_clusterStats)
+	{
+		glCreateBuffers(1, &stats.buffer);
+		glNamedBufferStorage(stats.buffer, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
 	// Load the 3D model from the obj file
 	loadObjFile();
 
@@ -141,6 +159,12 @@ void MainWindow::RenderImgui()
 
 		ImGui::Begin("Obj View");
 		
+		if (m_meshLoader && !m_meshLoader->isDone()) {
+			ImGui::Text("Loading model");
+			ImGui::ProgressBar(m_meshLoader->progress());
+			ImGui::Separator();
+		}
+
 		ImGui::Text("Camera settings");
 		bool updateCamera = ImGui::SliderFloat("Longitude", &m_longitude, -180.f, 180.f);
 		updateCamera |= ImGui::SliderFloat("Latitude", &m_latitude, -89.f, 89.f);
@@ -156,6 +180,22 @@ void MainWindow::RenderImgui()
 			m_light_position = m_eye;
 		}
 
+		ImGui::Separator();
+		ImGui::Text("Culled meshes: %zu / %zu", m_culledMeshes, m_meshesGL.size());
+
+		ImGui::Separator();
+		ImGui::Text("Levels of detail");
+		ImGui::SliderFloat("Max error (pixels)", &m_maxPixelError, 0.0f, 16.0f);
+		ImGui::Text("Triangles drawn: %zu", m_trianglesDrawn);
+
+		ImGui::Separator();
+		ImGui::Text("Cluster culling (full detail meshes)");
+		ImGui::Checkbox("Frustum culling", &m_clusterCulling);
+		if (m_clusterCulling) {
+			ImGui::Checkbox("Backface cone culling", &m_coneCulling);
+			ImGui::Text("Visible: %u clusters, %u triangles", m_visibleClusters, m_visibleTriangles);
+		}
+
 		ImGui::End();
 	}
 
@@ -165,6 +205,9 @@ void MainWindow::RenderImgui()
 
 void MainWindow::RenderScene()
 {
+	// Upload the meshes loaded since the last frame
+	updateObjMeshes();
+
 	// Clear the frame buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -184,18 +227,112 @@ void MainWindow::RenderScene()
 	m_mainShader->setMat3(m_mainShaderUniforms.normal, NormalMat);
 	m_mainShader->setVec3(m_mainShaderUniforms.lightPos, LookAt * glm::vec4(m_light_position, 1.0));
 
+	// Cull the meshes outside of the view frustum, all the bounding spheres at once
+	// (the planes of proj * LookAt are in object space, as the spheres)
+	glm::vec4 planes[6];
+	Camera::frustumPlanes(m_proj * LookAt, planes);
+	m_meshVisible.resize(m_meshesGL.size());
+	m_culledMeshes = m_meshesGL.size() - Camera::cullSpheres(planes, m_meshSpheres.data(), m_meshSpheres.size(), m_meshVisible.data());
+
+	// Pick the level of detail of each mesh from its error on screen (the model is scaled by 0.5)
+	std::vector<std::size_t> levels(m_meshesGL.size());
+	for (std::size_t i = 0; i < m_meshesGL.size(); ++i)
+	{
+		const MeshGL& m = m_meshesGL[i];
+		const float distance = glm::length(m_eye - 0.5f * glm::vec3(m_meshSpheres[i]));
+		const float pixelsPerUnit = Camera::projectedSize(m_proj, SCR_HEIGHT, 0.5f, distance);
+		levels[i] = OBJLoader::selectLod(m.lods, pixelsPerUnit, m_maxPixelError);
+	}
+
+	// Cull the clusters of the full detail meshes: the compute shader writes their draw commands
+	bool clustersCulled = false;
+	if (m_clusterCulling)
+	{
+		// Statistics of the previous frames the GPU is done with, in issue order
+		while (m_clusterStats[m_oldestStats].fence != nullptr)
+		{
+			StatsBuffer& previous = m_clusterStats[m_oldestStats];
+			const GLenum status = glClientWaitSync(previous.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(previous.fence);
+			previous.fence = nullptr;
+			GLuint stats[2] = { 0, 0 };
+			glGetNamedBufferSubData(previous.buffer, 0, sizeof(stats), stats);
+			m_visibleClusters = stats[0];
+			m_visibleTriangles = stats[1];
+			m_oldestStats = (m_oldestStats + 1) % NumStatsBuffers;
+		}
+
+		// All the buffers in flight: the oldest one is reused, its statistics dropped
+		StatsBuffer& current = m_clusterStats[m_nextStats];
+		if (current.fence != nullptr)
+		{
+			glDeleteSync(current.fence);
+			current.fence = nullptr;
+			m_oldestStats = (m_oldestStats + 1) % NumStatsBuffers;
+		}
+		glClearNamedBufferData(current.buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+		Camera::frustumPlanes(m_proj, planes); // In view space for the shader
+		glUseProgram(m_cullShader->programId());
+		m_cullShader->setMat4(m_cullUniforms.mvMatrix, LookAt);
+		glProgramUniform4fv(m_cullShader->programId(), m_cullUniforms.frustum, 6, &planes[0][0]);
+		m_cullShader->setBool(m_cullUniforms.coneCulling, m_coneCulling);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, current.buffer);
+		for (std::size_t i = 0; i < m_meshesGL.size(); ++i)
+		{
+			const MeshGL& m = m_meshesGL[i];
+			if (!m_meshVisible[i] || levels[i] != 0 || m.numClusters == 0)
+				continue;
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m.clusterBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m.commandBuffer);
+			glDispatchCompute((m.numClusters + 63) / 64, 1, 1);
+			clustersCulled = true;
+		}
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		current.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_nextStats = (m_nextStats + 1) % NumStatsBuffers;
+		glUseProgram(m_mainShader->programId());
+	}
+
 	// Draw the meshes
-	for(const MeshGL& m : m_meshesGL)
+	m_trianglesDrawn = 0;
+	for (std::size_t i = 0; i < m_meshesGL.size(); ++i)
 	{
+		const MeshGL& m = m_meshesGL[i];
+		if (!m_meshVisible[i])
+			continue;
+
 		// Set its material properties
+		m_mainShader->setMat4(m_mainShaderUniforms.modelview, LookAt * m.dequantization);
 		m_mainShader->setVec3(m_mainShaderUniforms.Kd, m.diffuse);
 		m_mainShader->setVec3(m_mainShaderUniforms.Ks, m.specular);
 		m_mainShader->setFloat(m_mainShaderUniforms.Kn, m.specularExponent);
 
-		// Draw the mesh
 		glBindVertexArray(m.vao);
-		glDrawArrays(GL_TRIANGLES, 0, m.numVertices);
+		if (clustersCulled && levels[i] == 0 && m.numClusters != 0)
+		{
+			// One command per cluster, the culled ones draw no instance
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m.commandBuffer);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, m.indexType, nullptr, m.numClusters, 0);
+			continue;
+		}
+
+		std::size_t first = 0, count = m.numVertices;
+		if (levels[i] > 0)
+		{
+			first = m.lods[levels[i] - 1].firstIndex;
+			count = m.lods[levels[i] - 1].numIndices;
+		}
+		m_trianglesDrawn += count / 3;
+
+		// Draw the mesh
+		glDrawElements(GL_TRIANGLES, GLsizei(count), m.indexType, BUFFER_OFFSET(first * m.indexSize));
 	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	if (clustersCulled)
+		m_trianglesDrawn += m_visibleTriangles;
 }
 
 int MainWindow::RenderLoop()
@@ -215,17 +352,31 @@ int MainWindow::RenderLoop()
 	}
 
 	// Clean memory
-	// Delete vaos and vbos
+	// Stop the loading (if still running) and delete vaos and vbos
+	if (m_meshLoader)
+		m_meshLoader->stop();
 	for (const MeshGL& m : m_meshesGL)
 	{
 		// Set material properties
 
 		// Draw the mesh
 		glDeleteVertexArrays(1, &m.vao);
-		glDeleteBuffers(1, &m.vboPosition);
-		glDeleteBuffers(1, &m.vboNormal);
+		glDeleteBuffers(1, &m.vbo);
+		glDeleteBuffers(1, &m.ebo);
+		if (m.clusterBuffer != 0)
+		{
+			glDeleteBuffers(1, &m.clusterBuffer);
+			glDeleteBuffers(1, &m.commandBuffer);
+		}
 	}
 	m_meshesGL.clear();
+	m_meshSpheres.clear();
+	for (StatsBuffer& stats : m_clusterStats)
+	{
+		if (stats.fence != nullptr)
+			glDeleteSync(stats.fence);
+		glDeleteBuffers(1, &stats.buffer);
+	}
 
 	// Cleanup
 	ImGui_ImplOpenGL3_Shutdown();
@@ -251,21 +402,55 @@ void MainWindow::loadObjFile()
 {
 	std::string assets_dir = ASSETS_DIR;
 	std::string ObjPath = assets_dir + "soccerball.obj";
-	// Load the obj file
-	OBJLoader::Loader loader(ObjPath);
+	// Load the obj file in the background through its binary cache (soccerball.obj.meshcache).
+	// The first run parses the obj file and writes the cache, the next ones only map it.
+	// The meshes are indexed: vertices shared by several triangles are stored once.
+	// The render loop keeps running: the meshes appear as soon as they are uploaded (see updateObjMeshes)
+	// With quantized vertices, the vertex buffers are half as large (16 bytes per vertex)
+	m_meshLoader = std::make_unique<AsyncMeshLoader>(
+		m_mainShader->attributeLocation("vPosition"),
+		m_mainShader->attributeLocation("vNormal"));
+	m_meshLoader->setVertexFormat(m_quantizedVertices ? AsyncMeshLoader::VertexFormat::Quantized : AsyncMeshLoader::VertexFormat::Float);
+	m_meshLoader->start(ObjPath);
+}
+
+void MainWindow::updateObjMeshes()
+{
+	if (!m_meshLoader || m_meshLoader->isDone())
+		return;
+
+	// Create the GL objects of the loaded meshes, within a per frame upload budget
+	const std::size_t first = m_meshLoader->meshes().size();
+	if (m_meshLoader->update() == 0)
+		return;
 
-	// Create a GL object for each mesh extracted from the OBJ file
 	// Note that if the 3D object have several different material
 	// This will create multiple Mesh objects (one for each different material)
-	const std::vector<OBJLoader::Mesh>& meshes = loader.getMeshes();
-	const std::vector<OBJLoader::Material>& materials = loader.getMaterials();
-	for (unsigned int i = 0; i < meshes.size(); ++i)
+	const std::vector<AsyncMeshLoader::GpuMesh>& meshes = m_meshLoader->meshes();
+	const std::vector<OBJLoader::Material>& materials = m_meshLoader->materials();
+	for (std::size_t i = first; i < meshes.size(); ++i)
 	{
-		if (meshes[i].vertices.size() == 0)
-			continue;
-
 		MeshGL meshGL;
-		meshGL.numVertices = meshes[i].vertices.size();
+		meshGL.vao = meshes[i].vao;
+		meshGL.vbo = meshes[i].vbo;
+		meshGL.ebo = meshes[i].ebo;
+		meshGL.numVertices = meshes[i].count;
+		meshGL.indexType = meshes[i].indexType;
+		meshGL.indexSize = (meshes[i].indexType == GL_UNSIGNED_SHORT) ? 2 : 4;
+		meshGL.lods = meshes[i].lods;
+		meshGL.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), glm::make_vec3(meshes[i].positionOffset)), glm::make_vec3(meshes[i].positionScale));
+		const OBJLoader::BoundingSphere& sphere = meshes[i].sphere;
+		m_meshSpheres.push_back(glm::vec4(glm::make_vec3(sphere.center), sphere.radius));
+
+		// One indirect draw command per cluster (DrawElementsIndirectCommand), written by the culling shader
+		meshGL.clusterBuffer = meshes[i].clusterBuffer;
+		meshGL.numClusters = meshes[i].numClusters;
+		meshGL.commandBuffer = 0;
+		if (meshGL.clusterBuffer != 0)
+		{
+			glCreateBuffers(1, &meshGL.commandBuffer);
+			glNamedBufferStorage(meshGL.commandBuffer, meshGL.numClusters * 5 * sizeof(GLuint), nullptr, 0);
+		}
 
 		// Set material properties of the mesh
 		const float* Kd = materials[meshes[i].materialID].Kd;
@@ -274,69 +459,7 @@ void MainWindow::loadObjFile()
 		meshGL.diffuse = glm::vec3(Kd[0], Kd[1], Kd[2]);
 		meshGL.specular = glm::vec3(Ks[0], Ks[1], Ks[2]);
 		meshGL.specularExponent = materials[meshes[i].materialID].Kn;
-
-		// Create its VAO and VBO object
-		glCreateVertexArrays(1, &meshGL.vao);
-		glCreateBuffers(1, &meshGL.vboPosition);
-		glCreateBuffers(1, &meshGL.vboNormal);
-		std::cout << "Mesh " << i << " has " << meshGL.numVertices << " vertices\n";
-
-		// Split data into position and normal
-		std::vector<glm::vec3> positions(meshGL.numVertices);
-		std::vector<glm::vec3> normals(meshGL.numVertices);
-		for (unsigned int j = 0; j < meshGL.numVertices; ++j)
-		{
-			positions[j] = glm::vec3(meshes[i].vertices[j].position[0], meshes[i].vertices[j].position[1], meshes[i].vertices[j].position[2]);
-			normals[j] = glm::vec3(meshes[i].vertices[j].normal[0], meshes[i].vertices[j].normal[1], meshes[i].vertices[j].normal[2]);
-		}
-		std::cout << "Mesh " << i << " has " << meshGL.numVertices << " vertices\n";
-		// Here we will use only one VBO for all the data
-		glNamedBufferData(meshGL.vboPosition, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STATIC_DRAW);
-		glNamedBufferData(meshGL.vboNormal, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STATIC_DRAW);
-
-		int PositionLoc = m_mainShader->attributeLocation("vPosition");
-		glVertexArrayAttribFormat(meshGL.vao, 
-			PositionLoc, // Attribute index 
-			3, // Number of components
-			GL_FLOAT, // Type 
-			GL_FALSE, // Normalize 
-			0 // Relative offset (first component)
-		);
-		glVertexArrayVertexBuffer(meshGL.vao, 
-			PositionLoc, // Binding point 
-			meshGL.vboPosition, // VBO 
-			0, // Offset (when the position starts)
-			sizeof(glm::vec3) // Stride
-		);
-		glEnableVertexArrayAttrib(meshGL.vao, 
-			PositionLoc // Attribute index
-		);
-		glVertexArrayAttribBinding(meshGL.vao, 
-			PositionLoc, // Attribute index
-			PositionLoc  // Binding point
-		);
-
-		int NormalLoc = m_mainShader->attributeLocation("vNormal");
-		glVertexArrayAttribFormat(meshGL.vao, 
-			NormalLoc, // Attribute index 
-			3, // Number of components
-			GL_FLOAT, // Type 
-			GL_FALSE, // Normalize 
-			0 // Relative offset (first component)
-		);
-		glVertexArrayVertexBuffer(meshGL.vao, 
-			NormalLoc, // Binding point 
-			meshGL.vboNormal, // VBO 
-			0, // Offset (when the position starts)
-			sizeof(glm::vec3) // Stride
-		);
-		glEnableVertexArrayAttrib(meshGL.vao, 
-			NormalLoc // Attribute index
-		);
-		glVertexArrayAttribBinding(meshGL.vao, 
-			NormalLoc, // Attribute index
-			NormalLoc  // Binding point
-		);
+		std::cout << "Mesh " << i << " has " << meshGL.numVertices / 3 << " triangles, " << meshGL.lods.size() << " levels of detail and " << meshGL.numClusters << " clusters\n";
 
 		// Add it to the list
 		m_meshesGL.push_back(meshGL);
@@ -10,6 +10,7 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "AsyncMeshLoader.h"
 
 
 class MainWindow
@@ -38,6 +39,7 @@ private:
 	void updateCameraEye();
 
 	void loadObjFile();
+	void updateObjMeshes();
 
 private:
 	// GLFW Window
@@ -63,6 +65,9 @@ private:
 	glm::mat4 m_proj;
 	glm::vec3 m_light_position;
 
+	// Vertex buffers with quantized vertices (16 bytes instead of 32, see OBJLoader::QuantizedVertex)
+	const bool m_quantizedVertices = true;
+
 	// Main shader
 	std::unique_ptr<ShaderProgram> m_mainShader = nullptr;
 	struct m_mainShaderUniforms
@@ -76,20 +81,64 @@ private:
 		GLint Kn; // Kn
 	} m_mainShaderUniforms;
 
+	// Cluster culling (compute shader writing the indirect draw commands)
+	std::unique_ptr<ShaderProgram> m_cullShader = nullptr;
+	struct {
+		GLint mvMatrix = 0;
+		GLint frustum = 1;
+		GLint coneCulling = 7;
+	} m_cullUniforms;
+	// Visible clusters and triangles counted by the shader, in a ring of buffers read
+	// a few frames later, once their fence is signaled (without waiting for the GPU)
+	static const int NumStatsBuffers = 3;
+	struct StatsBuffer
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr; // Pending until signaled and read
+	};
+	StatsBuffer m_clusterStats[NumStatsBuffers];
+	int m_nextStats = 0;   // Used by the next frame
+	int m_oldestStats = 0; // Next one to complete
+	bool m_clusterCulling = true;
+	bool m_coneCulling = true;
+	GLuint m_visibleClusters = 0;
+	GLuint m_visibleTriangles = 0;
+
 	// VAOs and VBOs
 	struct MeshGL
 	{
 		// ID VAO/VBO
 		GLuint vao;
-		GLuint vboPosition;
-		GLuint vboNormal;
+		GLuint vbo; // Interleaved vertices (OBJLoader::Vertex)
+		GLuint ebo;
 
 		// Material information
 		glm::vec3  diffuse;
 		glm::vec3  specular;
 		GLfloat    specularExponent;
 
-		unsigned int numVertices;
+		unsigned int numVertices; // Number of indices
+		GLenum indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		GLsizei indexSize; // 2 or 4 bytes
+
+		// Levels of detail (in the same element buffer)
+		std::vector<OBJLoader::CachedLod> lods;
+		glm::mat4 dequantization; // Quantized positions to object space (identity for float vertices)
+
+		// Clusters of the mesh (0 if none) and their draw commands
+		GLuint clusterBuffer;
+		GLuint commandBuffer;
+		GLsizei numClusters;
 	};
 	std::vector<MeshGL> m_meshesGL;
+
+	// Frustum culling of the meshes, from their bounding spheres (object space: center, radius)
+	std::vector<glm::vec4> m_meshSpheres; // One per mesh of m_meshesGL
+	std::vector<std::uint8_t> m_meshVisible;
+	std::size_t m_culledMeshes = 0;
+
+	// Levels of detail
+	float m_maxPixelError = 1.0f; // Error on screen accepted for the levels of detail
+	std::size_t m_trianglesDrawn = 0;
+	std::unique_ptr<AsyncMeshLoader> m_meshLoader;
 };
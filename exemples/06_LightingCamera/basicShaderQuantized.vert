@@ -0,0 +1,30 @@
+#version 400 core
+// basicShader.vert for quantized vertices (OBJLoader::QuantizedVertex):
+// the dequantization of the positions is included in mvMatrix
+uniform mat4 mvMatrix;
+uniform mat4 projMatrix;
+uniform mat3 normalMatrix;
+
+in vec3 vPosition; // In [0, 1] in the bounds of the model
+in vec2 vNormal;   // Octahedral encoding
+
+out vec3 fNormal;
+out vec3 fPosition;
+
+vec3 octDecode(vec2 e)
+{
+     vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+     float t = max(-n.z, 0.0);
+     n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+     return normalize(n);
+}
+
+void
+main()
+{
+     vec4 vEyeCoord = mvMatrix * vec4(vPosition, 1.0);
+     gl_Position = projMatrix * vEyeCoord;
+
+     fPosition = vEyeCoord.xyz;
+     fNormal = normalMatrix*octDecode(vNormal);
+}
@@ -10,6 +10,7 @@
 
 #include "ShaderProgram.h"
 #include "Camera.h"
+#include "TextureAtlas.h"
 
 inline float random(float min, float max)
 {
@@ -26,7 +27,7 @@ struct Particle
 	glm::vec3 v = glm::vec3(0.0); // velocity
 	float size = 0.1f;			  // scaling factor
 	glm::vec3 c = glm::vec3(0.0); // RGB color
-	float padd = 0.0f;			  // padding
+	float sprite = 0.0f;		  // sprite index in the atlas
 };
 
 struct ParticleGeneratorSettings {
@@ -35,6 +36,7 @@ struct ParticleGeneratorSettings {
 	float velocityMax = 10.0f;
 	float lifeMin = 0.1f;
 	float lifeMax = 1.0f;
+	int numSprites = 1;
 
 	void sanitize() {
 		size = std::max(size, 0.0001f);
@@ -57,6 +59,7 @@ struct ParticleGeneratorSettings {
 		const float b = random(0.0, 0.5);
 		p.c = glm::vec3(r, g, b);
 		p.size = random(0.1f, 0.25f);
+		p.sprite = float(rand() % numSprites);
 		return p;
 	}
 
@@ -104,8 +107,12 @@ private:
 	bool m_animate = true;
 	float m_time = 0.0;
 	
-	// Texture
+	// Texture: atlas of the sprites, and its UV-rect table (SSBO). The sprites are
+	// downscaled to SpriteSize, and padded enough to keep their full mip chain
+	static const int SpriteSize = 128;
+	TextureAtlas m_atlas{ SpriteSize };
 	GLuint m_textureID;
+	GLuint m_spriteRectBuffer;
 
 	// Storage buffer
 	enum VAO_IDs { Particules, NumVAOs };
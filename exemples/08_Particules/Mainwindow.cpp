@@ -8,10 +8,6 @@
 
 #include <algorithm>
 
-// For images
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 namespace {
@@ -142,6 +138,23 @@ int MainWindow::InitializeGL()
 	}
 
 
+	// All the sprites in one texture: the particles pick theirs without any other binding
+	const std::string spriteNames[] = { "Particle2.png", "Particle1.png" };
+	for (const std::string& name : spriteNames) {
+		if (m_atlas.add(directory + name, glm::vec4(1.0f), SpriteSize) < 0)
+			return 8;
+	}
+	if (!m_atlas.build(TextureCache::ColorSpace::SRGB)) {
+		std::cerr << "Error when building the sprite atlas\n";
+		return 8;
+	}
+	m_textureID = m_atlas.createTexture();
+	m_spriteRectBuffer = m_atlas.createRectBuffer();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_spriteRectBuffer);
+	std::cout << "Sprite atlas: " << m_atlas.numSprites() << " sprites, " << m_atlas.width() << "x" << m_atlas.height()
+		<< ", " << m_atlas.numLevels() << " levels" << std::endl;
+	m_settings.numSprites = m_atlas.numSprites();
+
 	// Create the VAO
 	glCreateVertexArrays(1, m_VAOs);
 	glBindVertexArray(m_VAOs[Particules]);
@@ -149,41 +162,6 @@ int MainWindow::InitializeGL()
 	// Initialise and create the buffers
 	initializeParticles();
 
-	glGenTextures(1, &m_textureID);
-
-	// Ask the library to flip the image vertically
-	// This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-	// whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-	stbi_set_flip_vertically_on_load(true);
-
-	int width, height, nrComponents;
-	std::string img_path = directory + "Particle2.png";
-	unsigned char* data = stbi_load(img_path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-	if (data)
-	{
-		// for (int i = 0; i < width * height; i++) {
-		// 	std::cout << (int)data[i] << " ";
-		// }
-		glBindTexture(GL_TEXTURE_2D, m_textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-
-		std::cout << "Texture loaded at path: " << img_path << std::endl;
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << img_path << std::endl;
-		stbi_image_free(data);
-		return false;
-	}
-
 	// Setup projection matrix (a bit hacky)
 	FramebufferSizeCallback(m_windowWidth, m_windowHeight);
 
@@ -272,6 +250,7 @@ void MainWindow::RenderImgui()
 		ImGui::InputFloat("Global Size", &m_size);
 		ImGui::InputFloat("Transparency", &m_transparency);
 		ImGui::Checkbox("Use Texture?", &m_useTexture);
+		ImGui::Text("Atlas: %d sprites (%dx%d)", m_atlas.numSprites(), m_atlas.width(), m_atlas.height());
 		if(ImGui::Checkbox("Use Compute?", &m_useCompute)) {
 			initializeParticles();
 			ResetImGuiFramerateMovingAverage();
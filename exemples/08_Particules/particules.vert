@@ -6,17 +6,23 @@ struct Particle{
     vec3 velocity;
     float size;
     vec3 color;
-    float _pad;
+    float sprite;
 };
 
 layout(binding = 0, std430) readonly buffer ssbo1 {
     Particle data[];
 };
 
+// UV-rect of each sprite of the atlas (u0, v0, u1, v1)
+layout(binding = 2, std430) readonly buffer ssbo3 {
+    vec4 spriteRects[];
+};
+
 uniform float globalSize;
 
 out float quadLength;
 out vec3 quadColor;
+out vec4 quadRect;
 
 void main(void){
     vec4 pPos = vec4(data[gl_VertexID].position, 1.0);
@@ -26,4 +32,5 @@ void main(void){
     gl_Position = pPos;
     quadLength = pSize * globalSize;
     quadColor = pColor;
+    quadRect = spriteRects[int(data[gl_VertexID].sprite)];
 }
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "TextureLoader.h"
+#include "VirtualTexture.h"
+#include "VirtualTextureFeedback.h"
 
 class MainWindow
 {
@@ -36,12 +39,6 @@ private:
 	// Update camera position (eye)
 	void updateCameraEye();
 
-	// Load texture
-	bool loadTexture(const std::string& path, unsigned int& textureID,
-		GLint uvMode, // UV/ST warp mode
-		GLint minMode,  // Minfication
-		GLint magMode); // Magnification
-
 private:
 	// settings
 	const unsigned int SCR_WIDTH = 900;
@@ -71,6 +68,16 @@ private:
 	// GLFW Window
 	GLFWwindow* m_window = nullptr;
 
+	// Textures, decoded by a pool of threads
+	TextureLoader m_textures;
+
+	// Same images as a virtual texture (diffuse and ARM layers), paged from the
+	// feedback pass
+	VirtualTexture m_virtualTexture;
+	VirtualTextureFeedback m_feedback;
+	bool m_useVirtual = true;
+	bool m_showLevels = false;
+
 	std::unique_ptr<ShaderProgram> m_mainShader = nullptr;
 	struct {
 		GLint mvMatrix;
@@ -81,4 +88,20 @@ private:
 		GLint textureARM;
 		GLint activateARM;
 	} m_uniforms;
+
+	std::unique_ptr<ShaderProgram> m_virtualShader = nullptr;
+	struct {
+		GLint mvMatrix;
+		GLint projMatrix;
+		GLint normalMatrix;
+		GLint activateARM;
+		GLint showLevels;
+	} m_virtualUniforms;
+
+	std::unique_ptr<ShaderProgram> m_feedbackShader = nullptr;
+	struct {
+		GLint mvMatrix;
+		GLint projMatrix;
+		GLint lodBias;
+	} m_feedbackUniforms;
 };
@@ -1,8 +1,5 @@
 #include "MainWindow.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -133,22 +130,32 @@ int MainWindow::InitializeGL()
 	// image_diffuse_path = assets_dir + "slab_tiles_diff_1k.jpg";
 	// image_arm_path = assets_dir + "slab_tiles_arm_1k.jpg";
 
-	if (!loadTexture(image_diffuse_path, m_textureDiffuseID, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-		std::cerr << "Unable to load texture: " << image_diffuse_path << std::endl;
+	// Both images are decoded at the same time
+	m_textureDiffuseID = m_textures.acquire(image_diffuse_path, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::SRGB, TextureCache::Format::BC1);
+	m_textureARMID = m_textures.acquire(image_arm_path, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::Linear, TextureCache::Format::BC1);
+	if (!m_textures.finish()) {
+		std::cerr << "Unable to load texture: " << image_diffuse_path << " or " << image_arm_path << std::endl;
 		return 4;
 	}
-	else {
-		std::cout << "Load texture -- OpenGL ID: " << m_textureDiffuseID << "\n";
-	}
-
-	if (!loadTexture(image_arm_path, m_textureARMID, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-		std::cerr << "Unable to load texture: " << image_arm_path << std::endl;
+	std::cout << "Load texture -- OpenGL ID: " << m_textureDiffuseID << "\n";
+	std::cout << "Load texture -- OpenGL ID: " << m_textureARMID << "\n";
+
+	// The same images, paged in 6x6 slots of 128x128 texels: fewer than the pages
+	// of their full resolution level, the least recently seen ones are evicted
+	const std::vector<VirtualTexture::Layer> layers = {
+		{ image_diffuse_path, TextureCache::ColorSpace::SRGB },
+		{ image_arm_path, TextureCache::ColorSpace::Linear }
+	};
+	if (!m_virtualTexture.create(layers, 6, 6, 128)) {
+		std::cerr << "Unable to create the virtual texture" << std::endl;
 		return 4;
 	}
-	else {
-		std::cout << "Load texture -- OpenGL ID: " << m_textureARMID << "\n";
+	if (!m_feedback.create(SCR_WIDTH, SCR_HEIGHT)) {
+		std::cerr << "Unable to create the feedback buffer" << std::endl;
+		return 4;
 	}
 
+
 	// build and compile our shader program
 	const std::string directory = SHADERS_DIR;
 	m_mainShader = std::make_unique<ShaderProgram>();
@@ -174,6 +181,38 @@ int MainWindow::InitializeGL()
 		return 5;
 	}
 
+	// Virtual texture: the main pass and the feedback pass
+	m_virtualShader = std::make_unique<ShaderProgram>();
+	bool virtualShaderSuccess = true;
+	virtualShaderSuccess &= m_virtualShader->addShaderFromSource(GL_VERTEX_SHADER, directory + "triangles.vert");
+	virtualShaderSuccess &= m_virtualShader->addShaderFromSource(GL_FRAGMENT_SHADER, directory + "virtual.frag");
+	virtualShaderSuccess &= m_virtualShader->link();
+	m_feedbackShader = std::make_unique<ShaderProgram>();
+	virtualShaderSuccess &= m_feedbackShader->addShaderFromSource(GL_VERTEX_SHADER, directory + "triangles.vert");
+	virtualShaderSuccess &= m_feedbackShader->addShaderFromSource(GL_FRAGMENT_SHADER, directory + "feedback.frag");
+	virtualShaderSuccess &= m_feedbackShader->link();
+	if (!virtualShaderSuccess) {
+		std::cerr << "Error when loading virtual texture shaders\n";
+		return 4;
+	}
+	m_virtualUniforms.mvMatrix = m_virtualShader->uniformLocation("mvMatrix");
+	m_virtualUniforms.projMatrix = m_virtualShader->uniformLocation("projMatrix");
+	m_virtualUniforms.normalMatrix = m_virtualShader->uniformLocation("normalMatrix");
+	m_virtualUniforms.activateARM = m_virtualShader->uniformLocation("activateARM");
+	m_virtualUniforms.showLevels = m_virtualShader->uniformLocation("showLevels");
+	m_feedbackUniforms.mvMatrix = m_feedbackShader->uniformLocation("mvMatrix");
+	m_feedbackUniforms.projMatrix = m_feedbackShader->uniformLocation("projMatrix");
+	m_feedbackUniforms.lodBias = m_feedbackShader->uniformLocation("lodBias");
+	if (m_virtualUniforms.mvMatrix == -1 || m_virtualUniforms.projMatrix == -1 || m_virtualUniforms.normalMatrix == -1 ||
+		m_virtualUniforms.activateARM == -1 || m_virtualUniforms.showLevels == -1 ||
+		m_feedbackUniforms.mvMatrix == -1 || m_feedbackUniforms.projMatrix == -1 || m_feedbackUniforms.lodBias == -1) {
+		std::cerr << "Error when loading virtual texture uniform variables\n";
+		return 5;
+	}
+	m_virtualTexture.setUniforms(m_virtualShader->programId());
+	m_virtualTexture.setUniforms(m_feedbackShader->programId());
+	m_feedbackShader->setFloat(m_feedbackUniforms.lodBias, m_feedback.lodBias());
+
 	// Setup shader variables
 	glUseProgram(m_mainShader->programId());
 
@@ -241,6 +280,15 @@ void MainWindow::RenderImgui()
 		}
 		ImGui::Checkbox("Activate (ARM)", &m_activateARM);
 
+		// Virtual texture (always repeated, the mode only applies to the classic textures)
+		ImGui::Checkbox("Virtual texture", &m_useVirtual);
+		if (m_useVirtual) {
+			ImGui::Checkbox("Show page levels", &m_showLevels);
+			ImGui::Text("Pages: %zu / %zu slots, %zu requested, %zu evictions",
+				m_virtualTexture.numResident(), m_virtualTexture.numSlots(),
+				m_virtualTexture.numRequested(), m_virtualTexture.numEvictions());
+		}
+
 		bool updateCamera = ImGui::SliderFloat("Left Right Slider", &m_longitude, -180.0f, 180.0f);
 		updateCamera |= ImGui::SliderFloat("Up Down Slider", &m_latitude, -89.f, 89.f);
 		updateCamera |= ImGui::SliderFloat("Forward Backward Slider", &m_distance, 2.f, 14.f);
@@ -257,22 +305,55 @@ void MainWindow::RenderImgui()
 
 void MainWindow::RenderScene()
 {
-	glClear(GL_COLOR_BUFFER_BIT);
 	glBindVertexArray(m_VAOs[Triangles]);
 
+	// Camera specification (for the shader)
+	glm::mat4 lookAt = glm::lookAt(m_eye, m_at, m_up);
+	m_proj = glm::perspective(45.0f, float(SCR_WIDTH) / SCR_HEIGHT, 0.01f, 100.0f);
+	glm::mat3 NoramlMat = glm::inverseTranspose(glm::mat3(lookAt));
+
+	if (m_useVirtual) {
+		// Feedback pass: the pages seen this frame, read back a few frames later
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		m_feedback.begin();
+		glUseProgram(m_feedbackShader->programId());
+		m_feedbackShader->setMat4(m_feedbackUniforms.mvMatrix, lookAt);
+		m_feedbackShader->setMat4(m_feedbackUniforms.projMatrix, m_proj);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, NumVertices);
+		m_feedback.end();
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		std::vector<std::uint32_t> pages;
+		if (m_feedback.read(pages))
+			m_virtualTexture.requestPages(pages);
+		m_virtualTexture.update();
+
+		glClear(GL_COLOR_BUFFER_BIT);
+		glUseProgram(m_virtualShader->programId());
+		m_virtualShader->setBool(m_virtualUniforms.activateARM, m_activateARM);
+		m_virtualShader->setBool(m_virtualUniforms.showLevels, m_showLevels);
+		m_virtualShader->setMat4(m_virtualUniforms.mvMatrix, lookAt);
+		m_virtualShader->setMat4(m_virtualUniforms.projMatrix, m_proj);
+		m_virtualShader->setMat3(m_virtualUniforms.normalMatrix, NoramlMat);
+		glBindTextureUnit(0, m_virtualTexture.physicalTexture(0));
+		glBindTextureUnit(1, m_virtualTexture.physicalTexture(1));
+		glBindTextureUnit(2, m_virtualTexture.pageTable());
+
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, NumVertices);
+		return;
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT);
 	glUseProgram(m_mainShader->programId());
 	m_mainShader->setBool(m_uniforms.activateARM, m_activateARM);
 
 	// Note that binding point are configured inside the shader
 	glBindTextureUnit(0, m_textureDiffuseID);
 	glBindTextureUnit(1, m_textureARMID);
-	
-	// Camera specification (for the shader)
-	glm::mat4 lookAt = glm::lookAt(m_eye, m_at, m_up);
+
 	m_mainShader->setMat4(m_uniforms.mvMatrix, lookAt);
-	m_proj = glm::perspective(45.0f, float(SCR_WIDTH) / SCR_HEIGHT, 0.01f, 100.0f);
 	m_mainShader->setMat4(m_uniforms.projMatrix, m_proj);
-	glm::mat3 NoramlMat = glm::inverseTranspose(glm::mat3(lookAt));
 	m_mainShader->setMat3(m_uniforms.normalMatrix, NoramlMat);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, NumVertices);
@@ -296,6 +377,8 @@ int MainWindow::RenderLoop()
 	}
 
 	// Cleanup
+	m_virtualTexture.destroy();
+	m_feedback.destroy();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -314,42 +397,3 @@ void MainWindow::updateCameraEye()
 	longitude= glm::rotate(longitude, glm::radians(m_longitude), glm::vec3(0, 1, 0));
 	m_eye = longitude * latitude * glm::vec4(m_eye,1);
 }
-
-bool MainWindow::loadTexture(const std::string& path, unsigned int& textureID, GLint uvMode, GLint minMode, GLint magMode)
-{
-	// OpenGL 4.6 -- need to specify the texture type
-	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-
-	// Ask the library to flip the image horizontally
-	// This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-	// whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-	stbi_set_flip_vertically_on_load(true);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-	if (data)
-	{
-		glTextureStorage2D(textureID, 1, GL_RGBA8, width, height);
-		glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		if (minMode == GL_LINEAR_MIPMAP_LINEAR) {
-			glGenerateTextureMipmap(textureID);
-		}
-
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, minMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, magMode);
-
-		stbi_image_free(data);
-
-		std::cout << "Texture loaded at path: " << path << std::endl;
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-		return false;
-	}
-
-	return true;
-}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 420 core
+
+// Feedback pass of the virtual texture: the page each pixel needs, at the
+// finest level the main pass samples (see VirtualTexture::encodePage)
+
+// Level l: (first column in the page table, width, height, 0)
+uniform ivec4 vtLevels[16];
+uniform int vtNumLevels;
+uniform int vtPageSize;
+// The pixels of the feedback buffer cover several pixels of the screen
+uniform float lodBias;
+
+in vec2 fUV;
+
+layout(location = 0) out uint fPage;
+
+void
+main()
+{
+    vec2 texel = fUV * vec2(vtLevels[0].yz);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - lodBias;
+    int level = clamp(int(floor(lod)), 0, vtNumLevels - 1);
+
+    // The virtual texture repeats
+    ivec2 page = ivec2(fract(fUV) * vec2(vtLevels[level].yz)) / vtPageSize;
+    fPage = uint(((level + 1) << 24) | (page.y << 12) | page.x);
+}
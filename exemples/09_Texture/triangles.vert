@@ -3,9 +3,10 @@ uniform mat4 mvMatrix;
 uniform mat4 projMatrix;
 uniform mat3 normalMatrix;
 
-in vec4 vPosition;
-in vec2 vUV;
-in vec3 vNormal;
+// Same locations in all the programs drawing the VAO (classic, virtual and feedback)
+layout(location = 0) in vec4 vPosition;
+layout(location = 1) in vec2 vUV;
+layout(location = 2) in vec3 vNormal;
 
 out vec2 fUV;
 out vec3 fNormal;
@@ -0,0 +1,97 @@
+#version 420 core
+
+// Virtual texture: physical textures of the layers (the resident pages, each
+// one with its border) and page table, see VirtualTexture
+layout(binding = 0) uniform sampler2D texDiffuse;
+layout(binding = 1) uniform sampler2D texARM;
+layout(binding = 2) uniform usampler2D pageTable;
+
+// Level l: (first column in the page table, width, height, 0)
+uniform ivec4 vtLevels[16];
+uniform int vtNumLevels;
+uniform int vtPageSize;
+uniform int vtBorder;
+
+uniform bool activateARM;
+uniform bool showLevels;
+
+in vec2 fUV;
+in vec3 fNormal;
+in vec3 fViewDirection;
+in vec3 fPosition;
+
+out vec4 fColor;
+
+// Coordinates in the physical textures for the level of uv, in the finest
+// resident page covering it (resident: level of this page)
+vec2 physicalUV(vec2 uv, int level, out int resident)
+{
+    ivec4 info = vtLevels[level];
+    ivec2 page = ivec2(uv * vec2(info.yz)) / vtPageSize;
+    uvec4 entry = texelFetch(pageTable, ivec2(info.x + page.x, page.y), 0);
+    resident = int(entry.z);
+
+    // Position in the resident page, after the border of its slot
+    vec2 texel = uv * vec2(vtLevels[resident].yz);
+    vec2 inPage = texel - vec2(ivec2(texel) / vtPageSize * vtPageSize);
+    vec2 slot = vec2(entry.xy) * float(vtPageSize + 2 * vtBorder) + float(vtBorder);
+    return (slot + inPage) / vec2(textureSize(texDiffuse, 0));
+}
+
+void
+main()
+{
+    // Level from the derivatives, like the hardware: the physical textures have no mipmaps
+    vec2 texel = fUV * vec2(vtLevels[0].yz);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, float(vtNumLevels - 1));
+    int level = int(floor(lod));
+
+    // Trilinear: the two levels around lod (or their resident ancestors)
+    vec2 uv = fract(fUV);
+    int resident0, resident1;
+    vec2 uv0 = physicalUV(uv, level, resident0);
+    vec2 uv1 = physicalUV(uv, min(level + 1, vtNumLevels - 1), resident1);
+    float t = fract(lod);
+
+    // Light source on camera position (no decrease with the distance)
+    vec3 LightDirection = normalize(vec3(0.0)-fPosition);
+    vec3 nfNormal = normalize(fNormal);
+    vec3 nviewDirection = normalize(fViewDirection);
+
+    // Compute cosTheta
+    float cosTheta = dot(nfNormal, LightDirection);
+
+    // Retrive color from the texture
+    vec4 Kd = mix(textureLod(texDiffuse, uv0, 0.0), textureLod(texDiffuse, uv1, 0.0), t);
+    vec3 ARM = mix(textureLod(texARM, uv0, 0.0), textureLod(texARM, uv1, 0.0), t).rgb;
+    if(!activateARM) {
+        ARM = vec3(0.0);
+    }
+    if(showLevels) {
+        // Level of the pages actually sampled: red for the full resolution, to blue for the coarsest
+        float l = float(resident0) / float(max(vtNumLevels - 1, 1));
+        Kd.rgb = mix(Kd.rgb, vec3(1.0 - l, 0.2, l), 0.5);
+    }
+
+    // Convert roughness to phong exponent
+    // http://simonstechblog.blogspot.com/2011/12/microfacet-brdf.html
+    float n = sqrt(2.0/(ARM.g+2));
+
+    if (cosTheta >= 0)
+    {
+        // Reflexion
+        vec3 Rl = normalize(-LightDirection+2.0*nfNormal*dot(nfNormal,LightDirection));
+        float specular = pow(max(0.0, dot(Rl, nviewDirection)), n);
+
+        // Use phong model with ambiant and controlled metallic
+        // the diffuse color is directly control with diffuse texture (Kd)
+        fColor = ARM.r*0.2 + Kd * cosTheta * (1-ARM.b) + vec4(1.0) * specular * (ARM.b);
+    }
+    else
+    {
+        // Show the texture (arbitrary in this case)
+        fColor = Kd;
+    }
+}
@@ -5,11 +5,14 @@
 #include <glm/glm.hpp>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
 
 class MainWindow
 {
@@ -36,12 +39,6 @@ private:
 	// Update camera position (eye)
 	void updateCameraEye();
 
-	// Load texture
-	bool loadTexture(const std::string& path, unsigned int& textureID,
-		GLint uvMode, // UV/ST warp mode
-		GLint minMode,  // Minfication
-		GLint magMode); // Magnification
-
 private:
 	// settings
 	const unsigned int SCR_WIDTH = 900;
@@ -64,23 +61,38 @@ private:
 
 	// Textures
 	unsigned int m_textureDiffuseID = -1;
-	GLuint64 m_handleDiffuse = 0;
 	unsigned int m_textureARMID = -1;
-	GLuint64 m_handleARM = 0;
 	int m_mode = 0;
 	bool m_activateARM = true;
 
+	// Floor of NumTiles x NumTiles tiles, each one with its own material and texture
+	static const int NumTiles = 32;
+	static const int TileTextureSize = 128;
+	std::vector<GLuint> m_tileTextures;
+	std::vector<glm::mat4> m_tileModels;
+	std::vector<glm::vec4> m_tileSpheres;    // Bounding sphere of each tile (center, radius)
+	std::vector<std::uint8_t> m_tileVisible; // Culling result of each tile
+	GLuint m_fallbackTextures[2] = { 0, 0 }; // Diffuse and ARM of the non-resident textures
+
+	// Bindless handles of all the textures, resident within the budget, and the
+	// material of each draw
+	TextureResidency m_residency;
+	float m_budgetMB = 16.0f;
+	GLuint m_drawBuffer = 0;    // DrawData of the visible draws (SSBO)
+	GLuint m_commandBuffer = 0; // Their indirect commands
+	std::size_t m_numDraws = 0;
+
 	// GLFW Window
 	GLFWwindow* m_window = nullptr;
 
+	// Textures, decoded by a pool of threads
+	TextureLoader m_textures;
+
 	std::unique_ptr<ShaderProgram> m_mainShader = nullptr;
 	struct {
 		GLint mvMatrix;
 		GLint projMatrix;
 		GLint normalMatrix;
-		// Textures
-		GLint textureDiffuse;
-		GLint textureARM;
 		GLint activateARM;
 	} m_uniforms;
 };
@@ -1,15 +1,16 @@
 #include "MainWindow.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
+#include "Camera.h"
+
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
@@ -20,6 +21,23 @@ const GLuint NumColors = 4;
 const GLuint NumNormals = 4;
 const GLuint NumUvs = 4;
 
+// Per draw data of the shaders, indexed by gl_DrawID (std430)
+struct DrawData
+{
+	glm::mat4 model;
+	GLuint material;
+	GLuint padding[3];
+};
+
+// glMultiDrawArraysIndirect command
+struct DrawArraysCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
 MainWindow::MainWindow() :
 	m_at(glm::vec3(0, 0,0)),
 	m_up(glm::vec3(0, 1, 0))
@@ -133,25 +151,65 @@ int MainWindow::InitializeGL()
 	// image_diffuse_path = assets_dir + "slab_tiles_diff_1k.jpg";
 	// image_arm_path = assets_dir + "slab_tiles_arm_1k.jpg";
 
-	if (!loadTexture(image_diffuse_path, m_textureDiffuseID, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-		std::cerr << "Unable to load texture: " << image_diffuse_path << std::endl;
+	// Both images are decoded at the same time
+	m_textureDiffuseID = m_textures.acquire(image_diffuse_path, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::SRGB, TextureCache::Format::BC1);
+	m_textureARMID = m_textures.acquire(image_arm_path, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::Linear, TextureCache::Format::BC1);
+	if (!m_textures.finish()) {
+		std::cerr << "Unable to load texture: " << image_diffuse_path << " or " << image_arm_path << std::endl;
 		return 4;
 	}
-	else {
-		std::cout << "Load texture -- OpenGL ID: " << m_textureDiffuseID << "\n";
+	std::cout << "Load texture -- OpenGL ID: " << m_textureDiffuseID << "\n";
+	std::cout << "Load texture -- OpenGL ID: " << m_textureARMID << "\n";
+
+	// The residency manager creates the handles and makes them resident when a draw needs them
+	m_residency.setBudget(std::size_t(m_budgetMB * (1 << 20)));
+	const int diffuseIndex = m_residency.addTexture(m_textureDiffuseID);
+	const int ARMIndex = m_residency.addTexture(m_textureARMID);
+
+	// Used instead of the textures not resident yet: grey, and no metallic
+	const GLubyte fallbackColors[2][4] = { { 128, 128, 128, 255 }, { 255, 255, 0, 255 } };
+	glCreateTextures(GL_TEXTURE_2D, 2, m_fallbackTextures);
+	for (int i = 0; i < 2; ++i) {
+		glTextureStorage2D(m_fallbackTextures[i], 1, GL_RGBA8, 1, 1);
+		glClearTexImage(m_fallbackTextures[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, fallbackColors[i]);
+		m_residency.setFallback(i, m_residency.addTexture(m_fallbackTextures[i]));
 	}
-	m_handleDiffuse = glGetTextureHandleARB(m_textureDiffuseID);
-	glMakeTextureHandleResidentARB(m_handleDiffuse);
 
-	if (!loadTexture(image_arm_path, m_textureARMID, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-		std::cerr << "Unable to load texture: " << image_arm_path << std::endl;
-		return 4;
+	// Material 0: the plane
+	m_residency.addMaterial({ diffuseIndex, ARMIndex });
+
+	// Materials 1 to NumTiles^2: the tiles of the floor, a color each (all the levels cleared)
+	const int tileLevels = TextureCache::numLevels(TileTextureSize, TileTextureSize);
+	std::size_t tileBytes = 0;
+	for (int l = 0; l < tileLevels; ++l)
+		tileBytes += std::size_t(std::max(1, TileTextureSize >> l)) * std::max(1, TileTextureSize >> l) * 4;
+	m_tileTextures.resize(NumTiles * NumTiles);
+	glCreateTextures(GL_TEXTURE_2D, GLsizei(m_tileTextures.size()), m_tileTextures.data());
+	for (int i = 0; i < NumTiles * NumTiles; ++i) {
+		const int x = i % NumTiles;
+		const int z = i / NumTiles;
+		const GLubyte color[4] = { GLubyte(64 + 191 * x / NumTiles), GLubyte(64 + 191 * z / NumTiles), GLubyte(255 - 191 * (x + z) / (2 * NumTiles)), 255 };
+		glTextureStorage2D(m_tileTextures[i], tileLevels, GL_RGBA8, TileTextureSize, TileTextureSize);
+		for (int l = 0; l < tileLevels; ++l)
+			glClearTexImage(m_tileTextures[i], l, GL_RGBA, GL_UNSIGNED_BYTE, color);
+		glTextureParameteri(m_tileTextures[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		m_residency.addMaterial({ m_residency.addTexture(m_tileTextures[i], tileBytes), ARMIndex });
+
+		// The quad (z = -1, 6 units wide) moved on the floor (y = -3), 0.9 units wide
+		glm::mat4 model = glm::translate(glm::mat4(1), glm::vec3(x - NumTiles / 2 + 0.5f, -3, z - NumTiles / 2 + 0.5f));
+		model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1, 0, 0));
+		model = glm::scale(model, glm::vec3(0.15f));
+		m_tileModels.push_back(glm::translate(model, glm::vec3(0, 0, 1)));
+		m_tileSpheres.push_back(glm::vec4(glm::vec3(m_tileModels.back()[3]), 0.9f * std::sqrt(2.0f) / 2.0f));
 	}
-	else {
-		std::cout << "Load texture -- OpenGL ID: " << m_textureARMID << "\n";
-	}
-	m_handleARM = glGetTextureHandleARB(m_textureARMID);
-	glMakeTextureHandleResidentARB(m_handleARM);
+	m_tileVisible.resize(m_tileModels.size());
+
+	// Draw data and commands of all the draws at most
+	const std::size_t maxDraws = 1 + m_tileModels.size();
+	glCreateBuffers(1, &m_drawBuffer);
+	glNamedBufferStorage(m_drawBuffer, maxDraws * sizeof(DrawData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(1, &m_commandBuffer);
+	glNamedBufferStorage(m_commandBuffer, maxDraws * sizeof(DrawArraysCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
 	// build and compile our shader program
 	const std::string directory = SHADERS_DIR;
@@ -169,11 +227,9 @@ int MainWindow::InitializeGL()
 	m_uniforms.mvMatrix = m_mainShader->uniformLocation("mvMatrix");
 	m_uniforms.projMatrix = m_mainShader->uniformLocation("projMatrix");
 	m_uniforms.normalMatrix = m_mainShader->uniformLocation("normalMatrix");
-	m_uniforms.textureDiffuse = m_mainShader->uniformLocation("texDiffuse");
-	m_uniforms.textureARM = m_mainShader->uniformLocation("texARM");
 	m_uniforms.activateARM = m_mainShader->uniformLocation("activateARM");
 	if (m_uniforms.mvMatrix == -1 || m_uniforms.projMatrix == -1 || m_uniforms.normalMatrix == -1 ||
-		m_uniforms.textureDiffuse == -1 || m_uniforms.textureARM == -1 || m_uniforms.activateARM == -1) {
+		m_uniforms.activateARM == -1) {
 		std::cerr << "Error when loading uniform variables\n";
 		return 5;
 	}
@@ -195,6 +251,8 @@ int MainWindow::InitializeGL()
 	glEnableVertexAttribArray(locNormal);
 
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	// The floor is seen behind the plane
+	glEnable(GL_DEPTH_TEST);
 
 	updateCameraEye();
 	FramebufferSizeCallback(SCR_WIDTH, SCR_HEIGHT);
@@ -245,6 +303,16 @@ void MainWindow::RenderImgui()
 		}
 		ImGui::Checkbox("Activate (ARM)", &m_activateARM);
 
+		// Residency of the handles
+		if (ImGui::SliderFloat("Budget (MB)", &m_budgetMB, 1.0f, 128.0f)) {
+			m_residency.setBudget(std::size_t(m_budgetMB * (1 << 20)));
+		}
+		ImGui::Text("Textures: %zu, resident: %zu (%.1f MB)", m_residency.numTextures(),
+			m_residency.numResident(), m_residency.residentBytes() / float(1 << 20));
+		ImGui::Text("Residency changes: +%zu -%zu, total %zu", m_residency.madeResident(),
+			m_residency.madeNonResident(), m_residency.churn());
+		ImGui::Text("Draws: %zu (one multi draw)", m_numDraws);
+
 		bool updateCamera = ImGui::SliderFloat("Left Right Slider", &m_longitude, -180.0f, 180.0f);
 		updateCamera |= ImGui::SliderFloat("Up Down Slider", &m_latitude, -89.f, 89.f);
 		updateCamera |= ImGui::SliderFloat("Forward Backward Slider", &m_distance, 2.f, 14.f);
@@ -261,16 +329,12 @@ void MainWindow::RenderImgui()
 
 void MainWindow::RenderScene()
 {
-	glClear(GL_COLOR_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glBindVertexArray(m_VAOs[Triangles]);
 
 	glUseProgram(m_mainShader->programId());
 	m_mainShader->setBool(m_uniforms.activateARM, m_activateARM);
 
-	// Note that binding point are configured inside the shader
-	glUniformHandleui64ARB(m_uniforms.textureDiffuse, m_handleDiffuse);
-	glUniformHandleui64ARB(m_uniforms.textureARM, m_handleARM);
-	
 	// Camera specification (for the shader)
 	glm::mat4 lookAt = glm::lookAt(m_eye, m_at, m_up);
 	m_mainShader->setMat4(m_uniforms.mvMatrix, lookAt);
@@ -279,7 +343,30 @@ void MainWindow::RenderScene()
 	glm::mat3 NoramlMat = glm::inverseTranspose(glm::mat3(lookAt));
 	m_mainShader->setMat3(m_uniforms.normalMatrix, NoramlMat);
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, NumVertices);
+	// The plane, and the tiles in the view frustum: only their textures need to be resident
+	glm::vec4 planes[6];
+	Camera::frustumPlanes(m_proj * lookAt, planes);
+	std::vector<DrawData> draws;
+	draws.push_back({ glm::mat4(1), 0, {} });
+	Camera::cullSpheres(planes, m_tileSpheres.data(), m_tileSpheres.size(), m_tileVisible.data());
+	for (std::size_t i = 0; i < m_tileModels.size(); ++i) {
+		if (m_tileVisible[i])
+			draws.push_back({ m_tileModels[i], GLuint(1 + i), {} });
+	}
+	for (const DrawData& draw : draws)
+		m_residency.useMaterial(int(draw.material));
+	m_residency.update();
+
+	// All the draws at once: each one reads its material in the SSBO, without any texture binding
+	std::vector<DrawArraysCommand> commands(draws.size(), { NumVertices, 1, 0, 0 });
+	glNamedBufferSubData(m_drawBuffer, 0, draws.size() * sizeof(DrawData), draws.data());
+	glNamedBufferSubData(m_commandBuffer, 0, commands.size() * sizeof(DrawArraysCommand), commands.data());
+	m_residency.bind(0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_drawBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawArraysIndirect(GL_TRIANGLE_STRIP, nullptr, GLsizei(draws.size()), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	m_numDraws = draws.size();
 }
 
 
@@ -300,6 +387,7 @@ int MainWindow::RenderLoop()
 	}
 
 	// Cleanup
+	m_residency.clear();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -318,42 +406,3 @@ void MainWindow::updateCameraEye()
 	longitude= glm::rotate(longitude, glm::radians(m_longitude), glm::vec3(0, 1, 0));
 	m_eye = longitude * latitude * glm::vec4(m_eye,1);
 }
-
-bool MainWindow::loadTexture(const std::string& path, unsigned int& textureID, GLint uvMode, GLint minMode, GLint magMode)
-{
-	// OpenGL 4.6 -- need to specify the texture type
-	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-
-	// Ask the library to flip the image horizontally
-	// This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-	// whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-	stbi_set_flip_vertically_on_load(true);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-	if (data)
-	{
-		glTextureStorage2D(textureID, 1, GL_RGBA8, width, height);
-		glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		if (minMode == GL_LINEAR_MIPMAP_LINEAR) {
-			glGenerateTextureMipmap(textureID);
-		}
-
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, minMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, magMode);
-
-		stbi_image_free(data);
-
-		std::cout << "Texture loaded at path: " << path << std::endl;
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-		return false;
-	}
-
-	return true;
-}
\ No newline at end of file
@@ -1,9 +1,16 @@
 #version 460 core
 #extension GL_ARB_bindless_texture : require 
 
-// Texture
-layout(bindless_sampler) uniform sampler2D texDiffuse;
-layout(bindless_sampler) uniform sampler2D texARM;
+// Texture handles of the materials, resident or replaced by fallbacks (see TextureResidency)
+struct Material
+{
+    uvec2 diffuse;
+    uvec2 ARM;
+};
+layout(std430, binding = 0) readonly buffer Materials
+{
+    Material materials[];
+};
 
 uniform bool activateARM;
 
@@ -11,6 +18,7 @@ in vec2 fUV;
 in vec3 fNormal;
 in vec3 fViewDirection;
 in vec3 fPosition;
+flat in uint fMaterial;
 
 out vec4 fColor;
 
@@ -26,6 +34,8 @@ main()
     float cosTheta = dot(nfNormal, LightDirection);
 
     // Retrive color from the texture
+    sampler2D texDiffuse = sampler2D(materials[fMaterial].diffuse);
+    sampler2D texARM = sampler2D(materials[fMaterial].ARM);
     vec4 Kd = texture(texDiffuse, fUV);
     vec3 ARM = texture(texARM, fUV).rgb;
     if(!activateARM) {
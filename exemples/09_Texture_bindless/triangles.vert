@@ -3,6 +3,17 @@ uniform mat4 mvMatrix;
 uniform mat4 projMatrix;
 uniform mat3 normalMatrix;
 
+// Per draw data, see DrawData
+struct Draw
+{
+    mat4 model;
+    uint material;
+};
+layout(std430, binding = 1) readonly buffer Draws
+{
+    Draw draws[];
+};
+
 in vec4 vPosition;
 in vec2 vUV;
 in vec3 vNormal;
@@ -11,13 +22,17 @@ out vec2 fUV;
 out vec3 fNormal;
 out vec3 fViewDirection;
 out vec3 fPosition;
+flat out uint fMaterial;
 
 void main()
 {
-     vec4 vEyeCoord = mvMatrix * vPosition;
+     // The draws of a glMultiDrawArraysIndirect call are told apart by gl_DrawID
+     mat4 model = draws[gl_DrawID].model;
+     vec4 vEyeCoord = mvMatrix * model * vPosition;
 
      fPosition = vEyeCoord.xyz;
-     fNormal = normalMatrix*vNormal;
+     fNormal = normalMatrix*mat3(model)*vNormal;
+     fMaterial = draws[gl_DrawID].material;
      fUV = vUV;
      fViewDirection = -vEyeCoord.xyz;
 
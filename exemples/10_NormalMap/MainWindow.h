@@ -6,12 +6,12 @@
 
 #include <iostream>
 #include <memory>
-#include <tuple>
+#include <vector>
 
 #include "ShaderProgram.h"
-
-typedef std::tuple<glm::vec3, glm::vec3, glm::vec3> vec3x3;
-typedef std::tuple<glm::vec2, glm::vec2, glm::vec2> vec2x3;
+#include "TextureLoader.h"
+#include "OBJLoader.h"
+#include "NormalGenerator.h"
 
 class MainWindow
 {
@@ -37,12 +37,8 @@ private:
 
 	void updateCameraEye();
 
-	bool loadTexture(const std::string& path, unsigned int& textureID,
-		GLint uvMode, // UV/ST warp mode
-		GLint minMode,  // Minfication
-		GLint magMode); // Magnification
-	
-	glm::vec3 computeTangentFace(vec3x3 pos, vec2x3 uvs) const;
+	// Upload the vertices, tangents and indices of a mesh in the buffers of a VAO
+	void uploadMesh(int vaoID, const OBJLoader::Mesh& mesh, const std::vector<OBJLoader::Tangent>& tangents);
 
 private:
 	// settings
@@ -54,25 +50,31 @@ private:
 	float m_distance = 8.0f;
 	bool m_activateARM = true;
 	bool m_activateNormalMap = true;
+	int m_currentMesh = 1; // VAO drawn (Quad or Model)
 
 	float m_light_theta = 0.0f;
 	float m_light_phi = 0.0f;
 
 	glm::vec3 m_eye, m_at, m_up;
 	glm::mat4 m_proj;
+	int m_viewportHeight = 1;
 
 	unsigned int m_diffTexID = -1 ;
 	unsigned int m_normalTexID = -1;
 	unsigned int m_ARMTexID = -1;
 
-	enum VAO_IDs { Triangles, NumVAOs };
-	enum Buffer_IDs { Position, UV, Normal, Tangent, NumBuffers };
+	enum VAO_IDs { Quad, Model, NumVAOs };
+	enum Buffer_IDs { Vertices, Tangents, Indices, NumBuffers };
 
 	// GLFW Window
 	GLFWwindow* m_window = nullptr;
 
+	// Textures, decoded by a pool of threads, their finer levels streamed
+	TextureLoader m_textures;
+
 	GLuint m_VAOs[NumVAOs];
-	GLuint m_buffers[NumBuffers];
+	GLuint m_buffers[NumVAOs][NumBuffers];
+	GLsizei m_numIndices[NumVAOs] = { 0, 0 };
 
 	std::unique_ptr<ShaderProgram> m_mainShader = nullptr;
 	struct { 
@@ -1,7 +1,5 @@
 #include "MainWindow.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include "Camera.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -11,9 +9,11 @@
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtx/string_cast.hpp>
 
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+#include <algorithm>
+#include <cstddef>
+#include <thread>
 
-const int NumVertices = 4;
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 MainWindow::MainWindow() :
     m_at(glm::vec3(0, 0, -1)),
@@ -27,6 +27,7 @@ MainWindow::MainWindow() :
 
 void MainWindow::FramebufferSizeCallback(int width, int height) {
     m_proj = glm::perspective(45.0f, float(width) / height, 0.01f, 100.0f);
+    m_viewportHeight = std::max(height, 1);
     glViewport(0, 0, width, height);
 }
 
@@ -93,88 +94,65 @@ void MainWindow::InitializeCallback() {
         });
 }
 
-glm::vec3 MainWindow::computeTangentFace(vec3x3 pos, vec2x3 uvs) const {
-    // Function to compute the tangent from a triangle
-    // 1) Compute edges
-    glm::vec3 e1 = std::get<1>(pos) - std::get<0>(pos);
-    glm::vec3 e2 = std::get<2>(pos) - std::get<0>(pos);
-    // 2) compute uvs diff
-    glm::vec2 uv1 = std::get<1>(uvs) - std::get<0>(uvs);
-    glm::vec2 uv2 = std::get<2>(uvs) - std::get<0>(uvs);
-
-    // Determinant du system de la matrice 2x2. 
-    // https://www.chilimath.com/lessons/advanced-algebra/inverse-of-a-2x2-matrix/
-    // Evaluate directly the product of inverse matrix and [e1, e2]
-    float inv_det = 1.0F / (uv1.x * uv2.y - uv2.x * uv1.y);
-    // first line
-    glm::vec3 t((uv2.y * e1.x - uv1.y * e2.x) * inv_det,
-        (uv2.y * e1.y - uv1.y * e2.y) * inv_det,
-        (uv2.y * e1.z - uv1.y * e2.z) * inv_det);
-    // If want to compute the bitangent
-    // Note that it can be usefull for the headedness
-    /*glm::vec3 b((uv1.x * e2.x - uv2.x * e1.x) * inv_det,
-        (uv1.x * e2.y - uv2.x * e1.y) * inv_det,
-        (uv1.x * e2.z - uv2.x * e1.z) * inv_det);*/
-
-    // Note that normalize might be not necessary
-    // if we iterate over all triangle. In this case,
-    // the area of the triangle will be backed inside the computed tangent
-    return glm::normalize(t);
+void MainWindow::uploadMesh(int vaoID, const OBJLoader::Mesh& mesh, const std::vector<OBJLoader::Tangent>& tangents)
+{
+    glNamedBufferData(m_buffers[vaoID][Vertices], mesh.vertices.size() * sizeof(OBJLoader::Vertex), mesh.vertices.data(), GL_STATIC_DRAW);
+    glNamedBufferData(m_buffers[vaoID][Tangents], tangents.size() * sizeof(OBJLoader::Tangent), tangents.data(), GL_STATIC_DRAW);
+    glNamedBufferData(m_buffers[vaoID][Indices], mesh.indices.size() * sizeof(std::uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(m_VAOs[vaoID], m_buffers[vaoID][Indices]);
+    m_numIndices[vaoID] = GLsizei(mesh.indices.size());
 }
 
 int MainWindow::InitializeGL()
 {
     glCreateVertexArrays(NumVAOs, m_VAOs);
-    glCreateBuffers(NumBuffers, m_buffers);
+    for (int i = 0; i < NumVAOs; ++i) {
+        glCreateBuffers(NumBuffers, m_buffers[i]);
+    }
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
-    glm::vec3 Vertices[NumVertices] = {
-          glm::vec3(-1, -1, -1),
-          glm::vec3( 1, -1, -1),
-          glm::vec3(-1,  1, -1),
-          glm::vec3( 1,  1, -1)
-    };
-    glm::vec2 Uvs[NumVertices] = {
-        glm::vec2( 0, 0 ),
-        glm::vec2( 1, 0 ),
-        glm::vec2( 0, 1 ),
-        glm::vec2( 1, 1 )
-    };
-    glm::vec3 Normals[NumVertices] = {
-        glm::vec3( 0, 0, 1 ),
-        glm::vec3( 0, 0, 1 ),
-        glm::vec3( 0, 0, 1 ),
-        glm::vec3( 0, 0, 1 )
-    };
-    // Handcrafted tangents because it is a simple case
-    // by looking at the texture mapping and vertex position
-    glm::vec3 Tangents[NumVertices] = {
-      glm::vec3( 1, 0, 0 ),
-      glm::vec3( 1, 0, 0 ),
-      glm::vec3( 1, 0, 0 ),
-      glm::vec3( 1, 0, 0 )
+    // A quad, as two triangles
+    OBJLoader::Mesh quad;
+    quad.vertices = {
+        { { -1, -1, -1 }, { 0, 0, 1 }, { 0, 0 } },
+        { {  1, -1, -1 }, { 0, 0, 1 }, { 1, 0 } },
+        { { -1,  1, -1 }, { 0, 0, 1 }, { 0, 1 } },
+        { {  1,  1, -1 }, { 0, 0, 1 }, { 1, 1 } }
     };
+    quad.indices = { 0, 1, 2, 2, 1, 3 };
+
+    // A model loaded from an obj file (the one of 05_GeometryShader)
+    std::string assets_dir = ASSETS_DIR;
+    std::string models_dir = MODELS_DIR;
+    OBJLoader::Loader loader;
+    loader.setIndexed(true);
+    if (!loader.loadFile(models_dir + "susane.obj")) {
+        std::cerr << "Unable to load the model: " << models_dir << "susane.obj" << std::endl;
+        return 4;
+    }
+    // Merge its meshes (they all use the same textures)
+    OBJLoader::Mesh model;
+    for (const OBJLoader::Mesh& mesh : loader.getMeshes()) {
+        const std::uint32_t first = std::uint32_t(model.vertices.size());
+        model.vertices.insert(model.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        for (std::uint32_t index : mesh.indices) {
+            model.indices.push_back(first + index);
+        }
+    }
 
-    // Here an example to compute the tangent
-    // with class formula (general)
-    glm::vec3 t = computeTangentFace(
-        {Vertices[0], Vertices[1], Vertices[2]},
-        {Uvs[0], Uvs[1], Uvs[2]}
-    );
-    std::cout << glm::to_string(t) << "\n";
-
-    // Upload data to the GPU
-    glNamedBufferData(m_buffers[Position], sizeof(Vertices), Vertices, GL_STATIC_DRAW);
-    glNamedBufferData(m_buffers[UV], sizeof(Uvs), Uvs, GL_STATIC_DRAW);
-    glNamedBufferData(m_buffers[Normal], sizeof(Normals), Normals, GL_STATIC_DRAW);
-    glNamedBufferData(m_buffers[Tangent], sizeof(Tangents), Tangents, GL_STATIC_DRAW);
-
-    // Lambda function to configure a given VBO
-    auto configureVBO = [this](int location, int vaoID, int vboID, int nbComp, GLsizei stride) {
-        glVertexArrayVertexBuffer(vaoID, location, vboID, 0, stride);
-        glVertexArrayAttribFormat(vaoID, location, nbComp, GL_FLOAT, GL_FALSE, 0);
-        glVertexArrayAttribBinding(vaoID, location, location);
-        glEnableVertexArrayAttrib(vaoID, location);
+    // Compute the tangents (MikkTSpace, like the tools baking the normal maps)
+    // and upload data to the GPU
+    const std::size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<OBJLoader::Tangent> quadTangents = OBJLoader::generateTangents(quad, numThreads);
+    std::vector<OBJLoader::Tangent> modelTangents = OBJLoader::generateTangents(model, numThreads);
+    uploadMesh(Quad, quad, quadTangents);
+    uploadMesh(Model, model, modelTangents);
+
+    // Lambda function to configure a given attribute, read from the buffer bound to bindingID
+    auto configureAttribute = [this](int location, int vaoID, int bindingID, int nbComp, GLuint offset) {
+        glVertexArrayAttribFormat(m_VAOs[vaoID], location, nbComp, GL_FLOAT, GL_FALSE, offset);
+        glVertexArrayAttribBinding(m_VAOs[vaoID], location, bindingID);
+        glEnableVertexArrayAttrib(m_VAOs[vaoID], location);
     };
 
     // build and compile our shader program
@@ -205,34 +183,34 @@ int MainWindow::InitializeGL()
     glUseProgram(m_mainShader->programId());
 
     int locPos = m_mainShader->attributeLocation("vPosition");
-    configureVBO(locPos, m_VAOs[Triangles], m_buffers[Position], 3, sizeof(glm::vec3));
-
     int locNor = m_mainShader->attributeLocation("vNormal");
-    configureVBO(locNor, m_VAOs[Triangles], m_buffers[Normal], 3, sizeof(glm::vec3));
-
     int locTan = m_mainShader->attributeLocation("vTangent");
-    configureVBO(locTan, m_VAOs[Triangles], m_buffers[Tangent], 3, sizeof(glm::vec3));
-
     int locUV = m_mainShader->attributeLocation("vUV");
-    configureVBO(locUV, m_VAOs[Triangles], m_buffers[UV], 2, sizeof(glm::vec2));
+    for (int i = 0; i < NumVAOs; ++i) {
+        // Binding 0: interleaved vertices, binding 1: tangents
+        glVertexArrayVertexBuffer(m_VAOs[i], 0, m_buffers[i][Vertices], 0, sizeof(OBJLoader::Vertex));
+        glVertexArrayVertexBuffer(m_VAOs[i], 1, m_buffers[i][Tangents], 0, sizeof(OBJLoader::Tangent));
+        configureAttribute(locPos, i, 0, 3, offsetof(OBJLoader::Vertex, position));
+        configureAttribute(locNor, i, 0, 3, offsetof(OBJLoader::Vertex, normal));
+        configureAttribute(locUV, i, 0, 2, offsetof(OBJLoader::Vertex, uv));
+        configureAttribute(locTan, i, 1, 4, 0);
+    }
 
-    std::string assets_dir = ASSETS_DIR;
     std::string diffPath = assets_dir + "concrete_debris_diff_1k.jpg";
     std::string normalPath = assets_dir + "concrete_debris_nor_gl_1k.jpg";
     std::string ARMPath = assets_dir + "concrete_debris_arm_1k.jpg";
     std::string dispPath = assets_dir + "concrete_debris_disp_1k.jpg";
 
 
-    if (!loadTexture(diffPath, m_diffTexID, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-        std::cerr << "Unable to load texture: " << diffPath << std::endl;
-        return 4;
-    }
-    if (!loadTexture(normalPath, m_normalTexID, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-        std::cerr << "Unable to load texture: " << normalPath << std::endl;
-        return 4;
-    }
-    if (!loadTexture(ARMPath, m_ARMTexID, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR)) {
-        std::cerr << "Unable to load texture: " << ARMPath << std::endl;
+    // The three images are decoded at the same time by the workers of the loader.
+    // Only their small levels are uploaded before the first frame, the others
+    // are streamed by the updates of the render loop
+    m_textures.setStreaming(true);
+    m_diffTexID = m_textures.acquire(diffPath, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::SRGB, TextureCache::Format::BC1);
+    m_normalTexID = m_textures.acquire(normalPath, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::Linear, TextureCache::Format::BC5);
+    m_ARMTexID = m_textures.acquire(ARMPath, GL_CLAMP_TO_BORDER, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, TextureCache::ColorSpace::Linear, TextureCache::Format::BC1);
+    if (!m_textures.finish()) {
+        std::cerr << "Unable to load the textures of " << assets_dir << std::endl;
         return 4;
     }
     
@@ -262,6 +240,8 @@ int MainWindow::InitializeGL()
         m_mainShader->setInt(texLoc, 2);
     }
 
+    glEnable(GL_DEPTH_TEST);
+
     updateCameraEye();
     FramebufferSizeCallback(SCR_WIDTH, SCR_HEIGHT);
 
@@ -287,6 +267,7 @@ void MainWindow::RenderImgui()
         ImGui::SliderFloat("Light Phi", &m_light_phi, -180.0f, 180.0f);
 
         // Options
+        ImGui::Combo("Mesh", &m_currentMesh, "Quad\0Suzanne\0");
         ImGui::Checkbox("Active ARM", &m_activateARM);
         ImGui::Checkbox("Active Normal map", &m_activateNormalMap);
 
@@ -297,6 +278,10 @@ void MainWindow::RenderImgui()
             updateCameraEye();
         }
 
+        // Levels streamed so far (0: full resolution)
+        ImGui::Text("Resident levels: diffuse %d, normal %d, ARM %d",
+            m_textures.residentLevel(m_diffTexID), m_textures.residentLevel(m_normalTexID), m_textures.residentLevel(m_ARMTexID));
+
         ImGui::End();
     }
 
@@ -308,16 +293,21 @@ void MainWindow::RenderImgui()
 void MainWindow::RenderScene()
 {
     // render
-    glClear(GL_COLOR_BUFFER_BIT);
-    glBindVertexArray(m_VAOs[Triangles]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(m_VAOs[m_currentMesh]);
 
     glUseProgram(m_mainShader->programId());
 
     glm::mat4 LookAt = glm::lookAt(m_eye, m_at, m_up);
+    // The model is centered on the origin: move it where the quad is
+    glm::mat4 ModelView = LookAt;
+    if (m_currentMesh == Model) {
+        ModelView = glm::translate(LookAt, glm::vec3(0, 0, -1));
+    }
     // Note: optimized version of glm::transpose(glm::inverse(...))
-    glm::mat3 NormalMat = glm::inverseTranspose(glm::mat3(LookAt));
+    glm::mat3 NormalMat = glm::inverseTranspose(glm::mat3(ModelView));
 
-    m_mainShader->setMat4(m_uniforms.mvMatrix, LookAt);
+    m_mainShader->setMat4(m_uniforms.mvMatrix, ModelView);
     m_mainShader->setMat4(m_uniforms.projMatrix, m_proj);
     m_mainShader->setMat3(m_uniforms.normalMatrix, NormalMat);
     m_mainShader->setBool(m_uniforms.activateARM, m_activateARM);
@@ -331,6 +321,13 @@ void MainWindow::RenderScene()
     ));
     m_mainShader->setVec3(m_uniforms.lightDirection, lightDir);
 
+    // Both meshes are about 2 units wide and mapped once by their UVs: the textures
+    // need the levels down to the size of the mesh on screen
+    const glm::vec3 center = m_currentMesh == Model ? glm::vec3(0, 0, -1) : m_at;
+    const float screenSize = Camera::projectedSize(m_proj, m_viewportHeight, 2.0f, glm::length(m_eye - center));
+    for (GLuint texture : { m_diffTexID, m_normalTexID, m_ARMTexID })
+        m_textures.requestSize(texture, screenSize);
+
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, m_diffTexID);
     glActiveTexture(GL_TEXTURE1);
@@ -338,7 +335,7 @@ void MainWindow::RenderScene()
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, m_ARMTexID);
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, NumVertices);
+    glDrawElements(GL_TRIANGLES, m_numIndices[m_currentMesh], GL_UNSIGNED_INT, 0);
     glFlush();
 }
 
@@ -351,6 +348,7 @@ int MainWindow::RenderLoop()
         if (glfwGetKey(m_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(m_window, true);
 
+        m_textures.update();
         RenderScene();
         RenderImgui();
 
@@ -378,42 +376,3 @@ void MainWindow::updateCameraEye()
     longitude = glm::rotate(longitude, glm::radians(m_longitude), glm::vec3(0, 1, 0));
     m_eye = longitude * latitude * glm::vec4(m_eye,1);
 }
-
-bool MainWindow::loadTexture(const std::string& path, unsigned int& textureID, GLint uvMode, GLint minMode, GLint magMode)
-{
-    glGenTextures(1, &textureID);
-
-    // Ask the library to flip the image horizontally
-    // This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-    // whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-    stbi_set_flip_vertically_on_load(true);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-    if (data)
-    {
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        
-        if (minMode == GL_LINEAR_MIPMAP_LINEAR) {
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, uvMode);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, uvMode);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minMode);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magMode);
-
-        stbi_image_free(data);
-
-        std::cout << "Texture loaded at path: " << path << std::endl;
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-        return false;
-    }
-
-    return true;
-}
\ No newline at end of file
@@ -25,7 +25,10 @@ main()
     vec3 normal;
     if(activateNormalMap) {
         mat3 tbn = mat3(normalize(fTangent), normalize(fBitangent), normalize(fNormal));
-        vec3 normalFromTexture = texture(texNormal, fUV).rgb * 2.0 - vec3(1.0);
+        // The normal map is stored as BC5 (two channels): z is rebuilt from x and y
+        vec3 normalFromTexture;
+        normalFromTexture.xy = texture(texNormal, fUV).rg * 2.0 - vec2(1.0);
+        normalFromTexture.z = sqrt(max(0.0, 1.0 - dot(normalFromTexture.xy, normalFromTexture.xy)));
         normal = normalize(tbn * normalFromTexture);
     } else {
         normal = normalize(fNormal);
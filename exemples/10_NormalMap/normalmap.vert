@@ -6,7 +6,7 @@ uniform mat3 normalMatrix;
 
 in vec4 vPosition;
 in vec3 vNormal;
-in vec3 vTangent;
+in vec4 vTangent; // xyz: tangent, w: handedness (MikkTSpace)
 in vec2 vUV;
 
 out vec2 fUV;
@@ -26,14 +26,15 @@ main()
      
      // Compute normal information
      fNormal = normalize(normalMatrix*vNormal);
-     fTangent = normalize(mat3(mvMatrix)*vTangent); 
+     fTangent = normalize(mat3(mvMatrix)*vTangent.xyz); 
 
      // re-orthogonalize tangent with respect to N
      // to make sure that the two vectors are orthogonal
      fTangent = normalize(fTangent - dot(fTangent, fNormal) * fNormal);
 
      // As the two vectors are orthogonal, we can compute the bitangent vector from cross product
-     fBitangent = cross(fNormal, fTangent);
+     // (flipped where the uv mapping is mirrored)
+     fBitangent = vTangent.w * cross(fNormal, fTangent);
 
      // Texture coordinates
      fUV = vUV;
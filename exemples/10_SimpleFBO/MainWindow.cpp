@@ -11,6 +11,8 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include "OBJLoader.h"
+#include "AsyncMeshLoader.h"
+#include "Camera.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
@@ -130,6 +132,8 @@ int MainWindow::InitializeGL()
 
 	// Load the 3D model from the obj file
 	loadObjFile();
+	// Query counting the fragments of the model passing the depth test (overdraw measurement)
+	glCreateQueries(GL_SAMPLES_PASSED, 1, &m_fragmentQuery);
 	// Create simple plane
 	glCreateVertexArrays(NumVAOs, m_VAOs);
 	glCreateBuffers(NumBuffers, m_buffers);
@@ -216,6 +220,11 @@ void MainWindow::RenderImgui()
 		static int counter = 0;
 
 		ImGui::Begin("Simple FBO");
+		if (m_meshLoader && !m_meshLoader->isDone()) {
+			ImGui::Text("Loading model");
+			ImGui::ProgressBar(m_meshLoader->progress());
+			ImGui::Separator();
+		}
 		ImGui::Checkbox("Active FBO", &m_activeFBO);
 		ImGui::Checkbox("Position tex", &m_usePositionTexture);
 		ImGui::Checkbox("Kuwahara filter", &m_useFilter);
@@ -223,6 +232,13 @@ void MainWindow::RenderImgui()
 			m_filterShader->setInt(2, m_kernelSize);
 		}
 
+		// Fragments passing the depth test, i.e. shaded with early depth test (the model
+		// meshes are ordered to limit the overdraw, see OBJLoader::optimizeOverdraw)
+		ImGui::Text("Fragments shaded: %llu (%.2f per pixel)", (unsigned long long)m_fragmentsShaded,
+			double(m_fragmentsShaded) / double(SCR_WIDTH * SCR_HEIGHT));
+		ImGui::Text("Culled meshes: %zu / %zu", m_culledMeshes, m_meshesGL.size());
+		ImGui::Separator();
+
 		ImGui::Text("Camera settings");
 		bool updateCamera = ImGui::SliderFloat("Longitude", &m_longitude, -180.f, 180.f);
 		updateCamera |= ImGui::SliderFloat("Latitude", &m_latitude, -89.f, 89.f);
@@ -247,6 +263,9 @@ void MainWindow::RenderImgui()
 
 void MainWindow::RenderScene()
 {
+	// Upload the meshes loaded since the last frame
+	updateObjMeshes();
+
 	if (m_activeFBO) {
 		// If true, we will redirect the rendering inside the texture
 		glBindFramebuffer(GL_FRAMEBUFFER, m_fboID);
@@ -272,9 +291,35 @@ void MainWindow::RenderScene()
 	m_mainShader->setVec3(m_mainUniforms.light_position2, viewMatrix * glm::vec4(glm::vec3(m_light_position.x, -m_light_position.y, -m_light_position.z), 1.0));
 
 
-	// Draw the meshes
-	for(const MeshGL& m : m_meshesGL)
+	// Count the fragments shaded by the meshes (the result is read a few frames later,
+	// once available, to avoid stalling the pipeline)
+	if (m_fragmentQueryPending) {
+		GLint available = 0;
+		glGetQueryObjectiv(m_fragmentQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			glGetQueryObjectui64v(m_fragmentQuery, GL_QUERY_RESULT, &m_fragmentsShaded);
+			m_fragmentQueryPending = false;
+		}
+	}
+	const bool countFragments = !m_fragmentQueryPending;
+	if (countFragments) {
+		glBeginQuery(GL_SAMPLES_PASSED, m_fragmentQuery);
+	}
+
+	// Cull the meshes outside of the view frustum, all the bounding spheres at once
+	// (the planes of m_proj * modelViewMatrix are in object space, as the spheres)
+	glm::vec4 planes[6];
+	Camera::frustumPlanes(m_proj * modelViewMatrix, planes);
+	m_meshVisible.resize(m_meshesGL.size());
+	m_culledMeshes = m_meshesGL.size() - Camera::cullSpheres(planes, m_meshSpheres.data(), m_meshSpheres.size(), m_meshVisible.data());
+
+	// Draw the visible meshes
+	for (std::size_t i = 0; i < m_meshesGL.size(); ++i)
 	{
+		const MeshGL& m = m_meshesGL[i];
+		if (!m_meshVisible[i])
+			continue;
+
 		// Set its material properties
 		m_mainShader->setVec3(m_mainUniforms.Kd, m.diffuse);
 		m_mainShader->setVec3(m_mainUniforms.Ks, m.specular);
@@ -282,7 +327,12 @@ void MainWindow::RenderScene()
 
 		// Draw the mesh
 		glBindVertexArray(m.vao);
-		glDrawArrays(GL_TRIANGLES, 0, m.numVertices);
+		glDrawElements(GL_TRIANGLES, m.numVertices, m.indexType, nullptr);
+	}
+
+	if (countFragments) {
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_fragmentQueryPending = true;
 	}
 
 	// Second pass (only if the FBO is activated)
@@ -325,17 +375,21 @@ int MainWindow::RenderLoop()
 	}
 
 	// Clean memory
-	// Delete vaos and vbos
+	// Stop the loading (if still running) and delete vaos and vbos
+	if (m_meshLoader)
+		m_meshLoader->stop();
 	for (const MeshGL& m : m_meshesGL)
 	{
 		// Set material properties
 
 		// Draw the mesh
 		glDeleteVertexArrays(1, &m.vao);
-		glDeleteBuffers(1, &m.vboPosition);
-		glDeleteBuffers(1, &m.vboNormal);
+		glDeleteBuffers(1, &m.vbo);
+		glDeleteBuffers(1, &m.ebo);
 	}
 	m_meshesGL.clear();
+	m_meshSpheres.clear();
+	glDeleteQueries(1, &m_fragmentQuery);
 
 	// Cleanup
 	ImGui_ImplOpenGL3_Shutdown();
@@ -361,21 +415,41 @@ void MainWindow::loadObjFile()
 {
 	std::string assets_dir = ASSETS_DIR;
 	std::string ObjPath = assets_dir + "bunny.obj";
-	// Load the obj file
-	OBJLoader::Loader loader(ObjPath);
+	// Load the obj file in the background through its binary cache (bunny.obj.meshcache).
+	// The first run parses the obj file and writes the cache, the next ones only map it.
+	// The meshes are indexed: vertices shared by several triangles are stored once.
+	// The render loop keeps running: the meshes appear as soon as they are uploaded (see updateObjMeshes)
+	m_meshLoader = std::make_unique<AsyncMeshLoader>(
+		m_mainShader->attributeLocation("vPosition"),
+		m_mainShader->attributeLocation("vNormal"));
+	m_meshLoader->start(ObjPath);
+}
+
+void MainWindow::updateObjMeshes()
+{
+	if (!m_meshLoader || m_meshLoader->isDone())
+		return;
+
+	// Create the GL objects of the loaded meshes, within a per frame upload budget
+	const std::size_t first = m_meshLoader->meshes().size();
+	if (m_meshLoader->update() == 0)
+		return;
 
-	// Create a GL object for each mesh extracted from the OBJ file
 	// Note that if the 3D object have several different material
 	// This will create multiple Mesh objects (one for each different material)
-	const std::vector<OBJLoader::Mesh>& meshes = loader.getMeshes();
-	const std::vector<OBJLoader::Material>& materials = loader.getMaterials();
-	for (unsigned int i = 0; i < meshes.size(); ++i)
+	const std::vector<AsyncMeshLoader::GpuMesh>& meshes = m_meshLoader->meshes();
+	const std::vector<OBJLoader::Material>& materials = m_meshLoader->materials();
+	for (std::size_t i = first; i < meshes.size(); ++i)
 	{
-		if (meshes[i].vertices.size() == 0)
-			continue;
-
 		MeshGL meshGL;
-		meshGL.numVertices = meshes[i].vertices.size();
+		meshGL.vao = meshes[i].vao;
+		meshGL.vbo = meshes[i].vbo;
+		meshGL.ebo = meshes[i].ebo;
+		meshGL.numVertices = meshes[i].count;
+		meshGL.indexType = meshes[i].indexType;
+		// The clusters are not culled in this example
+		if (meshes[i].clusterBuffer != 0)
+			glDeleteBuffers(1, &meshes[i].clusterBuffer);
 
 		// Set material properties of the mesh
 		const float* Kd = materials[meshes[i].materialID].Kd;
@@ -385,31 +459,9 @@ void MainWindow::loadObjFile()
 		meshGL.specular = glm::vec3(Ks[0], Ks[1], Ks[2]);
 		meshGL.specularExponent = materials[meshes[i].materialID].Kn;
 
-		// Create its VAO and VBO object
-		glCreateVertexArrays(1, &meshGL.vao);
-		glCreateBuffers(1, &meshGL.vboPosition);
-		glCreateBuffers(1, &meshGL.vboNormal);
-
-		// Make unique vector to store the vertices and normal
-		std::vector<glm::vec3> vertices;
-		std::vector<glm::vec3> normals;
-		for (const OBJLoader::Vertex& v : meshes[i].vertices)
-		{
-			vertices.push_back(glm::vec3(v.position[0], v.position[1], v.position[2]));
-			normals.push_back(glm::vec3(v.normal[0], v.normal[1], v.normal[2]));
-		}
-
-		// Load the data on the GPU
-		glNamedBufferData(meshGL.vboPosition, sizeof(glm::vec3) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-		glNamedBufferData(meshGL.vboNormal, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STATIC_DRAW);
-		// Configure the VAO
-		glUseProgram(m_mainShader->programId());
-		int PositionLoc = m_mainShader->attributeLocation("vPosition");
-		configureVBO(PositionLoc, meshGL.vao, meshGL.vboPosition, 3, sizeof(glm::vec3));
-		int NormalLoc = m_mainShader->attributeLocation("vNormal");
-		configureVBO(NormalLoc, meshGL.vao, meshGL.vboNormal, 3, sizeof(glm::vec3));
-
 		// Add it to the list
 		m_meshesGL.push_back(meshGL);
+		const OBJLoader::BoundingSphere& sphere = meshes[i].sphere;
+		m_meshSpheres.push_back(glm::vec4(sphere.center[0], sphere.center[1], sphere.center[2], sphere.radius));
 	}
 }
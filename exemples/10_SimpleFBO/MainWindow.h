@@ -10,6 +10,7 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "AsyncMeshLoader.h"
 
 
 class MainWindow
@@ -38,6 +39,7 @@ private:
 	void updateCameraEye();
 
 	void loadObjFile();
+	void updateObjMeshes();
 
 private:
 	// GLFW Window
@@ -82,6 +84,11 @@ private:
 	GLuint m_texID = 0;
 	GLuint m_texIDPos = 0;
 
+	// Fragments shaded by the model (GL_SAMPLES_PASSED query)
+	GLuint m_fragmentQuery = 0;
+	bool m_fragmentQueryPending = false;
+	GLuint64 m_fragmentsShaded = 0;
+
 	// Filter shader
 	std::unique_ptr<ShaderProgram> m_filterShader = nullptr;
 	struct {
@@ -106,15 +113,22 @@ private:
 	{
 		// ID VAO/VBO
 		GLuint vao;
-		GLuint vboPosition;
-		GLuint vboNormal;
+		GLuint vbo; // Interleaved vertices (OBJLoader::Vertex)
+		GLuint ebo;
 
 		// Material information
 		glm::vec3  diffuse;
 		glm::vec3  specular;
 		GLfloat    specularExponent;
 
-		unsigned int numVertices;
+		unsigned int numVertices; // Number of indices
+		GLenum indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
 	};
 	std::vector<MeshGL> m_meshesGL;
+	std::unique_ptr<AsyncMeshLoader> m_meshLoader;
+
+	// Frustum culling of the meshes, from their bounding spheres (object space: center, radius)
+	std::vector<glm::vec4> m_meshSpheres; // One per mesh of m_meshesGL
+	std::vector<std::uint8_t> m_meshVisible;
+	std::size_t m_culledMeshes = 0;
 };
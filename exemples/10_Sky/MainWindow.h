@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "TextureLoader.h"
 #include "Camera.h"
 
 class MainWindow
@@ -33,12 +34,6 @@ private:
 	// Rendering interface ImGUI
 	void RenderImgui();
 
-	bool loadTexture(const std::string& path, 
-		unsigned int& textureID, 
-		GLint uvMode, // UV/ST warp mode
-		GLint minMode,  // Minfication
-		GLint magMode); // Magnification
-
 	void initGeometrySphere();
 
 private:
@@ -88,4 +83,7 @@ private:
 
 	// GLFW Window
 	GLFWwindow* m_window = nullptr;
+
+	// Textures, decoded by a pool of threads
+	TextureLoader m_textures;
 };
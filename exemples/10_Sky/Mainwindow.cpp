@@ -3,9 +3,6 @@
 #include <vector>
 #include <iostream>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -156,7 +153,8 @@ int MainWindow::InitializeGL()
     std::cout << "Load textures ... \n";
     std::string assets_dir = ASSETS_DIR;
     std::string SkydomePath = assets_dir + "skydome2.png";
-    if (!loadTexture(&SkydomePath[0], TextureId, GL_MIRRORED_REPEAT, GL_LINEAR, GL_LINEAR)) {
+    TextureId = m_textures.acquire(SkydomePath, GL_MIRRORED_REPEAT, GL_LINEAR, GL_LINEAR, TextureCache::ColorSpace::SRGB, TextureCache::Format::BC1);
+    if (!m_textures.finish()) {
         std::cerr << "Error when loading image skydome2.png\n";
         return 5;
     }
@@ -270,45 +268,6 @@ int MainWindow::RenderLoop()
     return 0;
 }
 
-bool MainWindow::loadTexture(const std::string& path, unsigned int& textureID, GLint uvMode, GLint minMode, GLint magMode)
-{
-    // OpenGL 4.6 -- need to specify the texture type
-	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-
-	// Ask the library to flip the image horizontally
-	// This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-	// whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-	stbi_set_flip_vertically_on_load(true);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-	if (data)
-	{
-		glTextureStorage2D(textureID, 1, GL_RGBA8, width, height);
-		glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		if (minMode == GL_LINEAR_MIPMAP_LINEAR) {
-			glGenerateTextureMipmap(textureID);
-		}
-
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, minMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, magMode);
-
-		stbi_image_free(data);
-
-		std::cout << "Texture loaded at path: " << path << std::endl;
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-		return false;
-	}
-
-	return true;
-}
-
 void MainWindow::initGeometrySphere()
 {
     // Generate a sphere between [-0.5, 0.5]x[-0.5, 0.5]x[-0.5, 0.5]
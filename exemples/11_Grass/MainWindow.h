@@ -8,6 +8,8 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "TextureLoader.h"
+#include "TextureAtlas.h"
 #include "Camera.h"
 
 class MainWindow
@@ -33,12 +35,6 @@ private:
 	// Rendering interface ImGUI
 	void RenderImgui();
 
-	bool loadTexture(const std::string& path, 
-		unsigned int& textureID, 
-		GLint uvMode, // UV/ST warp mode
-		GLint minMode,  // Minfication
-		GLint magMode); // Magnification
-
 	void generatePoints();
 
 
@@ -59,6 +55,7 @@ private:
 	int m_gridSize = 100;
 	float m_density = 0.3f;
 	bool m_activeWind = false;
+	int m_numSpecies = 3; // Species drawn, among the sprites of the atlas
 
 	// Camera
 	Camera m_camera;
@@ -66,15 +63,21 @@ private:
 
 	// VBO/VAO
 	enum VAO_IDs { VAO_Points, NumVAOs };
-	enum Buffer_IDs { VBO_Points_Pos, VBO_Points_RandomOrientation, NumBuffers };
+	enum Buffer_IDs { VBO_Points_Pos, VBO_Points_RandomOrientation, VBO_Points_Species, NumBuffers };
 	GLuint m_VAOs[NumVAOs];
 	GLuint m_buffers[NumBuffers];
 
-	// Texture for the grass
+	// Texture for the grass: atlas of the species (BC3, mip chain down to 2 texels
+	// by species), and its UV-rect table (SSBO)
+	TextureAtlas m_atlas{ 64 };
 	unsigned int TextureId = -1 ;
+	GLuint m_speciesRectBuffer = 0;
 	// Texture for the wind
 	unsigned int WindTextureId = -1 ;
 
 	// GLFW Window
 	GLFWwindow* m_window = nullptr;
+
+	// Textures, decoded by a pool of threads
+	TextureLoader m_textures;
 };
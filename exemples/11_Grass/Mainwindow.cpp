@@ -3,9 +3,6 @@
 #include <vector>
 #include <iostream>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -125,16 +122,31 @@ int MainWindow::InitializeGL()
     std::cout << "Load textures ... \n";
     std::string assets_dir = ASSETS_DIR;
     std::string GrassPath = assets_dir + "grass_texture.png";
-    if (!loadTexture(&GrassPath[0], TextureId, GL_MIRRORED_REPEAT, GL_LINEAR, GL_LINEAR)) {
-        std::cerr << "Error when loading image grass_texture.png\n";
-        return 5;
-    }
     std::string WindPath = assets_dir + "flowmap.png";
-    if (!loadTexture(&WindPath[0], WindTextureId, GL_REPEAT, GL_LINEAR, GL_LINEAR)) {
+    WindTextureId = m_textures.acquire(WindPath, GL_REPEAT, GL_LINEAR, GL_LINEAR, TextureCache::ColorSpace::Linear);
+    m_textures.finish();
+    if (m_textures.hasFailed(WindTextureId)) {
         std::cerr << "Error when loading image flowmap.png\n";
         return 6;
     }
 
+    // Species of grass (tinted variants of the texture) in one atlas: drawn in a single call
+    const glm::vec4 speciesTints[] = { glm::vec4(1.0f), glm::vec4(1.0f, 0.85f, 0.45f, 1.0f), glm::vec4(0.55f, 0.8f, 0.5f, 1.0f) };
+    for (const glm::vec4& tint : speciesTints) {
+        if (m_atlas.add(GrassPath, tint) < 0) {
+            std::cerr << "Error when loading image grass_texture.png\n";
+            return 5;
+        }
+    }
+    if (!m_atlas.build(TextureCache::ColorSpace::SRGB, 4096, TextureCache::Format::BC3)) {
+        std::cerr << "Error when building the grass atlas\n";
+        return 5;
+    }
+    TextureId = m_atlas.createTexture();
+    m_speciesRectBuffer = m_atlas.createRectBuffer();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_speciesRectBuffer);
+    m_numSpecies = m_atlas.numSprites();
+
     std::cout << "Create geometry ... \n";
     glCreateVertexArrays(NumVAOs, m_VAOs);
     glCreateBuffers(NumBuffers, m_buffers); 
@@ -152,6 +164,11 @@ int MainWindow::InitializeGL()
     glEnableVertexArrayAttrib(m_VAOs[VAO_Points], 1);
     glVertexArrayAttribFormat(m_VAOs[VAO_Points], 1, 1, GL_FLOAT, GL_FALSE, 0);
     glVertexArrayAttribBinding(m_VAOs[VAO_Points], 1, 1);
+    // -- Species (float)
+    glVertexArrayVertexBuffer(m_VAOs[VAO_Points], 2, m_buffers[VBO_Points_Species], 0, sizeof(float));
+    glEnableVertexArrayAttrib(m_VAOs[VAO_Points], 2);
+    glVertexArrayAttribFormat(m_VAOs[VAO_Points], 2, 1, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(m_VAOs[VAO_Points], 2, 2);
 
     // Set uniform (default values) -- otherwise it wont be initialized
     m_grassShader->setFloat(m_uGrass.size, m_grassSize);
@@ -169,6 +186,7 @@ void MainWindow::generatePoints()
 {
     std::vector<glm::vec3> points;
     std::vector<float> randomOrientations;
+    std::vector<float> species;
     points.reserve(m_gridSize * m_gridSize);
     float halfSize = (m_gridSize - 1) * 0.5f;
     for (int i = 0; i < m_gridSize; ++i) {
@@ -185,6 +203,8 @@ void MainWindow::generatePoints()
             // Random orientation
             float randomAngle = (static_cast<float>(rand()) / RAND_MAX) * 6.2831853f; // 2*PI
             randomOrientations.push_back(randomAngle);
+            // Random species (sprite of the atlas)
+            species.push_back(float(rand() % m_numSpecies));
         }
     }
 
@@ -196,6 +216,10 @@ void MainWindow::generatePoints()
         sizeof(float) * randomOrientations.size(),
         randomOrientations.data(),
         GL_STATIC_DRAW);
+    glNamedBufferData(m_buffers[VBO_Points_Species],
+        sizeof(float) * species.size(),
+        species.data(),
+        GL_STATIC_DRAW);
 }
 
 void MainWindow::RenderImgui()
@@ -220,6 +244,9 @@ void MainWindow::RenderImgui()
             generatePoints();
         }
         ImGui::Checkbox("Active Wind", &m_activeWind);
+        if (ImGui::SliderInt("Species", &m_numSpecies, 1, m_atlas.numSprites())) {
+            generatePoints();
+        }
 
         ImGui::End();
     }
@@ -287,42 +314,3 @@ int MainWindow::RenderLoop()
 
     return 0;
 }
-
-bool MainWindow::loadTexture(const std::string& path, unsigned int& textureID, GLint uvMode, GLint minMode, GLint magMode)
-{
-    // OpenGL 4.6 -- need to specify the texture type
-	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-
-	// Ask the library to flip the image horizontally
-	// This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
-	// whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
-	stbi_set_flip_vertically_on_load(true);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
-	if (data)
-	{
-		glTextureStorage2D(textureID, 1, GL_RGBA8, width, height);
-		glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		if (minMode == GL_LINEAR_MIPMAP_LINEAR) {
-			glGenerateTextureMipmap(textureID);
-		}
-
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, uvMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, minMode);
-		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, magMode);
-
-		stbi_image_free(data);
-
-		std::cout << "Texture loaded at path: " << path << std::endl;
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-		return false;
-	}
-
-	return true;
-}
\ No newline at end of file
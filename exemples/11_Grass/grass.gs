@@ -8,12 +8,19 @@ layout (location = 3) uniform float time;
 // Wind texture 
 layout(binding = 1) uniform sampler2D windTex;
 
+// UV-rect of each species in the grass atlas (u0, v0, u1, v1)
+layout(std430, binding = 0) readonly buffer SpeciesRects
+{
+    vec4 speciesRects[];
+};
+
 // Conversion point to quads
 layout (points) in;
 layout (triangle_strip, max_vertices = 36) out;
 
 // Input
 in float vRandomOrientation[];
+flat in int vSpecies[];
 
 // Output with UV 
 out vec2 fUV;
@@ -47,10 +54,11 @@ mat3 rotationZ(float angle) {
 }
 
 void generateGrassQuad(vec4 pos, float halfSize, mat3 rotMat) {
-    fUV = vec2(0.0, 0.0);
+    vec4 rect = speciesRects[vSpecies[0]];
+    fUV = rect.xy;
     gl_Position = projMatrix * mvMatrix *  (pos + vec4(rotMat * vec3(-halfSize, 0.0, 0.0), 0.0));
     EmitVertex();
-    fUV = vec2(1.0, 0.0);
+    fUV = rect.zy;
     gl_Position = projMatrix * mvMatrix * (pos + vec4(rotMat * vec3( halfSize, 0.0, 0.0), 0.0));
     EmitVertex();
 
@@ -73,10 +81,10 @@ void generateGrassQuad(vec4 pos, float halfSize, mat3 rotMat) {
     }
 
     // Top vertices with wind effect
-    fUV = vec2(0.0, 1.0);
+    fUV = rect.xw;
     gl_Position = projMatrix * mvMatrix * (pos + vec4(modelWind * rotMat * vec3(-halfSize, size, 0.0), 0.0));
     EmitVertex();
-    fUV = vec2(1.0, 1.0);
+    fUV = rect.zw;
     gl_Position = projMatrix * mvMatrix * (pos + vec4(modelWind * rotMat * vec3( halfSize, size, 0.0), 0.0));
     EmitVertex();
     EndPrimitive();
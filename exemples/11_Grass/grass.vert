@@ -2,12 +2,15 @@
 
 layout(location = 0) in vec4 vPosition;
 layout(location = 1) in float randomOrientation;
+layout(location = 2) in float species;
 
 out float vRandomOrientation;
+flat out int vSpecies;
 
 void main()
 {
      gl_Position = vPosition; // Sans la projection
      vRandomOrientation = randomOrientation;
+     vSpecies = int(species);
 }
 
@@ -111,8 +111,10 @@ private:
 	unsigned int DepthMapFBO = 0;
 	unsigned int TextureId = 0;
 
-	enum VAO_IDs { CubeVAO, FloorVAO, Plane2DVAO, NumVAOs };
-	enum VBO_IDs { CubePosVBO, CubeNormalVBO, CubeEBO, FloorPosVBO, FloorNormalVBO, Plane2DVBO, NumVBOs };
+	// The Depth VAOs only read the positions (shadow pass), see OBJLoader::buildPositionStream
+	enum VAO_IDs { CubeVAO, CubeDepthVAO, FloorVAO, FloorDepthVAO, Plane2DVAO, NumVAOs };
+	enum VBO_IDs { CubePosVBO, CubeNormalVBO, CubeEBO, CubeDepthPosVBO, CubeDepthEBO, FloorPosVBO, FloorNormalVBO, Plane2DVBO, NumVBOs };
+	GLsizei m_numCubeDepthIndices = 0;
 
 	GLuint m_VAOs[NumVAOs];
 	GLuint VBOs[NumVBOs];
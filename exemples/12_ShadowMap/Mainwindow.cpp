@@ -7,6 +7,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
+#include "OBJLoader.h"
+#include "MeshAdjacency.h"
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 #ifndef M_PI
 #define M_PI (3.14159)
@@ -497,6 +500,26 @@ int MainWindow::InitGeometryCube()
 	// Bind EBO
 	glVertexArrayElementBuffer(m_VAOs[CubeVAO], VBOs[CubeEBO]);
 
+	// Positions only for the shadow pass: the faces split the 8 corners of the cube
+	// in 24 vertices (one normal each), welded back here
+	OBJLoader::Mesh cube;
+	for (int i = 0; i < NumVerticesCube; i++) {
+		OBJLoader::Vertex v = {};
+		for (int k = 0; k < 3; k++) {
+			v.position[k] = VerticesCube[i][k];
+			v.normal[k] = NormalsCube[i][k];
+		}
+		cube.vertices.push_back(v);
+	}
+	cube.indices.assign(&IndicesCube[0][0], &IndicesCube[0][0] + 3 * NumTriCube);
+	OBJLoader::PositionStream depthCube = OBJLoader::buildPositionStream(cube);
+	m_numCubeDepthIndices = GLsizei(depthCube.indices.size());
+
+	glNamedBufferData(VBOs[CubeDepthPosVBO], depthCube.positions.size() * sizeof(float), depthCube.positions.data(), GL_STATIC_DRAW);
+	glNamedBufferData(VBOs[CubeDepthEBO], depthCube.indices.size() * sizeof(GLuint), depthCube.indices.data(), GL_STATIC_DRAW);
+	configureVBO(locPos, m_VAOs[CubeDepthVAO], VBOs[CubeDepthPosVBO], 3, sizeof(glm::vec3));
+	glVertexArrayElementBuffer(m_VAOs[CubeDepthVAO], VBOs[CubeDepthEBO]);
+
 	return 0;
 }
 
@@ -524,6 +547,9 @@ int MainWindow::InitGeometryFloor()
 	int locNormal = m_mainShader->attributeLocation("vNormal");
 	configureVBO(locNormal, m_VAOs[FloorVAO], VBOs[FloorNormalVBO], 3, sizeof(glm::vec3));
 
+	// Positions only for the shadow pass
+	configureVBO(locPos, m_VAOs[FloorDepthVAO], VBOs[FloorPosVBO], 3, sizeof(glm::vec3));
+
 	return 0;
 }
 
@@ -569,14 +595,14 @@ void MainWindow::ShadowRender()
 
 	// Draw the floor
 	m_shadowMapShader->setMat4(m_shadowMapUniforms.MLP, m_lightViewProjMatrix * ModelMatrix);
-	glBindVertexArray(m_VAOs[FloorVAO]);
+	glBindVertexArray(m_VAOs[FloorDepthVAO]);
 	glDrawArrays(GL_TRIANGLE_FAN, 0, NumVerticesFloor);
 
 	// Draw the cube
 	ModelMatrix = glm::translate(ModelMatrix, m_cubePosition);
 	m_shadowMapShader->setMat4(m_shadowMapUniforms.MLP, m_lightViewProjMatrix * ModelMatrix);
-	glBindVertexArray(m_VAOs[CubeVAO]);
-	glDrawElements(GL_TRIANGLES, 3 * NumTriCube, GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(m_VAOs[CubeDepthVAO]);
+	glDrawElements(GL_TRIANGLES, m_numCubeDepthIndices, GL_UNSIGNED_INT, nullptr);
 
 	//Finish drawing and release the framebuffer.
 	glFinish();
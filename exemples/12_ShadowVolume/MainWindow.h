@@ -31,8 +31,8 @@ private:
 	void RenderScene();
 	// Rendering interface ImGUI
 	void RenderImgui();
-	// Rendering Geometry
-	void RenderGeometry(ShaderProgram& prog, bool useColor, bool adjency);
+	// Rendering Geometry with one of the cube VAOs (see VAO_IDs)
+	void RenderGeometry(ShaderProgram& prog, bool useColor, int vao);
 
 	// Geometry
 	int InitGeometryCube();
@@ -71,10 +71,13 @@ private:
 	static const int NumVerticesCube = 4 * NumFacesCube;
 	static const int NumVerticesFloor = 4;
 
-	enum VAO_IDs { CubeVAO, CubeVAOAdjancy, NumVAOs };
-	enum VBO_IDs { CubeVBO, CubeEBO, CubeEBOAdj, NumVBOs };
+	// CubeVAODepth only reads the positions (depth pass), see OBJLoader::buildPositionStream
+	enum VAO_IDs { CubeVAO, CubeVAODepth, CubeVAOAdjancy, NumVAOs };
+	enum VBO_IDs { CubeVBO, CubeEBO, CubeEBOAdj, CubeDepthVBO, CubeDepthEBO, NumVBOs };
 
 	GLuint m_VAOs[NumVAOs];
+	GLsizei m_numIndices[NumVAOs] = {};
+	GLenum m_primitives[NumVAOs] = { GL_TRIANGLES, GL_TRIANGLES, GL_TRIANGLES_ADJACENCY };
 	GLuint VBOs[NumVBOs];
 
 	glm::vec4 m_color;
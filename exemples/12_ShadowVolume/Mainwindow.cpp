@@ -7,9 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
-#include <map>
 #include <vector>
-#include <array>
+#include <cstddef>
+
+#include "OBJLoader.h"
+#include "MeshAdjacency.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 #ifndef M_PI
@@ -158,7 +160,7 @@ int MainWindow::InitializeGL()
 	return 0;
 }
 
-void MainWindow::RenderGeometry(ShaderProgram& prog, bool useColor, bool adjency) {
+void MainWindow::RenderGeometry(ShaderProgram& prog, bool useColor, int vao) {
 	glm::mat4 lookAt = glm::lookAt(m_eye, m_at, m_up);
 	
 	// Draw RED cube
@@ -171,14 +173,8 @@ void MainWindow::RenderGeometry(ShaderProgram& prog, bool useColor, bool adjency
 		prog.setMat4(0, modelViewMatrix);
 		prog.setMat3(2, normalMatrix);
 
-		if (adjency) {
-			glBindVertexArray(m_VAOs[CubeVAOAdjancy]);
-			glDrawElements(GL_TRIANGLES_ADJACENCY, 6 * NumTriCube, GL_UNSIGNED_INT, 0);
-		}
-		else {
-			glBindVertexArray(m_VAOs[CubeVAO]);
-			glDrawElements(GL_TRIANGLES, 3 * NumTriCube, GL_UNSIGNED_INT, 0);
-		}
+		glBindVertexArray(m_VAOs[vao]);
+		glDrawElements(m_primitives[vao], m_numIndices[vao], GL_UNSIGNED_INT, 0);
 	}
 
 	// Draw white cube
@@ -191,14 +187,8 @@ void MainWindow::RenderGeometry(ShaderProgram& prog, bool useColor, bool adjency
 		prog.setMat4(0, modelViewMatrix);
 		prog.setMat3(2, normalMatrix);
 
-		if (adjency) {
-			glBindVertexArray(m_VAOs[CubeVAOAdjancy]);
-			glDrawElements(GL_TRIANGLES_ADJACENCY, 6 * NumTriCube, GL_UNSIGNED_INT, 0);
-		}
-		else {
-			glBindVertexArray(m_VAOs[CubeVAO]);
-			glDrawElements(GL_TRIANGLES, 3 * NumTriCube, GL_UNSIGNED_INT, 0);
-	}
+		glBindVertexArray(m_VAOs[vao]);
+		glDrawElements(m_primitives[vao], m_numIndices[vao], GL_UNSIGNED_INT, 0);
 	}
 }
 
@@ -220,7 +210,7 @@ void MainWindow::RenderScene()
     glDrawBuffer(GL_NONE);
     glEnable(GL_CULL_FACE); // Optional
     glCullFace(GL_BACK);
-    RenderGeometry(*m_mainShader, true, false);
+    RenderGeometry(*m_mainShader, false, CubeVAODepth);
 
     // Pass 2: Stencil - render shadow volumes
     glDepthMask(GL_FALSE);
@@ -233,7 +223,7 @@ void MainWindow::RenderScene()
     m_volumeShader->setMat4(0, lookAt);
     m_volumeShader->setMat4(5, m_proj);
     m_volumeShader->setVec3(4, glm::vec3(lookAt * glm::vec4(m_lightPosition, 1.0)));
-    RenderGeometry(*m_volumeShader, false, true);
+    RenderGeometry(*m_volumeShader, false, CubeVAOAdjancy);
 
     // Pass 3: Final render where stencil == 0
     glEnable(GL_CULL_FACE); // Optional
@@ -244,7 +234,7 @@ void MainWindow::RenderScene()
     glDepthMask(GL_TRUE);
     glDepthFunc(GL_LEQUAL);
     m_mainShader->bind();
-    RenderGeometry(*m_mainShader, true, false);
+    RenderGeometry(*m_mainShader, true, CubeVAO);
 
 }
 
@@ -306,50 +296,6 @@ int MainWindow::RenderLoop()
 	return 0;
 }
 
-bool compare(glm::vec3 a, glm::vec3 b) {
-	if (a.x == b.x) {
-		if (a.y == b.y) {
-			return a.z < b.z;
-		}
-		return a.y < b.y;
-	}
-	return a.x < b.x;
-}
-
-// Order free edge
-struct Edge {
-	glm::vec3 p;
-	glm::vec3 e;
-	Edge(glm::vec3 p1, glm::vec3 p2) {
-		if (p1.x != p2.x) {
-			if (p1.x > p2.x)
-				std::swap(p1, p2);
-			p = p1;
-			e = p2 - p1;
-			return;
-		}
-		if (p1.y != p2.y) {
-			if (p1.y > p2.y)
-				std::swap(p1, p2);
-			p = p1;
-			e = p2 - p1;
-			return;
-		}
-		if (p1.z > p2.z)
-			std::swap(p1, p2);
-		p = p1;
-		e = p2 - p1;
-	}
-};
-struct CompEdge {
-	bool operator()(const Edge& a, const Edge& b) const {
-		if (a.p == b.p) {
-			return compare(a.e, b.e);
-		}
-		return compare(a.p, b.p);
-	}
-};
-
 int MainWindow::InitGeometryCube()
 {
 	// Create cube vertices and faces
@@ -421,108 +367,67 @@ int MainWindow::InitGeometryCube()
 	{ 20, 21, 22 }
 	};
 
-	// Build the map of triangles and shared edges
-	std::map<Edge, std::vector<int>, CompEdge> mapEdgeTriangles;
-	for (int i = 0; i < NumTriCube; i++) {
+	// Store the cube as an indexed OBJLoader mesh, so the same code
+	// works with the meshes of an OBJ file (Loader::setIndexed)
+	OBJLoader::Mesh cube;
+	for (int i = 0; i < NumVerticesCube; i++) {
+		OBJLoader::Vertex v = {};
 		for (int k = 0; k < 3; k++) {
-			auto a = VerticesCube[IndicesCube[i][k]];
-			auto b = VerticesCube[IndicesCube[i][(k + 1) % 3]];
-			auto entry = mapEdgeTriangles.find(Edge(a, b));
-			if (entry != mapEdgeTriangles.end()) {
-				entry->second.push_back(i);
-			}
-			else {
-				mapEdgeTriangles.insert({ Edge(a, b), {i} });
-			}
+			v.position[k] = VerticesCube[i][k];
+			v.normal[k] = NormalsCube[i][k];
 		}
+		cube.vertices.push_back(v);
 	}
-
-	std::cout << "Adjancy map: \n";
-	for (auto e : mapEdgeTriangles) {
-		for (auto t : e.second) {
-			std::cout << t << " ";
-		}
-		std::cout << "\n";
-	}
-
-	std::vector<std::array<int, 6>> indicesAdj;
 	for (int i = 0; i < NumTriCube; i++) {
-		int otherIndices[3] = { -1, -1, -1 };
-		for (int k = 0; k < 3; k++) {
-			auto a = VerticesCube[IndicesCube[i][k]];
-			auto b = VerticesCube[IndicesCube[i][(k + 1) % 3]];
-			auto entry = mapEdgeTriangles.find(Edge(a, b));
-			int idTri;
-			if (entry != mapEdgeTriangles.end()) {
-				// Should have only 2 trianles
-				idTri = entry->second[0];
-				if (idTri == i) {
-					idTri = entry->second[1];
-				}
-			}
-			else {
-				// Unexcepted!
-				std::cerr << "Missing adgency?\n";
-				continue;
-			}
-
-			// Look at the other index with position
-			for (int l = 0; l < 3; l++) {
-				glm::vec3 posOther = VerticesCube[IndicesCube[idTri][l]];
-				glm::vec3 posA = VerticesCube[IndicesCube[i][k]];
-				glm::vec3 posB = VerticesCube[IndicesCube[i][(k + 1) % 3]];
-				if (posOther != posA && posOther != posB) {
-					otherIndices[k] = IndicesCube[idTri][l];
-					break;
-				}
-			}
-		}
-		// Construct final indices
-		indicesAdj.push_back(
-			{
-				IndicesCube[i][0],
-				otherIndices[0],
-				IndicesCube[i][1],
-				otherIndices[1],
-				IndicesCube[i][2],
-				otherIndices[2]
-			}
-		);
+		for (int k = 0; k < 3; k++)
+			cube.indices.push_back(IndicesCube[i][k]);
 	}
 
+	// Indices with the neighbor triangles (GL_TRIANGLES_ADJACENCY): the faces of
+	// the cube do not share their vertices, their edges are matched on the positions
+	std::vector<std::uint32_t> indicesAdj = OBJLoader::generateAdjacencyIndices(cube);
+
 	// Set VAO
 	glBindVertexArray(m_VAOs[CubeVAO]);
 
-	// Fill vertex VBO
-	GLsizeiptr OffsetVertices = 0;
-	GLsizeiptr OffsetNormals = sizeof(VerticesCube);
-	GLsizeiptr DataSize = sizeof(VerticesCube) + sizeof(NormalsCube);
-
+	// Fill vertex VBO (interleaved OBJLoader::Vertex)
 	glBindBuffer(GL_ARRAY_BUFFER, VBOs[CubeVBO]);
-	glBufferData(GL_ARRAY_BUFFER, DataSize, nullptr, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, OffsetVertices, sizeof(VerticesCube), VerticesCube);
-	glBufferSubData(GL_ARRAY_BUFFER, OffsetNormals, sizeof(NormalsCube), NormalsCube);
+	glBufferData(GL_ARRAY_BUFFER, cube.vertices.size() * sizeof(OBJLoader::Vertex), cube.vertices.data(), GL_STATIC_DRAW);
 
 	// Setup shader variables
 	int locPos = m_mainShader->attributeLocation("vPosition");
-	glVertexAttribPointer(locPos, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(OffsetVertices));
+	glVertexAttribPointer(locPos, 3, GL_FLOAT, GL_FALSE, sizeof(OBJLoader::Vertex), BUFFER_OFFSET(offsetof(OBJLoader::Vertex, position)));
 	glEnableVertexAttribArray(locPos);
 	int locNormal = m_mainShader->attributeLocation("vNormal");
-	glVertexAttribPointer(locNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(OffsetNormals));
+	glVertexAttribPointer(locNormal, 3, GL_FLOAT, GL_FALSE, sizeof(OBJLoader::Vertex), BUFFER_OFFSET(offsetof(OBJLoader::Vertex, normal)));
 	glEnableVertexAttribArray(locNormal);
 
 	// Fill in indices VBO
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOs[CubeEBO]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(IndicesCube), IndicesCube, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indices.size() * sizeof(std::uint32_t), cube.indices.data(), GL_STATIC_DRAW);
 
 	glBindVertexArray(m_VAOs[CubeVAOAdjancy]);
 	glBindBuffer(GL_ARRAY_BUFFER, VBOs[CubeVBO]);
-	glVertexAttribPointer(locPos, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(OffsetVertices));
+	glVertexAttribPointer(locPos, 3, GL_FLOAT, GL_FALSE, sizeof(OBJLoader::Vertex), BUFFER_OFFSET(offsetof(OBJLoader::Vertex, position)));
 	glEnableVertexAttribArray(locPos);
-	glVertexAttribPointer(locNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(OffsetNormals));
+	glVertexAttribPointer(locNormal, 3, GL_FLOAT, GL_FALSE, sizeof(OBJLoader::Vertex), BUFFER_OFFSET(offsetof(OBJLoader::Vertex, normal)));
 	glEnableVertexAttribArray(locNormal);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOs[CubeEBOAdj]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6*sizeof(int)*indicesAdj.size(), indicesAdj.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesAdj.size() * sizeof(std::uint32_t), indicesAdj.data(), GL_STATIC_DRAW);
+
+	// Positions only for the depth pass (12 bytes per vertex, the 8 corners of the cube)
+	OBJLoader::PositionStream depthCube = OBJLoader::buildPositionStream(cube);
+	glBindVertexArray(m_VAOs[CubeVAODepth]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[CubeDepthVBO]);
+	glBufferData(GL_ARRAY_BUFFER, depthCube.positions.size() * sizeof(float), depthCube.positions.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(locPos, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), BUFFER_OFFSET(0));
+	glEnableVertexAttribArray(locPos);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOs[CubeDepthEBO]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, depthCube.indices.size() * sizeof(std::uint32_t), depthCube.indices.data(), GL_STATIC_DRAW);
+
+	m_numIndices[CubeVAO] = GLsizei(cube.indices.size());
+	m_numIndices[CubeVAODepth] = GLsizei(depthCube.indices.size());
+	m_numIndices[CubeVAOAdjancy] = GLsizei(indicesAdj.size());
 
 	return 0;
 }
@@ -0,0 +1,258 @@
+#include "AsyncMeshLoader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+
+AsyncMeshLoader::AsyncMeshLoader(GLint positionLocation, GLint normalLocation, GLint uvLocation) :
+    m_positionLocation(positionLocation),
+    m_normalLocation(normalLocation),
+    m_uvLocation(uvLocation)
+{
+}
+
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+    m_cancel.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool AsyncMeshLoader::start(const std::string& objFilename)
+{
+    if (m_thread.joinable()) {
+        std::cerr << "A mesh is already loading\n";
+        return false;
+    }
+
+    std::error_code ec;
+    m_fileBytes = std::filesystem::file_size(objFilename, ec);
+    if (ec)
+        m_fileBytes = 0;
+
+    m_thread = std::thread(&AsyncMeshLoader::run, this, objFilename);
+    return true;
+}
+
+void AsyncMeshLoader::run(std::string objFilename)
+{
+    // Parse (or map the cache of) the file, abandoned as soon as stop() is called
+    if (!m_cache.load(objFilename, true, &m_bytesRead, &m_cancel)) {
+        if (m_cancel.load())
+            return;
+        std::cerr << "Impossible to load " << objFilename << "\n";
+        m_failed.store(true, std::memory_order_release);
+        return;
+    }
+
+    // Quantize the vertices in the bounds of all the meshes, so their shared vertices match
+    const std::vector<OBJLoader::CachedMesh>& meshes = m_cache.getMeshes();
+    const std::size_t numMeshes = meshes.size();
+    if (m_format == VertexFormat::Quantized) {
+        m_quantized.resize(numMeshes);
+        m_quantizationBounds = OBJLoader::computeBounds(nullptr, 0);
+        for (const OBJLoader::CachedMesh& mesh : meshes) {
+            for (int k = 0; k < 3; ++k) {
+                m_quantizationBounds.min[k] = std::min(m_quantizationBounds.min[k], mesh.bounds.min[k]);
+                m_quantizationBounds.max[k] = std::max(m_quantizationBounds.max[k], mesh.bounds.max[k]);
+            }
+        }
+    }
+
+    // Hand the meshes to the rendering thread
+    m_numMeshes.store(numMeshes, std::memory_order_release);
+    for (std::size_t i = 0; i < numMeshes; ++i) {
+        if (m_format == VertexFormat::Quantized)
+            m_quantized[i] = OBJLoader::quantizeVertices(meshes[i].vertices, meshes[i].numVertices, m_quantizationBounds);
+        while (!m_queue.push(i)) {
+            if (m_cancel.load())
+                return;
+            std::this_thread::yield();
+        }
+    }
+    m_loaded.store(true, std::memory_order_release);
+}
+
+std::size_t AsyncMeshLoader::update(std::size_t budgetBytes)
+{
+    std::size_t ready = 0;
+    std::size_t uploaded = 0;
+    while (uploaded < budgetBytes) {
+        // Take the next mesh
+        if (!m_uploading) {
+            std::size_t index;
+            if (!m_queue.pop(index))
+                break;
+            beginUpload(index);
+            if (!m_uploading)
+                continue;
+        }
+
+        uploaded += uploadSlice(budgetBytes - uploaded);
+
+        // The mesh is complete
+        const OBJLoader::CachedMesh& mesh = m_cache.getMeshes()[m_uploadIndex];
+        if (m_uploadOffset == vertexBytes(m_uploadIndex) + mesh.totalIndices() * mesh.indexSize) {
+            if (m_format == VertexFormat::Quantized)
+                m_quantized[m_uploadIndex] = std::vector<OBJLoader::QuantizedVertex>();
+            m_meshes.push_back(m_uploadMesh);
+            m_uploading = false;
+            ++m_numProcessed;
+            ++ready;
+        }
+    }
+
+    // The background thread has finished its work
+    if (isDone() && m_thread.joinable())
+        m_thread.join();
+
+    return ready;
+}
+
+void AsyncMeshLoader::beginUpload(std::size_t index)
+{
+    const OBJLoader::CachedMesh& mesh = m_cache.getMeshes()[index];
+    if (mesh.numVertices == 0) {
+        ++m_numProcessed;
+        return;
+    }
+
+    m_uploadIndex = index;
+    m_uploadOffset = 0;
+    m_uploading = true;
+
+    GpuMesh& gpu = m_uploadMesh;
+    gpu = GpuMesh();
+    gpu.count = GLsizei(mesh.numElements());
+    gpu.indexType = mesh.isIndexed() ? (mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT) : 0;
+    gpu.materialID = mesh.materialID;
+    gpu.bounds = mesh.bounds;
+    gpu.sphere = mesh.sphere;
+    gpu.lods = mesh.lods;
+    if (m_format == VertexFormat::Quantized)
+        OBJLoader::dequantizationTransform(m_quantizationBounds, gpu.positionOffset, gpu.positionScale);
+
+    // The storage is allocated now and filled by uploadSlice
+    glCreateVertexArrays(1, &gpu.vao);
+    glCreateBuffers(1, &gpu.vbo);
+    glNamedBufferStorage(gpu.vbo, vertexBytes(index), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if (mesh.isIndexed()) {
+        glCreateBuffers(1, &gpu.ebo);
+        glNamedBufferStorage(gpu.ebo, mesh.totalIndices() * mesh.indexSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glVertexArrayElementBuffer(gpu.vao, gpu.ebo);
+    }
+    if (mesh.numClusters != 0) {
+        // Small compared to the indices: uploaded at once
+        gpu.numClusters = GLsizei(mesh.numClusters);
+        glCreateBuffers(1, &gpu.clusterBuffer);
+        glNamedBufferStorage(gpu.clusterBuffer, mesh.numClusters * sizeof(OBJLoader::MeshCluster), mesh.clusters, 0);
+    }
+
+    setupVertexArray(gpu.vao, gpu.vbo, m_format, m_positionLocation, m_normalLocation, m_uvLocation);
+}
+
+void AsyncMeshLoader::setupVertexArray(GLuint vao, GLuint vbo, VertexFormat format,
+    GLint positionLocation, GLint normalLocation, GLint uvLocation)
+{
+    // Interleaved attributes
+    const GLint locations[3] = { positionLocation, normalLocation, uvLocation };
+    const GLint sizes[3] = { 3, format == VertexFormat::Quantized ? 2 : 3, 2 };
+    GLenum types[3] = { GL_FLOAT, GL_FLOAT, GL_FLOAT };
+    GLboolean normalized[3] = { GL_FALSE, GL_FALSE, GL_FALSE };
+    GLuint offsets[3] = {
+        offsetof(OBJLoader::Vertex, position),
+        offsetof(OBJLoader::Vertex, normal),
+        offsetof(OBJLoader::Vertex, uv) };
+    GLsizei stride = sizeof(OBJLoader::Vertex);
+    if (format == VertexFormat::Quantized) {
+        // Positions in [0, 1] in their bounds, octahedral normals in [-1, 1], half float uvs
+        types[0] = GL_UNSIGNED_SHORT; normalized[0] = GL_TRUE; offsets[0] = offsetof(OBJLoader::QuantizedVertex, position);
+        types[1] = GL_SHORT; normalized[1] = GL_TRUE; offsets[1] = offsetof(OBJLoader::QuantizedVertex, normal);
+        types[2] = GL_HALF_FLOAT; offsets[2] = offsetof(OBJLoader::QuantizedVertex, uv);
+        stride = sizeof(OBJLoader::QuantizedVertex);
+    }
+    for (int a = 0; a < 3; ++a) {
+        if (locations[a] < 0)
+            continue;
+        glVertexArrayVertexBuffer(vao, locations[a], vbo, 0, stride);
+        glVertexArrayAttribFormat(vao, locations[a], sizes[a], types[a], normalized[a], offsets[a]);
+        glVertexArrayAttribBinding(vao, locations[a], locations[a]);
+        glEnableVertexArrayAttrib(vao, locations[a]);
+    }
+}
+
+const char* AsyncMeshLoader::vertexData(std::size_t index) const
+{
+    if (m_format == VertexFormat::Quantized)
+        return reinterpret_cast<const char*>(m_quantized[index].data());
+    return reinterpret_cast<const char*>(m_cache.getMeshes()[index].vertices);
+}
+
+std::size_t AsyncMeshLoader::vertexBytes(std::size_t index) const
+{
+    const std::size_t vertexSize = (m_format == VertexFormat::Quantized) ? sizeof(OBJLoader::QuantizedVertex) : sizeof(OBJLoader::Vertex);
+    return m_cache.getMeshes()[index].numVertices * vertexSize;
+}
+
+std::size_t AsyncMeshLoader::uploadSlice(std::size_t budgetBytes)
+{
+    const OBJLoader::CachedMesh& mesh = m_cache.getMeshes()[m_uploadIndex];
+    const std::size_t vertexBytes = this->vertexBytes(m_uploadIndex);
+    const std::size_t indexBytes = mesh.totalIndices() * mesh.indexSize; // Levels of detail included
+
+    std::size_t uploaded = 0;
+    if (m_uploadOffset < vertexBytes) {
+        const std::size_t size = std::min(budgetBytes, vertexBytes - m_uploadOffset);
+        glNamedBufferSubData(m_uploadMesh.vbo, m_uploadOffset, size,
+            vertexData(m_uploadIndex) + m_uploadOffset);
+        m_uploadOffset += size;
+        uploaded += size;
+    }
+    if (m_uploadOffset >= vertexBytes && uploaded < budgetBytes && indexBytes != 0) {
+        const std::size_t offset = m_uploadOffset - vertexBytes;
+        const std::size_t size = std::min(budgetBytes - uploaded, indexBytes - offset);
+        glNamedBufferSubData(m_uploadMesh.ebo, offset, size,
+            static_cast<const char*>(mesh.indices) + offset);
+        m_uploadOffset += size;
+        uploaded += size;
+    }
+    return uploaded;
+}
+
+void AsyncMeshLoader::stop()
+{
+    m_cancel.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_uploading) {
+        glDeleteVertexArrays(1, &m_uploadMesh.vao);
+        glDeleteBuffers(1, &m_uploadMesh.vbo);
+        if (m_uploadMesh.ebo != 0)
+            glDeleteBuffers(1, &m_uploadMesh.ebo);
+        if (m_uploadMesh.clusterBuffer != 0)
+            glDeleteBuffers(1, &m_uploadMesh.clusterBuffer);
+        m_uploading = false;
+    }
+}
+
+float AsyncMeshLoader::progress() const
+{
+    const std::size_t numMeshes = m_numMeshes.load(std::memory_order_acquire);
+    if (numMeshes == 0) {
+        if (m_loaded.load(std::memory_order_acquire))
+            return 1.0f;
+        if (m_fileBytes == 0)
+            return 0.0f;
+        // Parsing (stays at 0 when the cache is valid: it is mapped almost instantly)
+        return 0.5f * std::min(1.0f, float(m_bytesRead.load(std::memory_order_relaxed)) / float(m_fileBytes));
+    }
+    return 0.5f + 0.5f * float(m_numProcessed) / float(numMeshes);
+}
+
+bool AsyncMeshLoader::isDone() const
+{
+    return hasFailed() ||
+        (m_loaded.load(std::memory_order_acquire) && !m_uploading && m_numProcessed == m_numMeshes.load(std::memory_order_acquire));
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MeshCache.h"
+#include "VertexQuantizer.h"
+#include "SpscQueue.h"
+
+// Load the meshes of an OBJ file on a background thread and create their
+// OpenGL objects on the rendering thread, a few at a time, so the render loop
+// keeps drawing while the file loads.
+//
+// - The background thread loads the file through its MeshCache (parsing the
+//   OBJ file only when the cache is missing or outdated) and hands each mesh
+//   to the rendering thread through a lock-free queue. stop() and the destructor
+//   interrupt a first load between the steps of the parsing and between meshes.
+// - update() is called once per frame on the rendering thread. It uploads at
+//   most budgetBytes of vertex/index data per call (a large mesh is uploaded
+//   over several frames) and returns the number of meshes that became ready.
+class AsyncMeshLoader
+{
+public:
+    // OpenGL objects of a loaded mesh.
+    // They belong to the caller once the mesh is listed in meshes().
+    struct GpuMesh
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0; // Interleaved vertices (OBJLoader::Vertex)
+        GLuint ebo = 0; // 0 for a triangle soup
+        GLsizei count = 0; // Number of vertices to draw
+        GLenum indexType = 0; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (0: triangle soup)
+        std::size_t materialID = 0;
+        OBJLoader::Bounds bounds;
+        OBJLoader::BoundingSphere sphere; // For frustum culling (see Camera::cullSpheres)
+        std::vector<OBJLoader::CachedLod> lods; // Drawn from the same element buffer (see OBJLoader::selectLod)
+        GLuint clusterBuffer = 0; // OBJLoader::MeshCluster array, for culling (0 if none)
+        GLsizei numClusters = 0;
+        // Quantized vertices: position = positionOffset + positionScale * vPosition
+        // (see OBJLoader::dequantizationTransform), identity otherwise
+        float positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+        float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+    };
+
+    // Vertex buffer layout
+    enum class VertexFormat
+    {
+        Float,    // OBJLoader::Vertex (32 bytes)
+        Quantized // OBJLoader::QuantizedVertex (16 bytes), quantized in the bounds of the whole file
+    };
+
+    static const std::size_t DefaultBudget = 4 << 20;
+
+    // Attribute locations of the position, normal and uv (-1 if not used by the shader)
+    AsyncMeshLoader(GLint positionLocation, GLint normalLocation, GLint uvLocation = -1);
+    // Wait for the background thread (the OpenGL objects are not deleted here, see stop())
+    ~AsyncMeshLoader();
+
+    AsyncMeshLoader(const AsyncMeshLoader&) = delete;
+    AsyncMeshLoader& operator=(const AsyncMeshLoader&) = delete;
+
+    // ------------------------------------------------------------------------
+    // choose the vertex buffer layout (before start)
+    void setVertexFormat(VertexFormat format) { m_format = format; }
+    VertexFormat vertexFormat() const { return m_format; }
+
+    // ------------------------------------------------------------------------
+    // bind vbo to the attributes of vao, for a vertex buffer of the given format
+    // (attribute locations: -1 if not used by the shader)
+    static void setupVertexArray(GLuint vao, GLuint vbo, VertexFormat format,
+        GLint positionLocation, GLint normalLocation, GLint uvLocation);
+
+    // ------------------------------------------------------------------------
+    // start loading the OBJ file on the background thread
+    // return false if a loading is already running
+    bool start(const std::string& objFilename);
+
+    // ------------------------------------------------------------------------
+    // create the OpenGL objects of the loaded meshes (rendering thread only)
+    // return the number of meshes added to meshes() during this call
+    std::size_t update(std::size_t budgetBytes = DefaultBudget);
+
+    // ------------------------------------------------------------------------
+    // stop the background thread and delete the OpenGL objects of the mesh
+    // being uploaded (rendering thread only, with the OpenGL context current)
+    void stop();
+
+    // Meshes ready to be drawn, in loading order (rendering thread only)
+    const std::vector<GpuMesh>& meshes() const { return m_meshes; }
+    // Materials of the file (valid once a mesh is ready)
+    const std::vector<OBJLoader::Material>& materials() const { return m_cache.getMaterials(); }
+
+    // Loading progress in [0, 1]: parsing first, then the upload of the meshes
+    float progress() const;
+    bool isDone() const;
+    bool hasFailed() const { return m_failed.load(std::memory_order_acquire); }
+
+private:
+    // Background thread
+    void run(std::string objFilename);
+
+    // Upload steps of the current mesh (rendering thread)
+    void beginUpload(std::size_t index);
+    std::size_t uploadSlice(std::size_t budgetBytes);
+    // Vertices of a mesh, in the vertex format
+    const char* vertexData(std::size_t index) const;
+    std::size_t vertexBytes(std::size_t index) const;
+
+private:
+    // Attribute locations
+    GLint m_positionLocation;
+    GLint m_normalLocation;
+    GLint m_uvLocation;
+    VertexFormat m_format = VertexFormat::Float;
+
+    // Background loading
+    std::thread m_thread;
+    OBJLoader::MeshCache m_cache; // Written by the background thread before the meshes are queued
+    SpscQueue<std::size_t> m_queue; // Index of the meshes ready to be uploaded
+    std::vector<std::vector<OBJLoader::QuantizedVertex>> m_quantized; // Written before the mesh is queued
+    OBJLoader::Bounds m_quantizationBounds;
+    std::atomic<bool> m_cancel{ false };
+    std::atomic<bool> m_failed{ false };
+    std::atomic<bool> m_loaded{ false }; // All the meshes are queued
+    std::atomic<std::size_t> m_numMeshes{ 0 };
+    std::atomic<std::size_t> m_bytesRead{ 0 };
+    std::size_t m_fileBytes = 0;
+
+    // Upload on the rendering thread
+    bool m_uploading = false;
+    std::size_t m_uploadIndex = 0;
+    std::size_t m_uploadOffset = 0; // Bytes uploaded: vertices first, then indices
+    GpuMesh m_uploadMesh;
+    std::size_t m_numProcessed = 0; // Meshes uploaded or skipped
+    std::vector<GpuMesh> m_meshes;
+};
@@ -0,0 +1,54 @@
+#include "CacheFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+bool CacheFile::sourceStamp(const std::string& filename, std::uint64_t& size, std::int64_t& time)
+{
+  std::error_code ec;
+  size = std::filesystem::file_size(filename, ec);
+  if (ec)
+    return false;
+  std::filesystem::file_time_type t = std::filesystem::last_write_time(filename, ec);
+  if (ec)
+    return false;
+  time = static_cast<std::int64_t>(t.time_since_epoch().count());
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool CacheFile::write(const std::string& filename, const std::vector<char>& content)
+{
+  const std::string tmpFilename = filename + ".tmp";
+  bool written = false;
+  {
+    std::ofstream file(tmpFilename.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (file.is_open())
+    {
+      file.write(content.data(), content.size());
+      written = bool(file);
+    }
+  }
+
+  std::error_code ec;
+  if (written)
+  {
+    std::filesystem::rename(tmpFilename, filename, ec);
+    written = !ec;
+  }
+  if (!written)
+    std::filesystem::remove(tmpFilename, ec);
+  return written;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool CacheFile::writeOrKeep(const std::string& filename, std::vector<char>& content, std::vector<char>& memory)
+{
+  if (write(filename, content))
+    return true;
+  std::cout << "Warning: Failed to write cache " << filename << ", kept in memory" << std::endl;
+  memory = std::move(content);
+  return false;
+}
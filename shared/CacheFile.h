@@ -0,0 +1,38 @@
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by the cache files written next to their source file (MeshCache,
+// TextureCache, TiledImage): each one is built once, then mapped with MappedFile
+// and read in place.
+namespace CacheFile
+{
+  // Size and modification time of the source file, stored in the cache to detect outdated ones
+  bool sourceStamp(const std::string& filename, std::uint64_t& size, std::int64_t& time);
+
+  // First multiple of alignment at or after offset
+  inline std::size_t alignUp(std::size_t offset, std::size_t alignment)
+  {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  // Check that [offset, offset + size) is inside a file of fileSize bytes
+  inline bool inFile(std::uint64_t offset, std::uint64_t size, std::size_t fileSize)
+  {
+    return offset <= fileSize && size <= fileSize - offset;
+  }
+
+  // Write the content of a cache in a temporary file, renamed once complete: a running
+  // program may have the previous cache mapped
+  bool write(const std::string& filename, const std::vector<char>& content);
+  // Same, but when the cache cannot be written (read-only directory...) its content is
+  // moved in memory instead, for the caller to use it from there.
+  // Return true if the file was written (content is then left as is).
+  bool writeOrKeep(const std::string& filename, std::vector<char>& content, std::vector<char>& memory);
+}
+
+#endif
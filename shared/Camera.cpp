@@ -11,12 +11,18 @@
 
 #include "Camera.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CAMERA_USE_SSE
+#endif
+
 Camera::Camera(int width, int height,
     const glm::vec3& position,
     const glm::vec3& at): 
         m_position(position),
         m_direction(at - position),
-        m_image_ratio(float(width) / height)
+        m_image_ratio(float(width) / height),
+        m_viewport_height(height)
 {;
     m_direction = glm::normalize(m_direction);
     computeAngles();
@@ -83,6 +89,7 @@ void Camera::mouseEvents(const glm::vec2& mousePos, bool clicked) {
 void Camera::viewportEvents(int width, int height) {
     // Update the matrix
     m_image_ratio = float(width) / height;
+    m_viewport_height = height;
     if (m_image_ratio > 1e-6) updateProjectionMatrix();
 }
 
@@ -111,4 +118,64 @@ void Camera::computeAngles() {
 
 void Camera::updateProjectionMatrix() {
     m_proj_matrix = glm::perspective(m_fov, m_image_ratio, 0.1f, 300.0f);
-}
\ No newline at end of file
+}
+float Camera::projectedSize(const glm::mat4& projection, int viewportHeight, float worldSize, float distance) {
+    // projection[1][1] = 1 / tan(fovy / 2): the viewport covers 2 / projection[1][1] units at distance 1
+    return worldSize * projection[1][1] * 0.5f * float(viewportHeight) / std::max(distance, 1e-6f);
+}
+
+void Camera::frustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]) {
+    // Gribb-Hartmann: the clip space conditions -w <= x, y, z <= w, written with the rows of the matrix
+    const glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+    const glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+    const glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+    const glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+    planes[0] = row3 + row0; // Left
+    planes[1] = row3 - row0; // Right
+    planes[2] = row3 + row1; // Bottom
+    planes[3] = row3 - row1; // Top
+    planes[4] = row3 + row2; // Near
+    planes[5] = row3 - row2; // Far
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+std::size_t Camera::cullSpheres(const glm::vec4 planes[6], const glm::vec4* spheres, std::size_t count, std::uint8_t* visible) {
+    std::size_t numVisible = 0;
+    std::size_t i = 0;
+#ifdef CAMERA_USE_SSE
+    // Four spheres per iteration: transposed to x, y, z and radius registers, each plane is
+    // tested against the four of them at once
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&spheres[i][0]);
+        __m128 y = _mm_loadu_ps(&spheres[i + 1][0]);
+        __m128 z = _mm_loadu_ps(&spheres[i + 2][0]);
+        __m128 r = _mm_loadu_ps(&spheres[i + 3][0]);
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+        const __m128 minusR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_set1_ps(planes[p].w));
+            d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(planes[p].y)));
+            d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(planes[p].z)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, minusR));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; ++k) {
+            visible[i + k] = std::uint8_t((mask >> k) & 1);
+            numVisible += visible[i + k];
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const glm::vec3 center(spheres[i]);
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+            inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -spheres[i].w;
+        visible[i] = inside ? 1 : 0;
+        numVisible += visible[i];
+    }
+    return numVisible;
+}
@@ -6,6 +6,8 @@
 
 #include <GLFW/glfw3.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 class Camera {
@@ -48,6 +50,30 @@ public:
     }
     const glm::vec3& position() const { return m_position;  }
     float fieldOfView() const { return m_fov;  }
+
+    // Size in pixels of an object of size worldSize at a distance of the camera
+    // (perspective projection, viewport of viewportHeight pixels). Used to select
+    // the levels of detail from their error (see OBJLoader::selectLod)
+    static float projectedSize(const glm::mat4& projection, int viewportHeight, float worldSize, float distance);
+    // Same with this camera, for an object centered at center
+    float projectedSize(float worldSize, const glm::vec3& center) const {
+        return projectedSize(projectionMatrix(), m_viewport_height, worldSize, glm::length(center - m_position));
+    }
+
+    // Planes (a, b, c, d) of the frustum of a projection, normalized and facing inwards:
+    // p is inside when a * p.x + b * p.y + c * p.z + d >= 0 for the six planes
+    // (left, right, bottom, top, near, far). They are expressed in the space transformed by
+    // matrix: view space for the projection, world space for projection * view, object space
+    // for projection * view * model (uniform scale only, so the distances stay comparable)
+    static void frustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]);
+    // Same with this camera, in world space
+    void frustumPlanes(glm::vec4 planes[6]) const {
+        frustumPlanes(projectionMatrix() * viewMatrix(), planes);
+    }
+    // Test spheres (center in xyz, radius in w) against the frustum planes, four at a time
+    // with SSE2. visible[i] is set to 1 when sphere i intersects the frustum, 0 when it is
+    // completely outside. Return the number of visible spheres.
+    static std::size_t cullSpheres(const glm::vec4 planes[6], const glm::vec4* spheres, std::size_t count, std::uint8_t* visible);
 private:
     // Compute yaw and vertical angles for the view direction
     void computeAngles();
@@ -66,6 +92,7 @@ private:
     // Projection matrix
     const float m_fov = glm::radians(45.0f);
 	float m_image_ratio;
+    int m_viewport_height;
     float m_near = 0.1f;
     float m_far = 100.0f;
     glm::mat4 m_proj_matrix;
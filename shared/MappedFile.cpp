@@ -0,0 +1,158 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filename)
+{
+  open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    close();
+    swap(other);
+  }
+  return *this;
+}
+
+void MappedFile::swap(MappedFile& other) noexcept
+{
+  std::swap(_data, other._data);
+  std::swap(_size, other._size);
+  std::swap(_open, other._open);
+#ifdef _WIN32
+  std::swap(_file, other._file);
+  std::swap(_mapping, other._mapping);
+#endif
+}
+
+#ifdef _WIN32
+
+//--------------------------------------------------------------------------------------------------
+bool MappedFile::open(const std::string& filename)
+{
+  close();
+
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  _file = file;
+  _size = static_cast<std::size_t>(size.QuadPart);
+  _open = true;
+
+  // Windows refuses to map empty files
+  if (_size == 0)
+    return true;
+
+  _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (_mapping != nullptr)
+    _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+  if (_data == nullptr)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void MappedFile::close()
+{
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file)
+    CloseHandle(_file);
+  _data = nullptr;
+  _mapping = nullptr;
+  _file = nullptr;
+  _size = 0;
+  _open = false;
+}
+
+#else
+
+//--------------------------------------------------------------------------------------------------
+bool MappedFile::open(const std::string& filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  _size = static_cast<std::size_t>(st.st_size);
+  _open = true;
+
+  // mmap refuses to map empty files
+  if (_size == 0)
+  {
+    ::close(fd);
+    return true;
+  }
+
+  void* ptr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference on the file
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+  {
+    _size = 0;
+    _open = false;
+    return false;
+  }
+  // The file is read front to back
+  madvise(ptr, _size, MADV_SEQUENTIAL);
+
+  _data = static_cast<const char*>(ptr);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void MappedFile::close()
+{
+  if (_data)
+    munmap(const_cast<char*>(_data), _size);
+  _data = nullptr;
+  _size = 0;
+  _open = false;
+}
+
+#endif
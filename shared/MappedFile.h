@@ -0,0 +1,49 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file mapped in memory (mmap / MapViewOfFile).
+// The content is accessed in place, without copying it in a buffer.
+// The view stays valid until close() is called or the object is destroyed.
+// Nothing is reported on failure: the callers decide whether it is an error.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  // Only one object owns the mapping
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // Map the file in memory, return false if it cannot be opened or mapped
+  // (an empty file is valid, data() is then nullptr)
+  bool open(const std::string& filename);
+  // Release the mapping
+  void close();
+
+  bool isOpen() const { return _open; }
+  const char* data() const { return _data; }
+  std::size_t size() const { return _size; }
+  const char* begin() const { return _data; }
+  const char* end() const { return _data + _size; }
+
+private:
+  void swap(MappedFile& other) noexcept;
+
+  const char* _data = nullptr;
+  std::size_t _size = 0;
+  bool        _open = false;
+
+#ifdef _WIN32
+  void* _file = nullptr;
+  void* _mapping = nullptr;
+#endif
+};
+
+#endif
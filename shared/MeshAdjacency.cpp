@@ -0,0 +1,145 @@
+#include "MeshAdjacency.h"
+
+#include <cstring>
+
+using namespace OBJLoader;
+
+namespace
+{
+  const std::uint32_t Empty = 0xFFFFFFFF;
+
+  // Power of two slot count keeping the load factor under 1/2
+  std::size_t tableSize(std::size_t maxKeys)
+  {
+    std::size_t size = 16;
+    while (size < 2 * maxKeys)
+      size *= 2;
+    return size;
+  }
+
+  inline std::size_t mix(std::uint64_t h)
+  {
+    h *= 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return static_cast<std::size_t>(h ^ (h >> 32));
+  }
+
+  // Bits of a float, with -0 and +0 merged
+  inline std::uint32_t floatBits(float value)
+  {
+    value += 0.0f;
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Number the vertices by position
+std::vector<std::uint32_t> OBJLoader::weldPositions(const std::vector<Vertex>& vertices)
+{
+  std::vector<std::uint32_t> weld(vertices.size());
+  std::vector<std::uint32_t> slots(tableSize(vertices.size()), Empty); // Vertex of each position
+  const std::size_t mask = slots.size() - 1;
+  auto key = [&](std::size_t v, std::uint32_t k[3]) {
+    for (int i = 0; i < 3; ++i)
+      k[i] = floatBits(vertices[v].position[i]);
+  };
+
+  for (std::size_t v = 0; v < vertices.size(); ++v)
+  {
+    std::uint32_t k[3];
+    key(v, k);
+    std::size_t h = mix((std::uint64_t(k[0]) << 32 | k[1]) ^ mix(k[2])) & mask;
+    for (;;)
+    {
+      std::uint32_t& slot = slots[h];
+      if (slot == Empty)
+      {
+        slot = static_cast<std::uint32_t>(v);
+        weld[v] = slot;
+        break;
+      }
+      std::uint32_t other[3];
+      key(slot, other);
+      if (std::memcmp(k, other, sizeof(k)) == 0)
+      {
+        weld[v] = slot;
+        break;
+      }
+      h = (h + 1) & mask;
+    }
+  }
+  return weld;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Welded positions, numbered in order of first use
+PositionStream OBJLoader::buildPositionStream(const Mesh& mesh)
+{
+  const bool indexed = mesh.isIndexed();
+  const std::size_t numCorners = mesh.numElements() / 3 * 3;
+  const std::vector<std::uint32_t> weld = weldPositions(mesh.vertices);
+
+  PositionStream stream;
+  stream.indices.resize(numCorners);
+  std::vector<std::uint32_t> newIndex(mesh.vertices.size(), Empty); // Of each welded vertex
+  for (std::size_t i = 0; i < numCorners; ++i)
+  {
+    const std::uint32_t w = weld[indexed ? mesh.indices[i] : i];
+    if (newIndex[w] == Empty)
+    {
+      newIndex[w] = static_cast<std::uint32_t>(stream.positions.size() / 3);
+      stream.positions.insert(stream.positions.end(), mesh.vertices[w].position, mesh.vertices[w].position + 3);
+    }
+    stream.indices[i] = newIndex[w];
+  }
+  return stream;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Neighbor of each edge, from the directed edges starting at each welded vertex
+std::vector<std::uint32_t> OBJLoader::generateAdjacencyIndices(const Mesh& mesh)
+{
+  const bool indexed = mesh.isIndexed();
+  const std::size_t numCorners = mesh.numElements() / 3 * 3;
+  auto vertexOf = [&](std::size_t corner) { return indexed ? mesh.indices[corner] : static_cast<std::uint32_t>(corner); };
+  auto next = [](std::size_t corner) { return corner - corner % 3 + (corner + 1) % 3; };
+  auto previous = [](std::size_t corner) { return corner - corner % 3 + (corner + 2) % 3; };
+
+  // Welded vertex of each corner
+  const std::vector<std::uint32_t> weld = weldPositions(mesh.vertices);
+  std::vector<std::uint32_t> welded(numCorners);
+  for (std::size_t i = 0; i < numCorners; ++i)
+    welded[i] = weld[vertexOf(i)];
+
+  // Corners of each welded vertex, in order: the directed edges starting there
+  std::vector<std::uint32_t> offsets(mesh.vertices.size() + 1, 0);
+  for (std::size_t i = 0; i < numCorners; ++i)
+    ++offsets[welded[i] + 1];
+  for (std::size_t v = 0; v < mesh.vertices.size(); ++v)
+    offsets[v + 1] += offsets[v];
+  std::vector<std::uint32_t> edges(numCorners);
+  {
+    std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < numCorners; ++i)
+      edges[fill[welded[i]]++] = static_cast<std::uint32_t>(i);
+  }
+
+  // The neighbor of the edge (a, b) is the first triangle with the edge (b, a)
+  std::vector<std::uint32_t> adjacency(2 * numCorners);
+  for (std::size_t i = 0; i < numCorners; ++i)
+  {
+    const std::uint32_t a = welded[i], b = welded[next(i)];
+    std::uint32_t neighbor = Empty;
+    for (std::uint32_t e = offsets[b]; e < offsets[b + 1] && neighbor == Empty; ++e)
+    {
+      if (welded[next(edges[e])] == a)
+        neighbor = edges[e];
+    }
+    adjacency[2 * i] = vertexOf(i);
+    adjacency[2 * i + 1] = (neighbor != Empty) ? vertexOf(previous(neighbor)) : vertexOf(previous(i));
+  }
+  return adjacency;
+}
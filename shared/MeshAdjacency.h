@@ -0,0 +1,35 @@
+#ifndef MESHADJACENCY_H
+#define MESHADJACENCY_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // For each vertex, the first vertex with the same position (compared bit to bit,
+  // -0 and +0 merged): the vertices split by uv or normal seams get the same number.
+  std::vector<std::uint32_t> weldPositions(const std::vector<Vertex>& vertices);
+
+  // Positions only, for the depth only passes (shadow maps, depth pre-pass)
+  struct PositionStream
+  {
+    std::vector<float> positions;        // x, y, z per vertex, tightly packed (stride: 12 bytes)
+    std::vector<std::uint32_t> indices;  // Same triangles as the mesh
+  };
+
+  // Position stream of a mesh (indexed or not): the vertices are welded across the uv and
+  // normal seams (see weldPositions) and numbered in order of first use by the triangles, so
+  // an order optimized for the vertex cache and the vertex fetches (see optimizeMesh) is kept.
+  // The levels of detail are not included.
+  PositionStream buildPositionStream(const Mesh& mesh);
+
+  // Indices for GL_TRIANGLES_ADJACENCY: for each triangle (a, b, c) of the mesh (indexed or not),
+  // the six indices a, ab, b, bc, c, ca, where ab is the third vertex of the neighbor triangle
+  // with the edge (b, a). The positions are welded with an open addressing hash table (see
+  // weldPositions), then the edges are matched in the lists of the edges starting at each welded
+  // vertex: linear time. Edges without such a neighbor (boundary, or neighbor with the opposite
+  // winding) get the third vertex of the triangle itself, so they are always silhouettes.
+  // Non-manifold edges are paired with the first matching triangle.
+  std::vector<std::uint32_t> generateAdjacencyIndices(const Mesh& mesh);
+}
+
+#endif // MESHADJACENCY_H
@@ -0,0 +1,446 @@
+#include "MeshCache.h"
+#include "CacheFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace OBJLoader;
+
+namespace
+{
+  // File layout (native endianness, the cache is a local file):
+  //   FileHeader
+  //   MeshRecord[numMeshes]
+  //   MaterialRecord[numMaterials]
+  //   LibraryRecord[numLibraries]
+  //   names, LodRecord arrays, then vertex, index and cluster blobs (each blob aligned on BlobAlignment bytes).
+  //   The indices of the levels of detail follow the indices of their mesh in the same blob.
+  const char          Magic[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+  const std::uint32_t Version = 7;
+  const std::size_t   BlobAlignment = 64;
+
+  struct FileHeader
+  {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t indexed;
+    std::uint64_t sourceSize;
+    std::int64_t  sourceTime;
+    std::uint64_t numMeshes;
+    std::uint64_t numMaterials;
+    std::uint64_t numLibraries;
+  };
+
+  struct MeshRecord
+  {
+    std::uint64_t verticesOffset;
+    std::uint64_t numVertices;
+    std::uint64_t indicesOffset;
+    std::uint64_t numIndices;
+    std::uint64_t indexSize;
+    std::uint64_t materialID;
+    std::uint64_t nameOffset;
+    std::uint64_t nameLength;
+    std::uint64_t lodsOffset;
+    std::uint64_t numLods;
+    std::uint64_t clustersOffset;
+    std::uint64_t numClusters;
+    Bounds        bounds;
+    BoundingSphere sphere;
+  };
+
+  struct LodRecord
+  {
+    std::uint64_t firstIndex;
+    std::uint64_t numIndices;
+    float         error;
+    std::uint32_t padding;
+  };
+
+  struct MaterialRecord
+  {
+    float         Ka[4];
+    float         Ke[4];
+    float         Kd[4];
+    float         Ks[4];
+    float         Kn;
+    std::uint32_t padding;
+    std::uint64_t nameOffset;
+    std::uint64_t nameLength;
+  };
+
+  // Material file (mtllib) of the OBJ file, its stamp is checked like the one of the OBJ file
+  struct LibraryRecord
+  {
+    std::uint64_t nameOffset;
+    std::uint64_t nameLength;
+    std::uint64_t sourceSize;
+    std::int64_t  sourceTime;
+  };
+
+  // Stamp of a material file, a missing one has its own stamp (the cache is outdated once it appears)
+  void libraryStamp(const std::string& filename, std::uint64_t& size, std::int64_t& time)
+  {
+    if (!CacheFile::sourceStamp(filename, size, time))
+    {
+      size = ~std::uint64_t(0);
+      time = 0;
+    }
+  }
+
+  // Append data at the end of the buffer (at an aligned position if requested)
+  std::uint64_t append(std::vector<char>& buffer, const void* data, std::size_t size, bool aligned)
+  {
+    std::size_t offset = aligned ? CacheFile::alignUp(buffer.size(), BlobAlignment) : buffer.size();
+    buffer.resize(offset + size);
+    if (size != 0)
+      std::memcpy(buffer.data() + offset, data, size);
+    return offset;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructors / Destructors
+MeshCache::MeshCache()
+{}
+
+MeshCache::~MeshCache()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Cache file associated with an OBJ file
+std::string MeshCache::cacheFilename(const std::string& objFilename)
+{
+  return objFilename + ".meshcache";
+}
+
+//--------------------------------------------------------------------------------------------------
+// Open the cache, (re)building it when needed
+bool MeshCache::load(const std::string& objFilename, bool indexed, std::atomic<std::size_t>* bytesRead,
+                     const std::atomic<bool>* cancel)
+{
+  if (open(objFilename, indexed))
+    return true;
+
+  // Missing or outdated: parse the OBJ file and write a new cache
+  Loader loader;
+  loader.setIndexed(indexed);
+  loader.setProgressCounter(bytesRead);
+  loader.setCancelFlag(cancel);
+  if (!loader.loadFile(objFilename, ParseMode::Parallel))
+    return false;
+  if (indexed)
+  {
+    loader.generateLods();
+    loader.optimizeMeshes();
+    loader.buildClusters();
+  }
+  // Stopped in the middle of a step: the meshes are incomplete
+  if (loader.isCanceled())
+    return false;
+  std::vector<char> buffer;
+  if (!serialize(objFilename, loader, buffer))
+    return false;
+  if (CacheFile::writeOrKeep(cacheFilename(objFilename), buffer, _memory))
+    return open(objFilename, indexed);
+
+  // The cache cannot be written (read-only directory...): the meshes are used from memory
+  if (!parse(objFilename, indexed, _memory.data(), _memory.size()))
+  {
+    unload();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the cache file
+bool MeshCache::open(const std::string& objFilename, bool indexed)
+{
+  unload();
+
+  const std::string filename = cacheFilename(objFilename);
+  std::error_code ec;
+  if (!std::filesystem::exists(filename, ec))
+    return false;
+  if (!_file.open(filename))
+    return false;
+  if (!parse(objFilename, indexed, _file.data(), _file.size()))
+  {
+    unload();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point the meshes in the content of a cache file (mapped or in memory)
+bool MeshCache::parse(const std::string& objFilename, bool indexed, const char* data, std::size_t size)
+{
+  std::uint64_t sourceSize = 0;
+  std::int64_t sourceTime = 0;
+  if (!CacheFile::sourceStamp(objFilename, sourceSize, sourceTime))
+    return false;
+
+  // Validate the header
+  const std::string filename = cacheFilename(objFilename);
+  FileHeader header;
+  if (size < sizeof(FileHeader))
+  {
+    unload();
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(FileHeader));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version)
+  {
+    std::cout << "Warning: Invalid mesh cache " << filename << std::endl;
+    unload();
+    return false;
+  }
+  if (header.sourceSize != sourceSize || header.sourceTime != sourceTime || (header.indexed != 0) != indexed)
+  {
+    // Outdated
+    unload();
+    return false;
+  }
+
+  const std::uint64_t meshesOffset = sizeof(FileHeader);
+  const std::uint64_t materialsOffset = meshesOffset + header.numMeshes * sizeof(MeshRecord);
+  const std::uint64_t librariesOffset = materialsOffset + header.numMaterials * sizeof(MaterialRecord);
+  if (!CacheFile::inFile(meshesOffset, header.numMeshes * sizeof(MeshRecord), size) ||
+      !CacheFile::inFile(materialsOffset, header.numMaterials * sizeof(MaterialRecord), size) ||
+      !CacheFile::inFile(librariesOffset, header.numLibraries * sizeof(LibraryRecord), size))
+  {
+    std::cout << "Warning: Truncated mesh cache " << filename << std::endl;
+    unload();
+    return false;
+  }
+
+  // The materials are outdated when one of their files changed
+  for (std::uint64_t i = 0; i < header.numLibraries; ++i)
+  {
+    LibraryRecord r;
+    std::memcpy(&r, data + librariesOffset + i * sizeof(LibraryRecord), sizeof(LibraryRecord));
+    if (!CacheFile::inFile(r.nameOffset, r.nameLength, size))
+    {
+      unload();
+      return false;
+    }
+    std::uint64_t librarySize = 0;
+    std::int64_t libraryTime = 0;
+    libraryStamp(std::string(data + r.nameOffset, r.nameLength), librarySize, libraryTime);
+    if (librarySize != r.sourceSize || libraryTime != r.sourceTime)
+    {
+      // Outdated
+      unload();
+      return false;
+    }
+  }
+
+  // Materials are copied (they are small and hold a std::string)
+  for (std::uint64_t i = 0; i < header.numMaterials; ++i)
+  {
+    MaterialRecord r;
+    std::memcpy(&r, data + materialsOffset + i * sizeof(MaterialRecord), sizeof(MaterialRecord));
+    if (!CacheFile::inFile(r.nameOffset, r.nameLength, size))
+    {
+      unload();
+      return false;
+    }
+
+    Material mat;
+    std::memcpy(mat.Ka, r.Ka, sizeof(mat.Ka));
+    std::memcpy(mat.Ke, r.Ke, sizeof(mat.Ke));
+    std::memcpy(mat.Kd, r.Kd, sizeof(mat.Kd));
+    std::memcpy(mat.Ks, r.Ks, sizeof(mat.Ks));
+    mat.Kn = r.Kn;
+    mat.name.assign(data + r.nameOffset, r.nameLength);
+    _materials.push_back(mat);
+  }
+
+  // Meshes point in the mapped file
+  for (std::uint64_t i = 0; i < header.numMeshes; ++i)
+  {
+    MeshRecord r;
+    std::memcpy(&r, data + meshesOffset + i * sizeof(MeshRecord), sizeof(MeshRecord));
+    if (!CacheFile::inFile(r.verticesOffset, r.numVertices * sizeof(Vertex), size) ||
+        !CacheFile::inFile(r.indicesOffset, r.numIndices * r.indexSize, size) ||
+        !CacheFile::inFile(r.nameOffset, r.nameLength, size) ||
+        !CacheFile::inFile(r.lodsOffset, r.numLods * sizeof(LodRecord), size) ||
+        !CacheFile::inFile(r.clustersOffset, r.numClusters * sizeof(MeshCluster), size) ||
+        r.materialID >= _materials.size())
+    {
+      std::cout << "Warning: Truncated mesh cache " << filename << std::endl;
+      unload();
+      return false;
+    }
+
+    std::vector<CachedLod> lods;
+    for (std::uint64_t l = 0; l < r.numLods; ++l)
+    {
+      LodRecord lr;
+      std::memcpy(&lr, data + r.lodsOffset + l * sizeof(LodRecord), sizeof(LodRecord));
+      if (lr.firstIndex < r.numIndices || !CacheFile::inFile(r.indicesOffset, (lr.firstIndex + lr.numIndices) * r.indexSize, size))
+      {
+        std::cout << "Warning: Truncated mesh cache " << filename << std::endl;
+        unload();
+        return false;
+      }
+      lods.push_back({ lr.firstIndex, lr.numIndices, lr.error });
+    }
+
+    const MeshCluster* clusters = reinterpret_cast<const MeshCluster*>(data + r.clustersOffset);
+    for (std::uint64_t c = 0; c < r.numClusters; ++c)
+    {
+      if (std::uint64_t(clusters[c].firstIndex) + clusters[c].numIndices > r.numIndices)
+      {
+        std::cout << "Warning: Invalid mesh cache " << filename << std::endl;
+        unload();
+        return false;
+      }
+    }
+
+    CachedMesh mesh;
+    mesh.vertices = reinterpret_cast<const Vertex*>(data + r.verticesOffset);
+    mesh.numVertices = r.numVertices;
+    mesh.indices = (r.numIndices != 0) ? data + r.indicesOffset : nullptr;
+    mesh.numIndices = r.numIndices;
+    mesh.indexSize = (r.numIndices != 0) ? r.indexSize : 0;
+    mesh.materialID = r.materialID;
+    mesh.name = std::string_view(data + r.nameOffset, r.nameLength);
+    mesh.bounds = r.bounds;
+    mesh.sphere = r.sphere;
+    mesh.lods = std::move(lods);
+    mesh.clusters = (r.numClusters != 0) ? clusters : nullptr;
+    mesh.numClusters = r.numClusters;
+    _meshes.push_back(std::move(mesh));
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the meshes of a loaded OBJ file in its cache
+bool MeshCache::write(const std::string& objFilename, const Loader& loader)
+{
+  std::vector<char> buffer;
+  return serialize(objFilename, loader, buffer) && CacheFile::write(cacheFilename(objFilename), buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Content of the cache of a loaded OBJ file
+bool MeshCache::serialize(const std::string& objFilename, const Loader& loader, std::vector<char>& buffer)
+{
+  if (!loader.isLoaded())
+    return false;
+
+  FileHeader header;
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.indexed = loader.indexed() ? 1 : 0;
+  if (!CacheFile::sourceStamp(objFilename, header.sourceSize, header.sourceTime))
+    return false;
+
+  const std::vector<Mesh>& meshes = loader.getMeshes();
+  const std::vector<Material>& materials = loader.getMaterials();
+  header.numMeshes = meshes.size();
+  header.numMaterials = materials.size();
+  const std::vector<std::string>& libraries = loader.getMaterialLibraries();
+  header.numLibraries = libraries.size();
+
+  // Header and records first, they are filled once the blobs are placed
+  std::vector<MeshRecord> meshRecords(meshes.size());
+  std::vector<MaterialRecord> materialRecords(materials.size());
+  std::vector<LibraryRecord> libraryRecords(libraries.size());
+  buffer.assign(sizeof(FileHeader) + meshRecords.size() * sizeof(MeshRecord) + materialRecords.size() * sizeof(MaterialRecord) +
+                libraryRecords.size() * sizeof(LibraryRecord), 0);
+
+  for (std::size_t i = 0; i < libraries.size(); ++i)
+  {
+    LibraryRecord& r = libraryRecords[i];
+    libraryStamp(libraries[i], r.sourceSize, r.sourceTime);
+    r.nameOffset = append(buffer, libraries[i].data(), libraries[i].size(), false);
+    r.nameLength = libraries[i].size();
+  }
+
+  for (std::size_t i = 0; i < materials.size(); ++i)
+  {
+    const Material& mat = materials[i];
+    MaterialRecord& r = materialRecords[i];
+    std::memcpy(r.Ka, mat.Ka, sizeof(r.Ka));
+    std::memcpy(r.Ke, mat.Ke, sizeof(r.Ke));
+    std::memcpy(r.Kd, mat.Kd, sizeof(r.Kd));
+    std::memcpy(r.Ks, mat.Ks, sizeof(r.Ks));
+    r.Kn = mat.Kn;
+    r.padding = 0;
+    r.nameOffset = append(buffer, mat.name.data(), mat.name.size(), false);
+    r.nameLength = mat.name.size();
+  }
+
+  for (std::size_t i = 0; i < meshes.size(); ++i)
+  {
+    const Mesh& mesh = meshes[i];
+    MeshRecord& r = meshRecords[i];
+    r.nameOffset = append(buffer, mesh.name.data(), mesh.name.size(), false);
+    r.nameLength = mesh.name.size();
+    r.materialID = mesh.materialID;
+    r.bounds = mesh.bounds;
+    r.sphere = mesh.sphere;
+
+    std::vector<LodRecord> lods;
+    std::size_t firstIndex = mesh.indices.size();
+    for (const MeshLod& lod : mesh.lods)
+    {
+      lods.push_back({ firstIndex, lod.indices.size(), lod.error, 0 });
+      firstIndex += lod.indices.size();
+    }
+    r.numLods = lods.size();
+    r.lodsOffset = append(buffer, lods.data(), lods.size() * sizeof(LodRecord), false);
+
+    r.numVertices = mesh.vertices.size();
+    r.verticesOffset = append(buffer, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), true);
+
+    std::vector<std::uint8_t> indices = mesh.packedIndices();
+    r.numIndices = mesh.indices.size();
+    r.indexSize = mesh.isIndexed() ? mesh.indexSize() : 0;
+    r.indicesOffset = append(buffer, indices.data(), indices.size(), true);
+
+    r.numClusters = mesh.clusters.size();
+    r.clustersOffset = append(buffer, mesh.clusters.data(), mesh.clusters.size() * sizeof(MeshCluster), true);
+  }
+
+  std::size_t offset = 0;
+  std::memcpy(buffer.data() + offset, &header, sizeof(FileHeader));
+  offset += sizeof(FileHeader);
+  if (!meshRecords.empty())
+    std::memcpy(buffer.data() + offset, meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+  offset += meshRecords.size() * sizeof(MeshRecord);
+  if (!materialRecords.empty())
+    std::memcpy(buffer.data() + offset, materialRecords.data(), materialRecords.size() * sizeof(MaterialRecord));
+  offset += materialRecords.size() * sizeof(MaterialRecord);
+  if (!libraryRecords.empty())
+    std::memcpy(buffer.data() + offset, libraryRecords.data(), libraryRecords.size() * sizeof(LibraryRecord));
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Coarsest level of detail with a small enough error on screen
+std::size_t OBJLoader::selectLod(const std::vector<CachedLod>& lods, float pixelsPerUnit, float maxPixelError)
+{
+  std::size_t level = 0;
+  while (level < lods.size() && lods[level].error * pixelsPerUnit <= maxPixelError)
+    ++level;
+  return level;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Clear data
+void MeshCache::unload()
+{
+  _meshes.clear();
+  _materials.clear();
+  _file.close();
+  std::vector<char>().swap(_memory);
+}
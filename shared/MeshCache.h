@@ -0,0 +1,92 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "OBJLoader.h"
+#include "MappedFile.h"
+
+namespace OBJLoader
+{
+  // Level of detail of a cached mesh, its indices are stored after the indices of the mesh
+  struct CachedLod
+  {
+    std::size_t firstIndex; // In the indices of the mesh (byte offset: firstIndex * indexSize)
+    std::size_t numIndices;
+    float       error;      // Estimated distance to the original surface, in object space
+  };
+
+  // Mesh stored in a cache file. The vertex and index arrays point directly
+  // in the mapped file and can be given as is to glNamedBufferStorage.
+  struct CachedMesh
+  {
+    const Vertex* vertices;   // Interleaved vertices (stride: sizeof(Vertex))
+    std::size_t   numVertices;
+    const void*   indices;    // nullptr for a triangle soup
+    std::size_t   numIndices;
+    std::size_t   indexSize;  // 2 or 4 bytes (0 for a triangle soup)
+    std::size_t   materialID;
+    std::string_view name;
+    Bounds        bounds;
+    BoundingSphere sphere;
+    std::vector<CachedLod> lods; // Coarser and coarser
+    const MeshCluster* clusters; // Culling clusters of the indices (nullptr if none), see buildClusters
+    std::size_t   numClusters;
+
+    bool isIndexed() const { return indices != nullptr; }
+    // Number of vertices to draw (glDrawArrays or glDrawElements count)
+    std::size_t numElements() const { return isIndexed() ? numIndices : numVertices; }
+    // Number of indices, levels of detail included (size of the element buffer)
+    std::size_t totalIndices() const { return lods.empty() ? numIndices : lods.back().firstIndex + lods.back().numIndices; }
+  };
+
+  // Level of detail to draw: the coarsest one whose error, once projected, stays under maxPixelError
+  // pixels (pixelsPerUnit: size in pixels of one object space unit, see Camera::projectedSize).
+  // Return 0 for the mesh itself, i for lods[i - 1].
+  std::size_t selectLod(const std::vector<CachedLod>& lods, float pixelsPerUnit, float maxPixelError);
+
+  // Binary container for the meshes of an OBJ file, written next to it ("file.obj.meshcache").
+  // The blobs are aligned so the file can be mapped and used without any parsing.
+  // The cache is outdated (and rebuilt by load) when the size or the modification
+  // time of the OBJ file or of one of its material files changes, or when it was
+  // built with another indexed setting.
+  class MeshCache
+  {
+  public:
+    MeshCache();
+    ~MeshCache();
+
+    // Open the cache of an OBJ file, (re)building it from the OBJ file when needed.
+    // If the cache cannot be written, its content is kept in memory.
+    // (indexed meshes are stored with their levels of detail, optimized for the vertex cache and overdraw,
+    // and split in clusters, see Loader::generateLods, Loader::optimizeMeshes and Loader::buildClusters)
+    // (see Loader::setProgressCounter for bytesRead, Loader::setCancelFlag for cancel: a canceled
+    // load fails without writing the cache)
+    bool load(const std::string& objFilename, bool indexed = true, std::atomic<std::size_t>* bytesRead = nullptr,
+              const std::atomic<bool>* cancel = nullptr);
+    // Map the cache of an OBJ file. Fails if it is missing, invalid or outdated.
+    bool open(const std::string& objFilename, bool indexed = true);
+    bool isLoaded() const { return _file.isOpen() || !_memory.empty(); }
+    void unload();
+
+    const std::vector<CachedMesh>& getMeshes() const { return _meshes; }
+    const std::vector<Material>& getMaterials() const { return _materials; }
+
+    // Write the meshes of a loaded OBJ file in its cache
+    static bool write(const std::string& objFilename, const Loader& loader);
+    // Cache file associated with an OBJ file
+    static std::string cacheFilename(const std::string& objFilename);
+
+  private:
+    // Point the meshes in the content of a cache file (mapped or in memory)
+    // once its header is validated
+    bool parse(const std::string& objFilename, bool indexed, const char* data, std::size_t size);
+    static bool serialize(const std::string& objFilename, const Loader& loader, std::vector<char>& buffer);
+
+  private:
+    MappedFile              _file;
+    std::vector<char>       _memory; // Content of the cache when it cannot be written
+    std::vector<CachedMesh> _meshes;
+    std::vector<Material>   _materials;
+  };
+}
+
+#endif // MESHCACHE_H
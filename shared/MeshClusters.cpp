@@ -0,0 +1,225 @@
+#include "MeshClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+using namespace OBJLoader;
+
+namespace
+{
+  const std::uint32_t NoCluster = std::numeric_limits<std::uint32_t>::max();
+
+  // Normal cones wider than this (dot between the axis and a normal) never cull anything useful
+  const float MinConeDot = 0.1f;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split the mesh in clusters of neighbor triangles
+void OBJLoader::buildClusters(Mesh& mesh, std::size_t maxVertices, std::size_t maxTriangles)
+{
+  mesh.clusters.clear();
+  if (!mesh.isIndexed())
+    return;
+  maxVertices = std::max<std::size_t>(maxVertices, 3);
+  maxTriangles = std::max<std::size_t>(maxTriangles, 1);
+
+  // Vertices sharing the same position get the same group, so flat shaded meshes
+  // and seams are crossed too
+  const std::vector<std::uint32_t>& indices = mesh.indices;
+  const std::size_t numTriangles = indices.size() / 3;
+  const std::size_t numVertices = mesh.vertices.size();
+  auto position = [&](std::uint32_t v) { return mesh.vertices[v].position; };
+  std::vector<std::uint32_t> order(numVertices);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+    return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+  });
+  std::vector<std::uint32_t> group(numVertices, 0);
+  std::uint32_t numGroups = 0;
+  for (std::size_t i = 0; i < numVertices; ++i)
+  {
+    if (i > 0 && std::memcmp(position(order[i]), position(order[i - 1]), 3 * sizeof(float)) != 0)
+      ++numGroups;
+    group[order[i]] = numGroups;
+  }
+  ++numGroups;
+
+  // Triangles of each position (group g is used by triangles[offsets[g]..offsets[g + 1]])
+  std::vector<std::size_t> offsets(numGroups + 1, 0);
+  for (std::uint32_t v : indices)
+    ++offsets[group[v] + 1];
+  for (std::size_t g = 0; g < numGroups; ++g)
+    offsets[g + 1] += offsets[g];
+  std::vector<std::uint32_t> triangles(indices.size());
+  {
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+      triangles[fill[group[indices[i]]]++] = std::uint32_t(i / 3);
+  }
+
+  // Grow each cluster from the first free triangle (in drawing order), adding the
+  // neighbor triangle sharing the most positions with the cluster, until a limit is reached
+  std::vector<std::uint32_t> clusterOf(numTriangles, NoCluster);
+  std::vector<std::uint32_t> vertexCluster(numVertices, NoCluster);
+  std::vector<std::uint32_t> groupCluster(numGroups, NoCluster);
+  std::vector<std::uint32_t> clusterVertices, clusterGroups, clusterTriangles;
+  std::vector<std::uint32_t> newIndices;
+  newIndices.reserve(indices.size());
+  std::size_t seed = 0;
+  while (true)
+  {
+    while (seed < numTriangles && clusterOf[seed] != NoCluster)
+      ++seed;
+    if (seed == numTriangles)
+      break;
+
+    const std::uint32_t cluster = std::uint32_t(mesh.clusters.size());
+    clusterVertices.clear();
+    clusterGroups.clear();
+    clusterTriangles.clear();
+    auto addTriangle = [&](std::uint32_t t) {
+      clusterOf[t] = cluster;
+      clusterTriangles.push_back(t);
+      for (int c = 0; c < 3; ++c)
+      {
+        const std::uint32_t v = indices[3 * std::size_t(t) + c];
+        if (vertexCluster[v] != cluster)
+        {
+          vertexCluster[v] = cluster;
+          clusterVertices.push_back(v);
+        }
+        if (groupCluster[group[v]] != cluster)
+        {
+          groupCluster[group[v]] = cluster;
+          clusterGroups.push_back(group[v]);
+        }
+      }
+    };
+    addTriangle(std::uint32_t(seed));
+
+    while (clusterTriangles.size() < maxTriangles)
+    {
+      std::uint32_t best = NoCluster;
+      int bestShared = 0;
+      for (std::uint32_t g : clusterGroups)
+      {
+        for (std::size_t k = offsets[g]; k < offsets[g + 1]; ++k)
+        {
+          const std::uint32_t t = triangles[k];
+          if (clusterOf[t] != NoCluster)
+            continue;
+          const std::uint32_t* triangle = &indices[3 * std::size_t(t)];
+          int shared = 0, newVertices = 0;
+          for (int c = 0; c < 3; ++c)
+          {
+            shared += (groupCluster[group[triangle[c]]] == cluster) ? 1 : 0;
+            newVertices += (vertexCluster[triangle[c]] != cluster) ? 1 : 0;
+          }
+          if (clusterVertices.size() + newVertices > maxVertices)
+            continue;
+          if (shared > bestShared || (shared == bestShared && t < best))
+          {
+            best = t;
+            bestShared = shared;
+          }
+        }
+      }
+      if (best == NoCluster)
+        break;
+      addTriangle(best);
+    }
+
+    // Keep the drawing order inside the cluster (vertex cache and overdraw optimizations)
+    std::sort(clusterTriangles.begin(), clusterTriangles.end());
+    const std::size_t first = newIndices.size();
+    for (std::uint32_t t : clusterTriangles)
+      newIndices.insert(newIndices.end(), indices.begin() + 3 * std::size_t(t), indices.begin() + 3 * std::size_t(t) + 3);
+    MeshCluster bounds;
+    bounds.firstIndex = std::uint32_t(first);
+    bounds.numIndices = std::uint32_t(newIndices.size() - first);
+    mesh.clusters.push_back(bounds);
+  }
+
+  mesh.indices.swap(newIndices);
+  for (MeshCluster& cluster : mesh.clusters)
+    cluster = computeClusterBounds(mesh, cluster.firstIndex, cluster.numIndices);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bounding sphere and normal cone of a range of triangles
+MeshCluster OBJLoader::computeClusterBounds(const Mesh& mesh, std::size_t first, std::size_t count)
+{
+  MeshCluster cluster = {};
+  cluster.firstIndex = std::uint32_t(first);
+  cluster.numIndices = std::uint32_t(count);
+  cluster.coneCutoff = 1.0f;
+  if (count == 0)
+    return cluster;
+
+  // Sphere around the box of the vertices
+  float boxMin[3], boxMax[3];
+  for (int k = 0; k < 3; ++k)
+  {
+    boxMin[k] = std::numeric_limits<float>::max();
+    boxMax[k] = -std::numeric_limits<float>::max();
+  }
+  for (std::size_t i = first; i < first + count; ++i)
+  {
+    const float* p = mesh.vertices[mesh.indices[i]].position;
+    for (int k = 0; k < 3; ++k)
+    {
+      boxMin[k] = std::min(boxMin[k], p[k]);
+      boxMax[k] = std::max(boxMax[k], p[k]);
+    }
+  }
+  for (int k = 0; k < 3; ++k)
+    cluster.center[k] = 0.5f * (boxMin[k] + boxMax[k]);
+  float radius2 = 0.0f;
+  for (std::size_t i = first; i < first + count; ++i)
+  {
+    const float* p = mesh.vertices[mesh.indices[i]].position;
+    const float d[3] = { p[0] - cluster.center[0], p[1] - cluster.center[1], p[2] - cluster.center[2] };
+    radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  }
+  cluster.radius = std::sqrt(radius2);
+
+  // Cone around the triangle normals, its axis is their area weighted mean
+  std::vector<float> normals;
+  normals.reserve(count);
+  double axis[3] = { 0.0, 0.0, 0.0 };
+  for (std::size_t i = first; i + 2 < first + count; i += 3)
+  {
+    const float* a = mesh.vertices[mesh.indices[i]].position;
+    const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+    const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f)
+      continue;
+    for (int k = 0; k < 3; ++k)
+    {
+      axis[k] += n[k];
+      normals.push_back(n[k] / length);
+    }
+  }
+  const double axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (axisLength == 0.0)
+    return cluster;
+  for (int k = 0; k < 3; ++k)
+    cluster.coneAxis[k] = float(axis[k] / axisLength);
+
+  float minDot = 1.0f;
+  for (std::size_t i = 0; i < normals.size(); i += 3)
+    minDot = std::min(minDot, normals[i] * cluster.coneAxis[0] + normals[i + 1] * cluster.coneAxis[1] + normals[i + 2] * cluster.coneAxis[2]);
+
+  // Sine of the cone half angle: the view direction must be at least this far from the
+  // plane perpendicular to the axis for all the triangles to face away
+  if (minDot > MinConeDot)
+    cluster.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  return cluster;
+}
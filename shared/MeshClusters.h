@@ -0,0 +1,23 @@
+#ifndef MESHCLUSTERS_H
+#define MESHCLUSTERS_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // Cluster size limits: small enough for the culling to be precise, large enough
+  // for each cluster to be worth a draw command
+  const std::size_t MaxClusterVertices = 64;
+  const std::size_t MaxClusterTriangles = 124;
+
+  // Split the triangles of an indexed mesh in clusters of neighbor triangles, with at most
+  // maxVertices vertices and maxTriangles triangles each, and fill mesh.clusters.
+  // The indices are reordered so each cluster is a contiguous range (one draw command),
+  // keeping the order of the triangles inside each cluster. The levels of detail are unchanged.
+  void buildClusters(Mesh& mesh, std::size_t maxVertices = MaxClusterVertices, std::size_t maxTriangles = MaxClusterTriangles);
+
+  // Bounding sphere and normal cone of the triangles indices[first, first + count)
+  MeshCluster computeClusterBounds(const Mesh& mesh, std::size_t first, std::size_t count);
+}
+
+#endif // MESHCLUSTERS_H
@@ -0,0 +1,529 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+using namespace OBJLoader;
+
+namespace
+{
+  const std::uint32_t NoVertex = std::numeric_limits<std::uint32_t>::max();
+
+  // Simulated FIFO vertex cache (see analyzeVertexCache)
+  struct VertexCache
+  {
+    VertexCache(std::size_t numVertices, std::size_t size)
+      : cacheTime(numVertices, 0), time(size + 1), size(size) {}
+
+    // Number of vertices of the triangle missing the cache
+    int addTriangle(const std::uint32_t* triangle)
+    {
+      int misses = 0;
+      for (int c = 0; c < 3; ++c)
+      {
+        if (time - cacheTime[triangle[c]] > size)
+        {
+          cacheTime[triangle[c]] = time++;
+          ++misses;
+        }
+      }
+      return misses;
+    }
+
+    // Every vertex leaves the cache
+    void flush() { time += size + 1; }
+
+    std::vector<std::size_t> cacheTime;
+    std::size_t time;
+    std::size_t size;
+  };
+
+  // Group of consecutive triangles moved as a whole by optimizeOverdraw
+  struct Cluster
+  {
+    std::size_t first;
+    std::size_t count;
+    float       potential; // Occlusion potential
+  };
+
+  // Triangle area-weighted centroid and normal accumulator
+  struct Accumulator
+  {
+    double centroid[3] = { 0.0, 0.0, 0.0 };
+    double normal[3] = { 0.0, 0.0, 0.0 };
+    double area = 0.0;
+
+    void addTriangle(const float* a, const float* b, const float* c)
+    {
+      const double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      const double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+      const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+      const double triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (int i = 0; i < 3; ++i)
+      {
+        centroid[i] += triangleArea * (a[i] + b[i] + c[i]) / 3.0;
+        normal[i] += n[i];
+      }
+      area += triangleArea;
+    }
+
+    void getCentroid(double result[3]) const
+    {
+      for (int i = 0; i < 3; ++i)
+        result[i] = (area > 0.0) ? centroid[i] / area : 0.0;
+    }
+  };
+
+  // Number of vertices missing the cache when drawing the triangles
+  std::size_t countMisses(const std::vector<std::uint32_t>& indices, std::size_t numVertices, std::size_t cacheSize)
+  {
+    VertexCache cache(numVertices, cacheSize);
+    std::size_t misses = 0;
+    for (std::size_t t = 0; t + 2 < indices.size(); t += 3)
+      misses += cache.addTriangle(indices.data() + t);
+    return misses;
+  }
+
+  // Indices of the mesh with its clusters sorted by decreasing occlusion potential: distance
+  // of the cluster to the mesh center along the cluster normal (outer clusters occlude the others)
+  std::vector<std::uint32_t> sortClusters(const std::vector<Vertex>& vertices, const std::vector<std::uint32_t>& indexBuffer, std::vector<Cluster>& clusters)
+  {
+    const std::uint32_t* indices = indexBuffer.data();
+    std::vector<Accumulator> accumulators(clusters.size());
+    Accumulator meshAccumulator;
+    for (std::size_t i = 0; i < clusters.size(); ++i)
+    {
+      for (std::size_t t = clusters[i].first; t < clusters[i].first + clusters[i].count; ++t)
+      {
+        const float* a = vertices[indices[3 * t + 0]].position;
+        const float* b = vertices[indices[3 * t + 1]].position;
+        const float* c = vertices[indices[3 * t + 2]].position;
+        accumulators[i].addTriangle(a, b, c);
+        meshAccumulator.addTriangle(a, b, c);
+      }
+    }
+    double meshCentroid[3];
+    meshAccumulator.getCentroid(meshCentroid);
+    for (std::size_t i = 0; i < clusters.size(); ++i)
+    {
+      double centroid[3];
+      accumulators[i].getCentroid(centroid);
+      const double* n = accumulators[i].normal;
+      const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      double potential = 0.0;
+      for (int k = 0; k < 3; ++k)
+        potential += (centroid[k] - meshCentroid[k]) * n[k];
+      clusters[i].potential = (length > 0.0) ? float(potential / length) : 0.0f;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+      return a.potential > b.potential;
+    });
+
+    std::vector<std::uint32_t> output;
+    output.reserve(indexBuffer.size());
+    for (const Cluster& cluster : clusters)
+      output.insert(output.end(), indices + 3 * cluster.first, indices + 3 * (cluster.first + cluster.count));
+    return output;
+  }
+
+  // Rasterize a triangle in a depth buffer (pixel centers, top-left fill rule),
+  // return the number of fragments passing the depth test
+  std::size_t rasterize(const double p[3][3], std::vector<float>& depth, int resolution)
+  {
+    // Counter-clockwise
+    double a[3], b[3], c[3];
+    std::copy(p[0], p[0] + 3, a);
+    std::copy(p[1], p[1] + 3, b);
+    std::copy(p[2], p[2] + 3, c);
+    double area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    if (area == 0.0)
+      return 0;
+    if (area < 0.0)
+    {
+      std::swap(b, c);
+      area = -area;
+    }
+
+    const int minX = std::max(0, int(std::floor(std::min({ a[0], b[0], c[0] }))));
+    const int maxX = std::min(resolution - 1, int(std::ceil(std::max({ a[0], b[0], c[0] }))));
+    const int minY = std::max(0, int(std::floor(std::min({ a[1], b[1], c[1] }))));
+    const int maxY = std::min(resolution - 1, int(std::ceil(std::max({ a[1], b[1], c[1] }))));
+
+    // Edge function of the edge (u, v): positive on the inside
+    const double* edges[3][2] = { { b, c }, { c, a }, { a, b } };
+    auto edge = [](const double* u, const double* v, double x, double y) {
+      return (v[0] - u[0]) * (y - u[1]) - (v[1] - u[1]) * (x - u[0]);
+    };
+    auto isTopLeft = [](const double* u, const double* v) {
+      return (u[1] == v[1] && v[0] < u[0]) || v[1] < u[1];
+    };
+
+    std::size_t shaded = 0;
+    for (int y = minY; y <= maxY; ++y)
+    {
+      for (int x = minX; x <= maxX; ++x)
+      {
+        const double px = x + 0.5, py = y + 0.5;
+        double w[3];
+        bool inside = true;
+        for (int e = 0; e < 3 && inside; ++e)
+        {
+          w[e] = edge(edges[e][0], edges[e][1], px, py);
+          inside = w[e] > 0.0 || (w[e] == 0.0 && isTopLeft(edges[e][0], edges[e][1]));
+        }
+        if (!inside)
+          continue;
+
+        const float z = float((w[0] * a[2] + w[1] * b[2] + w[2] * c[2]) / area);
+        float& d = depth[std::size_t(y) * resolution + x];
+        if (z < d)
+        {
+          d = z;
+          ++shaded;
+        }
+      }
+    }
+    return shaded;
+  }
+
+  // Tipsify: emit the triangles around a "fanning" vertex, then continue with the adjacent
+  // vertex that will still be in the cache once its remaining triangles are emitted
+  void tipsify(std::vector<std::uint32_t>& indexBuffer, std::size_t numVertices, std::size_t cacheSize)
+  {
+    const std::size_t numTriangles = indexBuffer.size() / 3;
+    const std::uint32_t* indices = indexBuffer.data();
+    if (numTriangles == 0)
+      return;
+
+    // Triangles of each vertex (vertex v uses adjacency[offsets[v]..offsets[v + 1]])
+    std::vector<std::uint32_t> liveTriangles(numVertices, 0); // Triangles not emitted yet
+    for (std::size_t i = 0; i < numTriangles * 3; ++i)
+      ++liveTriangles[indices[i]];
+    std::vector<std::size_t> offsets(numVertices + 1, 0);
+    for (std::size_t v = 0; v < numVertices; ++v)
+      offsets[v + 1] = offsets[v] + liveTriangles[v];
+    std::vector<std::uint32_t> adjacency(numTriangles * 3);
+    {
+      std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+      for (std::size_t i = 0; i < numTriangles * 3; ++i)
+        adjacency[fill[indices[i]]++] = std::uint32_t(i / 3);
+    }
+
+    std::vector<std::size_t> cacheTime(numVertices, 0);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<std::uint32_t> deadEnd;    // Recently used vertices, to restart after a dead end
+    std::vector<std::uint32_t> candidates; // Vertices of the triangles emitted by the last fan
+    std::vector<std::uint32_t> output;
+    deadEnd.reserve(numTriangles * 3);
+    output.reserve(numTriangles * 3);
+    std::size_t time = cacheSize + 1;
+    std::size_t cursor = 0; // Vertices before it have no live triangle
+
+    std::uint32_t fanning = 0;
+    while (fanning != NoVertex)
+    {
+      // Emit the live triangles of the fanning vertex
+      candidates.clear();
+      for (std::size_t k = offsets[fanning]; k < offsets[fanning + 1]; ++k)
+      {
+        const std::uint32_t t = adjacency[k];
+        if (emitted[t])
+          continue;
+        emitted[t] = true;
+
+        for (int c = 0; c < 3; ++c)
+        {
+          const std::uint32_t v = indices[3 * t + c];
+          output.push_back(v);
+          deadEnd.push_back(v);
+          candidates.push_back(v);
+          --liveTriangles[v];
+          if (time - cacheTime[v] > cacheSize)
+            cacheTime[v] = time++;
+        }
+      }
+
+      // Next fanning vertex: the oldest candidate that stays in the cache while its
+      // remaining triangles are emitted (each one can add at most 2 vertices)
+      fanning = NoVertex;
+      std::size_t bestPriority = 0;
+      for (std::uint32_t v : candidates)
+      {
+        if (liveTriangles[v] == 0)
+          continue;
+        std::size_t priority = 0;
+        if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+          priority = time - cacheTime[v];
+        if (fanning == NoVertex || priority > bestPriority)
+        {
+          fanning = v;
+          bestPriority = priority;
+        }
+      }
+
+      // Dead end: go back to a recently used vertex, or else to the next vertex in the input order
+      while (fanning == NoVertex && !deadEnd.empty())
+      {
+        const std::uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0)
+          fanning = v;
+      }
+      if (fanning == NoVertex)
+      {
+        while (cursor < numVertices && liveTriangles[cursor] == 0)
+          ++cursor;
+        if (cursor < numVertices)
+          fanning = std::uint32_t(cursor);
+      }
+    }
+
+    indexBuffer.swap(output);
+  }
+
+  // Split the triangles in clusters and draw first the clusters facing away from the mesh center
+  void sortOverdraw(const std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indexBuffer, float threshold, std::size_t cacheSize)
+  {
+    const std::size_t numTriangles = indexBuffer.size() / 3;
+    const std::uint32_t* indices = indexBuffer.data();
+    if (numTriangles == 0)
+      return;
+
+    // Hard boundaries: triangles missing the cache for their 3 vertices (new fan after a dead end)
+    std::vector<Cluster> hardClusters;
+    std::size_t inputMisses = 0;
+    {
+      VertexCache cache(vertices.size(), cacheSize);
+      for (std::size_t t = 0; t < numTriangles; ++t)
+      {
+        const int misses = cache.addTriangle(indices + 3 * t);
+        if (misses == 3 || t == 0)
+          hardClusters.push_back({ t, 0, 0.0f });
+        ++hardClusters.back().count;
+        inputMisses += misses;
+      }
+    }
+
+    // Soft boundaries: split each cluster as soon as the part already scanned, drawn alone
+    // (with an empty cache), has an ACMR within threshold of the ACMR of the mesh
+    const double maxMisses = threshold * double(inputMisses) / double(numTriangles);
+    std::vector<Cluster> softClusters;
+    VertexCache cache(vertices.size(), cacheSize);
+    for (const Cluster& hard : hardClusters)
+    {
+      const std::size_t end = hard.first + hard.count;
+      std::size_t first = hard.first;
+      std::size_t misses = 0;
+      cache.flush();
+      for (std::size_t t = first; t < end; ++t)
+      {
+        misses += cache.addTriangle(indices + 3 * t);
+        if (t + 1 == end || double(misses) <= maxMisses * double(t + 1 - first))
+        {
+          softClusters.push_back({ first, t + 1 - first, 0.0f });
+          first = t + 1;
+          misses = 0;
+          cache.flush();
+        }
+      }
+    }
+
+    // The last triangles of the soft clusters can miss the cache more than allowed: if the
+    // new order exceeds the threshold, sort the hard clusters only, or else keep the input order
+    for (std::vector<Cluster>* clusters : { &softClusters, &hardClusters })
+    {
+      std::vector<std::uint32_t> output = sortClusters(vertices, indexBuffer, *clusters);
+      if (double(countMisses(output, vertices.size(), cacheSize)) <= threshold * double(inputMisses))
+      {
+        indexBuffer.swap(output);
+        return;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Simulate a FIFO vertex cache while drawing the mesh
+VertexCacheStats OBJLoader::analyzeVertexCache(const Mesh& mesh, std::size_t cacheSize)
+{
+  VertexCacheStats stats = {};
+  stats.numTriangles = mesh.numElements() / 3;
+  if (stats.numTriangles == 0)
+    return stats;
+
+  if (!mesh.isIndexed())
+  {
+    // Triangle soup: every vertex is transformed
+    stats.numTransforms = stats.numTriangles * 3;
+    stats.acmr = 3.0f;
+    stats.atvr = 1.0f;
+    return stats;
+  }
+
+  // A vertex is in the cache while less than cacheSize vertices entered it after it
+  // (cacheTime: time at which the vertex entered the cache, 0: never)
+  std::vector<std::size_t> cacheTime(mesh.vertices.size(), 0);
+  std::size_t time = cacheSize + 1;
+  std::size_t numUsed = 0;
+  for (std::size_t i = 0; i < stats.numTriangles * 3; ++i)
+  {
+    const std::uint32_t v = mesh.indices[i];
+    if (time - cacheTime[v] > cacheSize)
+    {
+      if (cacheTime[v] == 0)
+        ++numUsed;
+      cacheTime[v] = time++;
+      ++stats.numTransforms;
+    }
+  }
+
+  stats.acmr = float(stats.numTransforms) / float(stats.numTriangles);
+  stats.atvr = float(stats.numTransforms) / float(numUsed);
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reorder the triangles of the mesh and of its levels of detail for the vertex cache
+void OBJLoader::optimizeVertexCache(Mesh& mesh, std::size_t cacheSize)
+{
+  if (!mesh.isIndexed())
+    return;
+
+  tipsify(mesh.indices, mesh.vertices.size(), cacheSize);
+  for (MeshLod& lod : mesh.lods)
+    tipsify(lod.indices, mesh.vertices.size(), cacheSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reorder the triangles of the mesh and of its levels of detail to reduce the overdraw
+void OBJLoader::optimizeOverdraw(Mesh& mesh, float threshold, std::size_t cacheSize)
+{
+  if (!mesh.isIndexed())
+    return;
+
+  sortOverdraw(mesh.vertices, mesh.indices, threshold, cacheSize);
+  for (MeshLod& lod : mesh.lods)
+    sortOverdraw(mesh.vertices, lod.indices, threshold, cacheSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Count the fragments shaded from views around the mesh
+OverdrawStats OBJLoader::analyzeOverdraw(const Mesh& mesh, std::size_t resolution)
+{
+  OverdrawStats stats = {};
+  const std::size_t numElements = mesh.numElements();
+  if (numElements < 3 || resolution == 0)
+    return stats;
+
+  auto vertexAt = [&](std::size_t i) -> const Vertex& {
+    return mesh.isIndexed() ? mesh.vertices[mesh.indices[i]] : mesh.vertices[i];
+  };
+
+  // Bounding sphere (from the bounding box)
+  const Bounds bounds = computeBounds(mesh.vertices.data(), mesh.vertices.size());
+  double center[3], radius = 0.0;
+  for (int k = 0; k < 3; ++k)
+  {
+    center[k] = 0.5 * (double(bounds.min[k]) + bounds.max[k]);
+    radius += 0.25 * (double(bounds.max[k]) - bounds.min[k]) * (double(bounds.max[k]) - bounds.min[k]);
+  }
+  radius = std::sqrt(radius);
+  if (radius == 0.0)
+    return stats;
+
+  // View directions: the axes and the diagonals
+  std::vector<std::array<double, 3>> directions;
+  for (int k = 0; k < 3; ++k)
+  {
+    for (double sign : { -1.0, 1.0 })
+    {
+      std::array<double, 3> d = { 0.0, 0.0, 0.0 };
+      d[k] = sign;
+      directions.push_back(d);
+    }
+  }
+  for (int i = 0; i < 8; ++i)
+  {
+    const double s = 1.0 / std::sqrt(3.0);
+    directions.push_back({ (i & 1) ? s : -s, (i & 2) ? s : -s, (i & 4) ? s : -s });
+  }
+
+  const int size = int(resolution);
+  const double scale = 0.5 * double(size) / radius;
+  std::vector<float> depth(resolution * resolution);
+  for (const std::array<double, 3>& d : directions)
+  {
+    // Orthonormal basis of the view
+    const std::array<double, 3> helper = (std::abs(d[1]) < 0.9) ? std::array<double, 3>{ 0.0, 1.0, 0.0 } : std::array<double, 3>{ 1.0, 0.0, 0.0 };
+    double right[3] = { helper[1] * d[2] - helper[2] * d[1], helper[2] * d[0] - helper[0] * d[2], helper[0] * d[1] - helper[1] * d[0] };
+    const double length = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+    for (double& r : right)
+      r /= length;
+    const double up[3] = { d[1] * right[2] - d[2] * right[1], d[2] * right[0] - d[0] * right[2], d[0] * right[1] - d[1] * right[0] };
+
+    std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+    for (std::size_t t = 0; t + 2 < numElements; t += 3)
+    {
+      double p[3][3];
+      for (int c = 0; c < 3; ++c)
+      {
+        const float* position = vertexAt(t + c).position;
+        const double q[3] = { position[0] - center[0], position[1] - center[1], position[2] - center[2] };
+        p[c][0] = (q[0] * right[0] + q[1] * right[1] + q[2] * right[2]) * scale + 0.5 * size;
+        p[c][1] = (q[0] * up[0] + q[1] * up[1] + q[2] * up[2]) * scale + 0.5 * size;
+        p[c][2] = q[0] * d[0] + q[1] * d[1] + q[2] * d[2];
+      }
+      stats.numShaded += rasterize(p, depth, size);
+    }
+    for (float z : depth)
+      stats.numCovered += (z != std::numeric_limits<float>::max()) ? 1 : 0;
+  }
+
+  stats.overdraw = (stats.numCovered != 0) ? float(stats.numShaded) / float(stats.numCovered) : 0.0f;
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Number the vertices in the order of their first use
+void OBJLoader::optimizeVertexFetch(Mesh& mesh)
+{
+  if (!mesh.isIndexed())
+    return;
+
+  std::vector<std::uint32_t> remap(mesh.vertices.size(), NoVertex);
+  std::vector<Vertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+  auto remapIndices = [&](std::vector<std::uint32_t>& indices) {
+    for (std::uint32_t& index : indices)
+    {
+      if (remap[index] == NoVertex)
+      {
+        remap[index] = std::uint32_t(vertices.size());
+        vertices.push_back(mesh.vertices[index]);
+      }
+      index = remap[index];
+    }
+  };
+  // The levels of detail only use vertices of the mesh (see generateLods)
+  remapIndices(mesh.indices);
+  for (MeshLod& lod : mesh.lods)
+    remapIndices(lod.indices);
+  mesh.vertices.swap(vertices);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Optimize for the vertex cache, the overdraw then for the vertex fetches
+MeshOptimizationStats OBJLoader::optimizeMesh(Mesh& mesh, float overdrawThreshold, std::size_t cacheSize)
+{
+  MeshOptimizationStats stats;
+  stats.before = analyzeVertexCache(mesh, cacheSize);
+  optimizeVertexCache(mesh, cacheSize);
+  if (overdrawThreshold > 0.0f)
+    optimizeOverdraw(mesh, overdrawThreshold, cacheSize);
+  optimizeVertexFetch(mesh);
+  stats.after = analyzeVertexCache(mesh, cacheSize);
+  return stats;
+}
@@ -0,0 +1,66 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // Post-transform vertex cache size assumed by the optimizer. Recent GPUs do not
+  // have a true FIFO cache, but orders optimized for 16 entries behave well on all of them.
+  const std::size_t DefaultVertexCacheSize = 16;
+  // Vertex cache degradation accepted by optimizeOverdraw (1.05: up to 5% more vertex transforms)
+  const float DefaultOverdrawThreshold = 1.05f;
+
+  // Efficiency of a triangle order, measured with a simulated FIFO vertex cache
+  struct VertexCacheStats
+  {
+    std::size_t numTriangles;
+    std::size_t numTransforms; // Cache misses: vertices sent to the vertex shader
+    float       acmr;          // Average cache miss ratio: transforms per triangle (0.5 at best, 3 at worst)
+    float       atvr;          // Average transformed vertex ratio: transforms per used vertex (1 at best)
+  };
+
+  // Fragments shaded when drawing a mesh from a fixed set of viewpoints (see analyzeOverdraw)
+  struct OverdrawStats
+  {
+    std::size_t numShaded;  // Fragments passing the depth test when they are drawn
+    std::size_t numCovered; // Pixels covered by the mesh
+    float       overdraw;   // numShaded / numCovered (1 at best)
+  };
+
+  // ACMR/ATVR of a mesh before and after optimizeMesh
+  struct MeshOptimizationStats
+  {
+    VertexCacheStats before;
+    VertexCacheStats after;
+  };
+
+  // Simulate the vertex cache while drawing the mesh (a triangle soup always gives an ACMR of 3)
+  VertexCacheStats analyzeVertexCache(const Mesh& mesh, std::size_t cacheSize = DefaultVertexCacheSize);
+
+  // Reorder the triangles of an indexed mesh (and of its levels of detail) for the post-transform
+  // vertex cache (Tipsify, Sander et al. 2007). Linear in the number of triangles.
+  void optimizeVertexCache(Mesh& mesh, std::size_t cacheSize = DefaultVertexCacheSize);
+
+  // Reorder the triangles of an indexed mesh (and of its levels of detail), already optimized
+  // for the vertex cache, to draw the triangles likely to occlude the others first (Sander et
+  // al. 2007). The triangles are split in clusters, without increasing the ACMR of each cluster
+  // by more than threshold, and the clusters are sorted by occlusion potential (facing away
+  // from the mesh center first).
+  void optimizeOverdraw(Mesh& mesh, float threshold = DefaultOverdrawThreshold, std::size_t cacheSize = DefaultVertexCacheSize);
+
+  // Rasterize the mesh in software, in its drawing order and with a depth test, from 14 views
+  // around it (axes and diagonals, orthographic, resolution x resolution pixels each)
+  OverdrawStats analyzeOverdraw(const Mesh& mesh, std::size_t resolution = 256);
+
+  // Reorder the vertices of an indexed mesh in the order of their first use by the
+  // triangles, so the vertex fetches walk the vertex buffer forward. Unused vertices are removed.
+  // The indices of the levels of detail are updated.
+  void optimizeVertexFetch(Mesh& mesh);
+
+  // optimizeVertexCache, optimizeOverdraw (skipped if overdrawThreshold is 0, e.g. for
+  // transparent meshes) then optimizeVertexFetch. The rendered mesh is unchanged.
+  MeshOptimizationStats optimizeMesh(Mesh& mesh, float overdrawThreshold = DefaultOverdrawThreshold, std::size_t cacheSize = DefaultVertexCacheSize);
+}
+
+#endif // MESHOPTIMIZER_H
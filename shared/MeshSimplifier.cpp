@@ -0,0 +1,557 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+using namespace OBJLoader;
+
+namespace
+{
+  const std::uint32_t NoVertex = std::numeric_limits<std::uint32_t>::max();
+
+  // Quadric error: weighted sum of the squared distances to a set of planes
+  struct Quadric
+  {
+    double a[10] = {}; // Upper part of the symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+    double weight = 0.0;
+
+    // Plane n.p + d = 0 (n normalized)
+    void addPlane(const double n[3], double d, double w)
+    {
+      a[0] += w * n[0] * n[0]; a[1] += w * n[0] * n[1]; a[2] += w * n[0] * n[2]; a[3] += w * n[0] * d;
+      a[4] += w * n[1] * n[1]; a[5] += w * n[1] * n[2]; a[6] += w * n[1] * d;
+      a[7] += w * n[2] * n[2]; a[8] += w * n[2] * d;
+      a[9] += w * d * d;
+      weight += w;
+    }
+
+    void add(const Quadric& q)
+    {
+      for (int i = 0; i < 10; ++i)
+        a[i] += q.a[i];
+      weight += q.weight;
+    }
+
+    // Weighted mean of the squared distances of p to the planes
+    double evaluate(const float* p) const
+    {
+      const double x = p[0], y = p[1], z = p[2];
+      const double sum = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+                       + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+                       + a[7] * z * z + 2.0 * a[8] * z
+                       + a[9];
+      return (weight > 0.0) ? std::max(0.0, sum) / weight : 0.0;
+    }
+  };
+
+  // Vertices sharing a position whose normals differ more than this (cosine) are never
+  // moved on each other: sharper creases are kept
+  const float MinWedgeNormalDot = 0.5f;
+
+  // Move of vertex "from" on vertex "to"
+  struct Collapse
+  {
+    std::uint32_t from;
+    std::uint32_t to;
+    float         error;
+  };
+
+  void cross(const float* a, const float* b, const float* c, double n[3])
+  {
+    const double e1[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+    const double e2[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+  }
+
+  double length(const double v[3])
+  {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  }
+
+  // Edge collapse simplification of one mesh (see simplifyMesh)
+  class Simplifier
+  {
+  public:
+    // Start from the triangles of source (the mesh itself or one of its levels of detail),
+    // the error is always measured against the surface of the mesh
+    Simplifier(const Mesh& mesh, const std::vector<std::uint32_t>& source, std::vector<std::uint32_t>& indices)
+      : _vertices(mesh.vertices), _indices(indices)
+    {
+      _indices = source;
+      groupPositions();
+      buildAdjacency();
+      classify();
+      buildQuadrics(mesh.indices);
+    }
+
+    float run(std::size_t targetTriangles)
+    {
+      float error = 0.0f;
+      while (_indices.size() / 3 > targetTriangles)
+      {
+        if (!collapseEdges(targetTriangles, error))
+          break;
+        buildAdjacency();
+        classify();
+      }
+      return error;
+    }
+
+  private:
+    const float* position(std::uint32_t v) const { return _vertices[v].position; }
+
+    // Vertices sharing the same position get the same group
+    void groupPositions()
+    {
+      std::vector<std::uint32_t> order(_vertices.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+      });
+
+      _group.assign(_vertices.size(), 0);
+      std::uint32_t group = 0;
+      for (std::size_t i = 0; i < order.size(); ++i)
+      {
+        if (i > 0 && std::memcmp(position(order[i]), position(order[i - 1]), 3 * sizeof(float)) != 0)
+          ++group;
+        _group[order[i]] = group;
+      }
+      _numGroups = order.empty() ? 0 : group + 1;
+    }
+
+    // Triangles of each vertex (vertex v is used by _triangles[_offsets[v].._offsets[v + 1]])
+    void buildAdjacency()
+    {
+      _offsets.assign(_vertices.size() + 1, 0);
+      for (std::uint32_t v : _indices)
+        ++_offsets[v + 1];
+      for (std::size_t v = 0; v < _vertices.size(); ++v)
+        _offsets[v + 1] += _offsets[v];
+      _triangles.resize(_indices.size());
+      std::vector<std::size_t> fill(_offsets.begin(), _offsets.end() - 1);
+      for (std::size_t i = 0; i < _indices.size(); ++i)
+        _triangles[fill[_indices[i]]++] = std::uint32_t(i / 3);
+    }
+
+    // Is there a triangle with the directed edge a->b?
+    bool hasEdge(std::uint32_t a, std::uint32_t b) const
+    {
+      for (std::size_t k = _offsets[a]; k < _offsets[a + 1]; ++k)
+      {
+        const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+        for (int c = 0; c < 3; ++c)
+        {
+          if (t[c] == a && t[(c + 1) % 3] == b)
+            return true;
+        }
+      }
+      return false;
+    }
+
+    // Is there a triangle with an edge from position ga to position gb?
+    bool hasPositionEdge(std::uint32_t ga, std::uint32_t gb) const
+    {
+      for (std::size_t w = _wedgeOffsets[ga]; w < _wedgeOffsets[ga + 1]; ++w)
+      {
+        const std::uint32_t a = _wedges[w];
+        for (std::size_t k = _offsets[a]; k < _offsets[a + 1]; ++k)
+        {
+          const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+          for (int c = 0; c < 3; ++c)
+          {
+            if (t[c] == a && _group[t[(c + 1) % 3]] == gb)
+              return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    // Used vertices of each position (the wedges), and the positions that can move: the ones
+    // inside the surface, whose edges all have an opposite triangle (borders never move)
+    void classify()
+    {
+      const std::size_t numVertices = _vertices.size();
+      _wedgeOffsets.assign(_numGroups + 1, 0);
+      for (std::uint32_t v = 0; v < numVertices; ++v)
+      {
+        if (_offsets[v] != _offsets[v + 1])
+          ++_wedgeOffsets[_group[v] + 1];
+      }
+      for (std::size_t g = 0; g < _numGroups; ++g)
+        _wedgeOffsets[g + 1] += _wedgeOffsets[g];
+      _wedges.resize(_wedgeOffsets[_numGroups]);
+      std::vector<std::size_t> fill(_wedgeOffsets.begin(), _wedgeOffsets.end() - 1);
+      for (std::uint32_t v = 0; v < numVertices; ++v)
+      {
+        if (_offsets[v] != _offsets[v + 1])
+          _wedges[fill[_group[v]]++] = v;
+      }
+
+      _movable.assign(_numGroups, false);
+      for (std::uint32_t g = 0; g < _numGroups; ++g)
+      {
+        bool closed = _wedgeOffsets[g] != _wedgeOffsets[g + 1];
+        for (std::size_t w = _wedgeOffsets[g]; closed && w < _wedgeOffsets[g + 1]; ++w)
+        {
+          const std::uint32_t v = _wedges[w];
+          for (std::size_t k = _offsets[v]; closed && k < _offsets[v + 1]; ++k)
+          {
+            const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+            for (int c = 0; c < 3; ++c)
+            {
+              if (t[c] != v)
+                continue;
+              closed = closed && hasPositionEdge(_group[t[(c + 1) % 3]], g) && hasPositionEdge(g, _group[t[(c + 2) % 3]]);
+            }
+          }
+        }
+        _movable[g] = closed;
+      }
+    }
+
+    bool sameUv(std::uint32_t a, std::uint32_t b) const
+    {
+      return _vertices[a].uv[0] == _vertices[b].uv[0] && _vertices[a].uv[1] == _vertices[b].uv[1];
+    }
+
+    float normalDot(std::uint32_t a, std::uint32_t b) const
+    {
+      const float* na = _vertices[a].normal;
+      const float* nb = _vertices[b].normal;
+      return na[0] * nb[0] + na[1] * nb[1] + na[2] * nb[2];
+    }
+
+    // Is the edge a->b on a UV seam: its opposite triangle has other UVs at the same positions?
+    bool uvSeam(std::uint32_t a, std::uint32_t b) const
+    {
+      const std::uint32_t ga = _group[a], gb = _group[b];
+      for (std::size_t w = _wedgeOffsets[gb]; w < _wedgeOffsets[gb + 1]; ++w)
+      {
+        const std::uint32_t v = _wedges[w];
+        for (std::size_t k = _offsets[v]; k < _offsets[v + 1]; ++k)
+        {
+          const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+          for (int c = 0; c < 3; ++c)
+          {
+            if (t[c] == v && _group[t[(c + 1) % 3]] == ga)
+              return !sameUv(v, b) || !sameUv(t[(c + 1) % 3], a);
+          }
+        }
+      }
+      return false;
+    }
+
+    // Moves of the wedges of position "from" on the wedges of position "to", all together.
+    // A wedge sharing a triangle with "to" follows that triangle. The others take the wedge of
+    // "to" with the UV where their UV goes (the UV seams are only collapsed along the seam)
+    // and the closest normal (creases sharper than MinWedgeNormalDot are kept).
+    // Return false if a wedge cannot move.
+    bool planMoves(std::uint32_t from, std::uint32_t to, std::vector<Collapse>& moves) const
+    {
+      moves.clear();
+      for (std::size_t w = _wedgeOffsets[from]; w < _wedgeOffsets[from + 1]; ++w)
+      {
+        const std::uint32_t v = _wedges[w];
+        std::uint32_t target = NoVertex;
+        for (std::size_t k = _offsets[v]; target == NoVertex && k < _offsets[v + 1]; ++k)
+        {
+          const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+          for (int c = 0; c < 3; ++c)
+          {
+            if (_group[t[c]] == to)
+              target = t[c];
+          }
+        }
+        moves.push_back({ v, target, 0.0f });
+      }
+
+      // The wedges with the same UV go to the same UV
+      for (const Collapse& a : moves)
+      {
+        for (const Collapse& b : moves)
+        {
+          if (a.to != NoVertex && b.to != NoVertex && sameUv(a.from, b.from) && !sameUv(a.to, b.to))
+            return false;
+        }
+      }
+      for (Collapse& move : moves)
+      {
+        if (move.to != NoVertex)
+          continue;
+        std::uint32_t uvTarget = NoVertex;
+        for (const Collapse& other : moves)
+        {
+          if (other.to != NoVertex && sameUv(other.from, move.from))
+            uvTarget = other.to;
+        }
+        if (uvTarget == NoVertex)
+          return false;
+
+        float bestDot = MinWedgeNormalDot;
+        for (std::size_t w = _wedgeOffsets[to]; w < _wedgeOffsets[to + 1]; ++w)
+        {
+          const std::uint32_t candidate = _wedges[w];
+          const float dot = normalDot(candidate, move.from);
+          if (sameUv(candidate, uvTarget) && dot >= bestDot)
+          {
+            move.to = candidate;
+            bestDot = dot;
+          }
+        }
+        if (move.to == NoVertex)
+          return false;
+      }
+      return true;
+    }
+
+    // Planes of the triangles of the mesh, and planes along the seams to keep their shape
+    void buildQuadrics(const std::vector<std::uint32_t>& meshIndices)
+    {
+      _quadrics.assign(_numGroups, Quadric());
+      for (std::size_t i = 0; i + 2 < meshIndices.size(); i += 3)
+      {
+        double n[3], d;
+        if (!plane(meshIndices[i], meshIndices[i + 1], meshIndices[i + 2], n, d))
+          continue;
+        const double area = 0.5 * length(n);
+        for (int c = 0; c < 3; ++c)
+          _quadrics[_group[meshIndices[i + c]]].addPlane(n, d, area);
+      }
+
+      for (std::size_t i = 0; i < _indices.size(); i += 3)
+      {
+        for (int c = 0; c < 3; ++c)
+        {
+          const std::uint32_t a = _indices[i + c], b = _indices[i + (c + 1) % 3];
+          double n[3], d;
+          if (!uvSeam(a, b) || !plane(_indices[i], _indices[i + 1], _indices[i + 2], n, d))
+            continue;
+
+          // Plane containing the seam edge, perpendicular to the triangle
+          const float* pa = position(a);
+          const float* pb = position(b);
+          const double e[3] = { double(pb[0]) - pa[0], double(pb[1]) - pa[1], double(pb[2]) - pa[2] };
+          double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+          const double edgeLength = length(m);
+          if (edgeLength == 0.0)
+            continue;
+          for (double& x : m)
+            x /= edgeLength;
+          const double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+          _quadrics[_group[a]].addPlane(m, md, edgeLength * edgeLength);
+          _quadrics[_group[b]].addPlane(m, md, edgeLength * edgeLength);
+        }
+      }
+    }
+
+    // Plane of a triangle: normalized normal n and offset d (false if degenerated).
+    // The length of n is set to twice the area of the triangle.
+    bool plane(std::uint32_t a, std::uint32_t b, std::uint32_t c, double n[3], double& d) const
+    {
+      cross(position(a), position(b), position(c), n);
+      const double l = length(n);
+      if (l == 0.0)
+        return false;
+      d = -(n[0] * position(a)[0] + n[1] * position(a)[1] + n[2] * position(a)[2]) / l;
+      for (int k = 0; k < 3; ++k)
+        n[k] /= l;
+      return true;
+    }
+
+    // Would moving "from" on "to" flip or collapse one of the remaining triangles of "from"?
+    bool flips(std::uint32_t from, std::uint32_t to) const
+    {
+      for (std::size_t k = _offsets[from]; k < _offsets[from + 1]; ++k)
+      {
+        const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+        if (t[0] == to || t[1] == to || t[2] == to)
+          continue; // Removed by the collapse
+
+        const float* before[3];
+        const float* after[3];
+        for (int c = 0; c < 3; ++c)
+        {
+          if (t[c] != from && _group[t[c]] == _group[to])
+            return true; // Would touch another vertex at the same position
+          before[c] = position(t[c]);
+          after[c] = (t[c] == from) ? position(to) : position(t[c]);
+        }
+        double n0[3], n1[3];
+        cross(before[0], before[1], before[2], n0);
+        cross(after[0], after[1], after[2], n1);
+        const double l0 = length(n0), l1 = length(n1);
+        if (l1 == 0.0 || n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] < 0.25 * l0 * l1)
+          return true;
+      }
+      return false;
+    }
+
+    // Number of triangles with both vertices
+    std::size_t sharedTriangles(std::uint32_t a, std::uint32_t b) const
+    {
+      std::size_t count = 0;
+      for (std::size_t k = _offsets[a]; k < _offsets[a + 1]; ++k)
+      {
+        const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+        count += (t[0] == b || t[1] == b || t[2] == b) ? 1 : 0;
+      }
+      return count;
+    }
+
+    // One pass: collapse the cheapest independent edges, return false if none was collapsed
+    bool collapseEdges(std::size_t targetTriangles, float& error)
+    {
+      std::vector<Collapse> collapses;
+      collapses.reserve(_indices.size() * 2);
+      auto addCollapse = [&](std::uint32_t from, std::uint32_t to) {
+        if (!_movable[_group[from]] || _group[from] == _group[to])
+          return;
+        Quadric q = _quadrics[_group[from]];
+        q.add(_quadrics[_group[to]]);
+        collapses.push_back({ from, to, float(std::sqrt(q.evaluate(position(to)))) });
+      };
+      for (std::size_t i = 0; i < _indices.size(); i += 3)
+      {
+        for (int c = 0; c < 3; ++c)
+        {
+          addCollapse(_indices[i + c], _indices[i + (c + 1) % 3]);
+          addCollapse(_indices[i + (c + 1) % 3], _indices[i + c]);
+        }
+      }
+      std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+        return a.error < b.error;
+      });
+
+      // A vertex moves at most once per pass, and the vertices around it stay in place
+      // (so the flip tests stay valid)
+      std::vector<std::uint32_t> remap(_vertices.size());
+      std::iota(remap.begin(), remap.end(), 0);
+      std::vector<bool> locked(_vertices.size(), false);
+      auto lockAround = [&](std::uint32_t v) {
+        for (std::size_t k = _offsets[v]; k < _offsets[v + 1]; ++k)
+        {
+          const std::uint32_t* t = &_indices[3 * std::size_t(_triangles[k])];
+          locked[t[0]] = locked[t[1]] = locked[t[2]] = true;
+        }
+      };
+
+      const std::size_t numTriangles = _indices.size() / 3;
+      std::size_t removed = 0;
+      std::vector<Collapse> moves;
+
+      // The pass stops past the error of the collapses it needs (about two triangles each,
+      // two candidates by edge), leaving the more expensive ones to the next passes
+      const std::size_t goal = std::min(collapses.size(), numTriangles - targetTriangles) - 1;
+      const float maxError = collapses.empty() ? 0.0f : collapses[goal].error * 1.5f;
+      for (const Collapse& collapse : collapses)
+      {
+        if (numTriangles - removed <= targetTriangles || (removed > 0 && collapse.error > maxError))
+          break;
+
+        // All the vertices at the position of "from" move along
+        const std::uint32_t from = _group[collapse.from], to = _group[collapse.to];
+        if (!planMoves(from, to, moves))
+          continue;
+        bool valid = true;
+        for (const Collapse& move : moves)
+          valid = valid && !locked[move.from] && !locked[move.to] && !flips(move.from, move.to);
+        if (!valid)
+          continue;
+
+        for (const Collapse& move : moves)
+        {
+          remap[move.from] = move.to;
+          removed += sharedTriangles(move.from, move.to);
+        }
+        for (const Collapse& move : moves)
+          lockAround(move.from);
+        _quadrics[to].add(_quadrics[from]);
+        error = std::max(error, collapse.error);
+      }
+      if (removed == 0)
+        return false;
+
+      // Remove the triangles with two vertices at the same position
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < _indices.size(); i += 3)
+      {
+        const std::uint32_t a = remap[_indices[i]], b = remap[_indices[i + 1]], c = remap[_indices[i + 2]];
+        if (_group[a] == _group[b] || _group[b] == _group[c] || _group[c] == _group[a])
+          continue;
+        _indices[count++] = a;
+        _indices[count++] = b;
+        _indices[count++] = c;
+      }
+      _indices.resize(count);
+      return true;
+    }
+
+  private:
+    const std::vector<Vertex>&  _vertices;
+    std::vector<std::uint32_t>& _indices;   // Current triangles
+
+    std::vector<std::uint32_t>  _group;     // Position of each vertex
+    std::size_t                 _numGroups = 0;
+    std::vector<Quadric>        _quadrics;  // Per position
+
+    std::vector<std::size_t>    _offsets;   // Triangles of each vertex
+    std::vector<std::uint32_t>  _triangles;
+
+    std::vector<std::size_t>    _wedgeOffsets; // Used vertices of each position
+    std::vector<std::uint32_t>  _wedges;
+    std::vector<bool>           _movable;   // Per position: inside the surface
+  };
+}
+
+//--------------------------------------------------------------------------------------------------
+// Simplify the mesh until it has targetTriangles triangles
+float OBJLoader::simplifyMesh(const Mesh& mesh, std::size_t targetTriangles, std::vector<std::uint32_t>& indices)
+{
+  if (!mesh.isIndexed())
+  {
+    indices.clear();
+    return 0.0f;
+  }
+
+  Simplifier simplifier(mesh, mesh.indices, indices);
+  return simplifier.run(targetTriangles);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the levels of detail of a mesh
+void OBJLoader::generateLods(Mesh& mesh, std::size_t maxLods, float ratio, std::size_t minTriangles)
+{
+  mesh.lods.clear();
+  if (!mesh.isIndexed())
+    return;
+
+  std::size_t previous = mesh.indices.size() / 3;
+  float previousError = 0.0f;
+  while (mesh.lods.size() < maxLods)
+  {
+    const std::size_t target = std::size_t(float(previous) * ratio);
+    if (target < minTriangles || target >= previous)
+      break;
+
+    // Each level starts from the previous one (its error is measured against the mesh surface)
+    MeshLod lod;
+    Simplifier simplifier(mesh, mesh.lods.empty() ? mesh.indices : mesh.lods.back().indices, lod.indices);
+    lod.error = std::max(simplifier.run(target), previousError);
+
+    // Stop when less than half of the requested reduction was possible
+    const std::size_t numTriangles = lod.indices.size() / 3;
+    if (numTriangles == 0 || previous - numTriangles < (previous - target) / 2)
+      break;
+
+    previous = numTriangles;
+    previousError = lod.error;
+    mesh.lods.push_back(std::move(lod));
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // Simplify an indexed mesh with edge collapses ordered by quadric error (Garland and Heckbert
+  // 1997) until it has at most targetTriangles triangles, or no edge can be collapsed anymore.
+  // A vertex is only moved on one of its neighbors, so the result uses the vertices of the mesh:
+  // - the open borders of the mesh (boundaries with the meshes of other materials) are kept,
+  // - the vertices sharing a position (UV/normal seams, flat shading) move together, each one
+  //   on a vertex of the target position with a continuous UV (the UV seams are only collapsed
+  //   along the seam) and a normal within 60 degrees (sharper creases are kept).
+  // Return the estimated distance to the original surface (in object space)
+  float simplifyMesh(const Mesh& mesh, std::size_t targetTriangles, std::vector<std::uint32_t>& indices);
+
+  // Fill mesh.lods with up to maxLods levels of detail, each one with about ratio times
+  // the triangles of the previous one. Stops before minTriangles or when the simplification
+  // does not progress anymore (e.g. mesh made of many small parts).
+  void generateLods(Mesh& mesh, std::size_t maxLods = 4, float ratio = 0.5f, std::size_t minTriangles = 64);
+}
+
+#endif // MESHSIMPLIFIER_H
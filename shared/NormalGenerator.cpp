@@ -0,0 +1,466 @@
+#include "NormalGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+using namespace OBJLoader;
+
+namespace
+{
+  const std::uint32_t Empty = 0xFFFFFFFF;
+
+  // Run func(first, last) on numThreads threads, each one on its share of [0, count)
+  template<typename Func>
+  void runOnRanges(std::size_t count, std::size_t numThreads, Func func)
+  {
+    numThreads = std::max<std::size_t>(1, std::min(numThreads, count / 4096 + 1));
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for (std::size_t t = 1; t < numThreads; ++t)
+      threads.emplace_back(func, count * t / numThreads, count * (t + 1) / numThreads);
+    func(std::size_t(0), count / numThreads);
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+
+  // Open addressing table numbering the distinct keys of N 32 bit words (floats are
+  // compared by their bits), in order of insertion
+  template<std::size_t N>
+  class KeyTable
+  {
+  public:
+    explicit KeyTable(std::size_t maxKeys)
+    {
+      // Keep the load factor under 1/2
+      std::size_t size = 16;
+      while (size < 2 * maxKeys)
+        size *= 2;
+      _slots.resize(size, Empty);
+      _keys.reserve(maxKeys * N);
+      _mask = size - 1;
+    }
+
+    // Return the number of the key, adding it if needed
+    std::uint32_t findOrInsert(const std::uint32_t* key)
+    {
+      std::size_t h = hash(key) & _mask;
+      for (;;)
+      {
+        std::uint32_t& slot = _slots[h];
+        if (slot == Empty)
+        {
+          slot = static_cast<std::uint32_t>(_keys.size() / N);
+          _keys.insert(_keys.end(), key, key + N);
+          return slot;
+        }
+        if (std::memcmp(&_keys[std::size_t(slot) * N], key, N * sizeof(std::uint32_t)) == 0)
+          return slot;
+        h = (h + 1) & _mask;
+      }
+    }
+
+    std::size_t size() const { return _keys.size() / N; }
+
+  private:
+    static std::size_t hash(const std::uint32_t* key)
+    {
+      std::uint64_t h = 0;
+      for (std::size_t i = 0; i < N; ++i)
+      {
+        h = (h + key[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+      }
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    std::vector<std::uint32_t> _slots;
+    std::vector<std::uint32_t> _keys;
+    std::size_t _mask;
+  };
+
+  // Bits of a float, with -0 and +0 merged
+  inline std::uint32_t floatBits(float value)
+  {
+    value += 0.0f;
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  inline bool isZero(const float n[3])
+  {
+    return n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f;
+  }
+
+  inline float dot(const float* a, const float* b)
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  // Normalize v, unless it is zero
+  inline void normalize(float v[3])
+  {
+    const float length = std::sqrt(dot(v, v));
+    if (length > 0.0f)
+    {
+      for (int k = 0; k < 3; ++k)
+        v[k] /= length;
+    }
+  }
+
+  // Remove from v its component along the unit vector n, and normalize it
+  inline void projectOnPlane(float v[3], const float n[3])
+  {
+    const float d = dot(v, n);
+    for (int k = 0; k < 3; ++k)
+      v[k] -= d * n[k];
+    normalize(v);
+  }
+
+  // Group the corners by key (key k has corners[offsets[k]..offsets[k + 1]]), in triangle
+  // order so the sums over a group do not depend on the number of threads
+  template<typename KeyOf>
+  void cornersByKey(std::size_t numCorners, std::size_t numKeys, KeyOf keyOf, std::vector<std::uint32_t>& offsets, std::vector<std::uint32_t>& corners)
+  {
+    offsets.assign(numKeys + 1, 0);
+    for (std::size_t i = 0; i < numCorners; ++i)
+      ++offsets[keyOf(i) + 1];
+    for (std::size_t k = 0; k < numKeys; ++k)
+      offsets[k + 1] += offsets[k];
+    corners.resize(numCorners);
+    std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < numCorners; ++i)
+      corners[fill[keyOf(i)]++] = static_cast<std::uint32_t>(i);
+  }
+
+  // Give each corner of an indexed mesh a vertex holding its value (N floats per corner in
+  // cornerValues), copying the vertices whose corners have different values. The copies of a
+  // vertex are chained (firstCopy, nextCopy) and a corner reuses the copy with its value.
+  // The levels of detail use the first copy of their vertices. Return the value of each vertex.
+  template<std::size_t N>
+  std::vector<float> splitVertices(Mesh& mesh, const std::vector<float>& cornerValues)
+  {
+    std::vector<std::uint32_t> firstCopy(mesh.vertices.size(), Empty);
+    std::vector<std::uint32_t> nextCopy;
+    std::vector<Vertex> vertices;
+    std::vector<float> values;
+    vertices.reserve(mesh.vertices.size());
+    nextCopy.reserve(mesh.vertices.size());
+    values.reserve(N * mesh.vertices.size());
+    for (std::size_t i = 0; i < cornerValues.size() / N; ++i)
+    {
+      const float* value = &cornerValues[N * i];
+      const std::uint32_t vertex = mesh.indices[i];
+      std::uint32_t copy = firstCopy[vertex];
+      std::uint32_t last = Empty;
+      while (copy != Empty && std::memcmp(&values[N * copy], value, N * sizeof(float)) != 0)
+      {
+        last = copy;
+        copy = nextCopy[copy];
+      }
+      if (copy == Empty)
+      {
+        copy = static_cast<std::uint32_t>(vertices.size());
+        vertices.push_back(mesh.vertices[vertex]);
+        values.insert(values.end(), value, value + N);
+        nextCopy.push_back(Empty);
+        (last == Empty ? firstCopy[vertex] : nextCopy[last]) = copy;
+      }
+      mesh.indices[i] = copy;
+    }
+    for (MeshLod& lod : mesh.lods)
+    {
+      for (std::uint32_t& index : lod.indices)
+        index = firstCopy[index];
+    }
+    mesh.vertices.swap(vertices);
+    return values;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Replace the missing normals of a mesh by smooth normals
+void OBJLoader::generateNormals(Mesh& mesh, const std::uint32_t* smoothingGroups, float creaseAngle, std::size_t numThreads)
+{
+  const bool indexed = mesh.isIndexed();
+  const std::size_t numCorners = mesh.numElements() - mesh.numElements() % 3;
+  const std::size_t numTriangles = numCorners / 3;
+  auto vertexOf = [&](std::size_t corner) { return indexed ? mesh.indices[corner] : corner; };
+
+  bool missing = false;
+  for (std::size_t i = 0; i < numCorners && !missing; ++i)
+    missing = isZero(mesh.vertices[vertexOf(i)].normal);
+  if (!missing)
+    return;
+
+  // Number the distinct positions
+  std::vector<std::uint32_t> positionOf(mesh.vertices.size());
+  KeyTable<3> positions(mesh.vertices.size());
+  for (std::size_t v = 0; v < mesh.vertices.size(); ++v)
+  {
+    const float* p = mesh.vertices[v].position;
+    const std::uint32_t key[3] = { floatBits(p[0]), floatBits(p[1]), floatBits(p[2]) };
+    positionOf[v] = positions.findOrInsert(key);
+  }
+
+  // Corners at each position
+  std::vector<std::uint32_t> offsets, corners;
+  cornersByKey(numCorners, positions.size(), [&](std::size_t i) { return positionOf[vertexOf(i)]; }, offsets, corners);
+
+  // Unit normal of each triangle (zero when degenerate) and angle at each of its corners
+  std::vector<float> faceNormals(3 * numTriangles);
+  std::vector<float> angles(numCorners);
+  runOnRanges(numTriangles, numThreads, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t)
+    {
+      const float* p[3];
+      for (int c = 0; c < 3; ++c)
+        p[c] = mesh.vertices[vertexOf(3 * t + c)].position;
+
+      for (int c = 0; c < 3; ++c)
+      {
+        const float* a = p[c];
+        const float* b = p[(c + 1) % 3];
+        const float* d = p[(c + 2) % 3];
+        const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+        const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        const float sine = std::sqrt(dot(n, n));
+        angles[3 * t + c] = std::atan2(sine, dot(e1, e2));
+        if (c == 0 && sine > 0.0f)
+        {
+          for (int k = 0; k < 3; ++k)
+            faceNormals[3 * t + k] = n[k] / sine;
+        }
+      }
+    }
+  });
+
+  // Normal of each corner, from the triangles around its position. Each thread only writes
+  // the corners of its triangles.
+  const float cosCrease = (creaseAngle >= 180.0f) ? -2.0f : std::cos(creaseAngle * 3.14159265358979f / 180.0f);
+  std::vector<float> cornerNormals(indexed ? 3 * numCorners : 0);
+  runOnRanges(numTriangles, numThreads, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t)
+    {
+      const float* faceNormal = &faceNormals[3 * t];
+      const std::uint32_t group = smoothingGroups ? smoothingGroups[t] : DefaultSmoothingGroup;
+      for (std::size_t i = 3 * t; i < 3 * t + 3; ++i)
+      {
+        Vertex& vertex = mesh.vertices[vertexOf(i)];
+        float* out = indexed ? &cornerNormals[3 * i] : vertex.normal;
+        if (!isZero(vertex.normal))
+        {
+          std::copy(vertex.normal, vertex.normal + 3, out);
+          continue;
+        }
+
+        float n[3] = { faceNormal[0], faceNormal[1], faceNormal[2] };
+        if (group != 0)
+        {
+          n[0] = n[1] = n[2] = 0.0f;
+          const std::uint32_t position = positionOf[vertexOf(i)];
+          for (std::size_t k = offsets[position]; k < offsets[position + 1]; ++k)
+          {
+            const std::size_t other = corners[k] / 3;
+            const float* otherNormal = &faceNormals[3 * other];
+            if (smoothingGroups && smoothingGroups[other] != group)
+              continue;
+            if (other != t && !isZero(faceNormal) && dot(faceNormal, otherNormal) < cosCrease)
+              continue;
+            for (int c = 0; c < 3; ++c)
+              n[c] += angles[corners[k]] * otherNormal[c];
+          }
+          normalize(n);
+        }
+        std::copy(n, n + 3, out);
+      }
+    }
+  });
+  if (!indexed)
+    return;
+
+  // Split the vertices whose corners got different normals
+  const std::vector<float> normals = splitVertices<3>(mesh, cornerNormals);
+  for (std::size_t v = 0; v < mesh.vertices.size(); ++v)
+    std::copy(&normals[3 * v], &normals[3 * v] + 3, mesh.vertices[v].normal);
+}
+
+//--------------------------------------------------------------------------------------------------
+// MikkTSpace tangents of a mesh
+std::vector<Tangent> OBJLoader::generateTangents(Mesh& mesh, std::size_t numThreads)
+{
+  const bool indexed = mesh.isIndexed();
+  const std::size_t numCorners = mesh.numElements() - mesh.numElements() % 3;
+  const std::size_t numTriangles = numCorners / 3;
+  auto vertexOf = [&](std::size_t corner) { return indexed ? mesh.indices[corner] : corner; };
+
+  // Number the distinct vertices (same position, normal and uv), as MikkTSpace welds them
+  std::vector<std::uint32_t> weldOf(mesh.vertices.size());
+  KeyTable<8> welded(mesh.vertices.size());
+  for (std::size_t v = 0; v < mesh.vertices.size(); ++v)
+  {
+    const Vertex& vertex = mesh.vertices[v];
+    const std::uint32_t key[8] = { floatBits(vertex.position[0]), floatBits(vertex.position[1]), floatBits(vertex.position[2]),
+                                   floatBits(vertex.normal[0]), floatBits(vertex.normal[1]), floatBits(vertex.normal[2]),
+                                   floatBits(vertex.uv[0]), floatBits(vertex.uv[1]) };
+    weldOf[v] = welded.findOrInsert(key);
+  }
+
+  // Corners of each welded vertex
+  std::vector<std::uint32_t> offsets, corners;
+  cornersByKey(numCorners, welded.size(), [&](std::size_t i) { return weldOf[vertexOf(i)]; }, offsets, corners);
+
+  // For each triangle, its orientation in uv space and whether it is degenerate.
+  // For each corner, the tangent of its triangle projected on the plane of the corner normal,
+  // and the angle of the triangle at the corner in that plane.
+  enum { OrientationPreserving = 1, DegenerateUV = 2, DegeneratePosition = 4 };
+  std::vector<std::uint8_t> flags(numTriangles, 0);
+  std::vector<float> projected(3 * numCorners);
+  std::vector<float> angles(numCorners);
+  runOnRanges(numTriangles, numThreads, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t)
+    {
+      const Vertex* v[3];
+      std::uint32_t w[3];
+      for (int c = 0; c < 3; ++c)
+      {
+        v[c] = &mesh.vertices[vertexOf(3 * t + c)];
+        w[c] = weldOf[vertexOf(3 * t + c)];
+      }
+      if (w[0] == w[1] || w[1] == w[2] || w[2] == w[0])
+        flags[t] |= DegeneratePosition;
+
+      // Tangent of the triangle (direction of increasing u)
+      const float d1[3] = { v[1]->position[0] - v[0]->position[0], v[1]->position[1] - v[0]->position[1], v[1]->position[2] - v[0]->position[2] };
+      const float d2[3] = { v[2]->position[0] - v[0]->position[0], v[2]->position[1] - v[0]->position[1], v[2]->position[2] - v[0]->position[2] };
+      const float t21[2] = { v[1]->uv[0] - v[0]->uv[0], v[1]->uv[1] - v[0]->uv[1] };
+      const float t31[2] = { v[2]->uv[0] - v[0]->uv[0], v[2]->uv[1] - v[0]->uv[1] };
+      const float signedArea = t21[0] * t31[1] - t21[1] * t31[0];
+      float tangent[3] = { 0.0f, 0.0f, 0.0f };
+      if (signedArea > 0.0f)
+        flags[t] |= OrientationPreserving;
+      if (std::abs(signedArea) > std::numeric_limits<float>::min())
+      {
+        for (int k = 0; k < 3; ++k)
+          tangent[k] = t31[1] * d1[k] - t21[1] * d2[k];
+        normalize(tangent);
+        if (signedArea < 0.0f)
+        {
+          for (int k = 0; k < 3; ++k)
+            tangent[k] = -tangent[k];
+        }
+      }
+      else
+      {
+        flags[t] |= DegenerateUV;
+      }
+
+      for (int c = 0; c < 3; ++c)
+      {
+        const float* n = v[c]->normal;
+        float* out = &projected[3 * (3 * t + c)];
+        std::copy(tangent, tangent + 3, out);
+        projectOnPlane(out, n);
+
+        const float* p = v[c]->position;
+        const float* previous = v[(c + 2) % 3]->position;
+        const float* next = v[(c + 1) % 3]->position;
+        float e1[3] = { previous[0] - p[0], previous[1] - p[1], previous[2] - p[2] };
+        float e2[3] = { next[0] - p[0], next[1] - p[1], next[2] - p[2] };
+        projectOnPlane(e1, n);
+        projectOnPlane(e2, n);
+        angles[3 * t + c] = std::acos(std::clamp(dot(e1, e2), -1.0f, 1.0f));
+      }
+    }
+  });
+
+  // Any unit vector orthogonal to n, for the vertices without uv mapping
+  auto orthogonal = [](const float n[3], float* out) {
+    const int axis = (std::abs(n[0]) <= std::abs(n[1]) && std::abs(n[0]) <= std::abs(n[2])) ? 0 : (std::abs(n[1]) <= std::abs(n[2]) ? 1 : 2);
+    out[0] = out[1] = out[2] = 0.0f;
+    out[axis] = 1.0f;
+    projectOnPlane(out, n);
+    if (isZero(out))
+      out[0] = 1.0f;
+  };
+
+  // Tangent of each corner: angle weighted mean of the tangents of the triangles around
+  // its vertex with the same orientation. Triangles without uv area take the orientation of
+  // the vertex, triangles with two corners on the same vertex are ignored.
+  std::vector<float> cornerTangents(4 * numCorners);
+  runOnRanges(numTriangles, numThreads, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t)
+    {
+      if (flags[t] & DegeneratePosition)
+        continue;
+      for (std::size_t i = 3 * t; i < 3 * t + 3; ++i)
+      {
+        const std::uint32_t w = weldOf[vertexOf(i)];
+        bool preserving = (flags[t] & OrientationPreserving) != 0;
+        if (flags[t] & DegenerateUV)
+        {
+          for (std::size_t k = offsets[w]; k < offsets[w + 1]; ++k)
+          {
+            const std::uint8_t other = flags[corners[k] / 3];
+            if ((other & (DegenerateUV | DegeneratePosition)) == 0)
+            {
+              preserving = (other & OrientationPreserving) != 0;
+              break;
+            }
+          }
+        }
+
+        float* out = &cornerTangents[4 * i];
+        out[0] = out[1] = out[2] = 0.0f;
+        for (std::size_t k = offsets[w]; k < offsets[w + 1]; ++k)
+        {
+          const std::uint8_t other = flags[corners[k] / 3];
+          if ((other & (DegenerateUV | DegeneratePosition)) != 0 || ((other & OrientationPreserving) != 0) != preserving)
+            continue;
+          for (int c = 0; c < 3; ++c)
+            out[c] += angles[corners[k]] * projected[3 * std::size_t(corners[k]) + c];
+        }
+        normalize(out);
+        if (isZero(out))
+          orthogonal(mesh.vertices[vertexOf(i)].normal, out);
+        out[3] = preserving ? 1.0f : -1.0f;
+      }
+    }
+  });
+
+  // Corners of the triangles with two corners on the same vertex: copy the tangent of
+  // another corner of their vertex
+  runOnRanges(numTriangles, numThreads, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t)
+    {
+      if ((flags[t] & DegeneratePosition) == 0)
+        continue;
+      for (std::size_t i = 3 * t; i < 3 * t + 3; ++i)
+      {
+        const std::uint32_t w = weldOf[vertexOf(i)];
+        float* out = &cornerTangents[4 * i];
+        orthogonal(mesh.vertices[vertexOf(i)].normal, out);
+        out[3] = 1.0f;
+        for (std::size_t k = offsets[w]; k < offsets[w + 1]; ++k)
+        {
+          if ((flags[corners[k] / 3] & DegeneratePosition) == 0)
+          {
+            std::copy(&cornerTangents[4 * std::size_t(corners[k])], &cornerTangents[4 * std::size_t(corners[k])] + 4, out);
+            break;
+          }
+        }
+      }
+    }
+  });
+
+  // One tangent per vertex: split the vertices whose corners got different tangents
+  const std::vector<float> values = indexed ? splitVertices<4>(mesh, cornerTangents) : cornerTangents;
+  std::vector<Tangent> tangents(values.size() / 4);
+  if (!tangents.empty())
+    std::memcpy(tangents.data(), values.data(), values.size() * sizeof(float));
+  return tangents;
+}
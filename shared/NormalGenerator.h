@@ -0,0 +1,41 @@
+#ifndef NORMALGENERATOR_H
+#define NORMALGENERATOR_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // Default crease angle (in degrees) of the generated normals
+  const float DefaultCreaseAngle = 60.0f;
+
+  // Smoothing group of the triangles before the first s statement: smoothed together
+  const std::uint32_t DefaultSmoothingGroup = 1;
+
+  // Replace the missing normals of a mesh (the zero ones: the loader gives them to the face
+  // corners without normal index) by smooth normals. The normal of a corner is the mean of the
+  // normals of the triangles around its position, weighted by their angle at this position.
+  // Only the triangles of the same smoothing group whose normal makes an angle smaller than
+  // creaseAngle (in degrees) with the normal of the corner's triangle are taken into account.
+  // smoothingGroups gives the group of each triangle (0: flat shaded), nullptr puts all the
+  // triangles in DefaultSmoothingGroup.
+  // The vertices of an indexed mesh are split where their corners get different normals.
+  // The triangles are shared between numThreads threads.
+  void generateNormals(Mesh& mesh, const std::uint32_t* smoothingGroups, float creaseAngle = DefaultCreaseAngle, std::size_t numThreads = 1);
+
+  // Tangent of a vertex, for normal mapping: bitangent = handedness * cross(normal, tangent)
+  struct Tangent
+  {
+    float direction[3];
+    float handedness; // 1, or -1 where the uv mapping is mirrored
+  };
+
+  // Tangents of a mesh with normals and uvs, computed as MikkTSpace does (the tangent space of
+  // Blender, Substance, xNormal, ...) so the normal maps baked for the mesh match: the tangent
+  // of a corner is the angle weighted mean of the uv tangents of the triangles around its vertex
+  // with the same orientation, projected on the plane of its normal. Return one tangent per vertex.
+  // The vertices of an indexed mesh are split where their corners get different tangents
+  // (mirrored uvs); the levels of detail keep one of the copies. Same threading as generateNormals.
+  std::vector<Tangent> generateTangents(Mesh& mesh, std::size_t numThreads = 1);
+}
+
+#endif // NORMALGENERATOR_H
@@ -1,8 +1,21 @@
 #include "OBJLoader.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+#include "NormalGenerator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <thread>
 
 using namespace OBJLoader;
 
@@ -23,6 +36,19 @@ namespace
     float x,y;
   };
 
+  // Material used by the faces before the first usemtl
+  Material defaultMaterial()
+  {
+    Material defaultMat;
+    defaultMat.Ka[0] = 1.0; defaultMat.Ka[1] = 1.0; defaultMat.Ka[2] = 1.0; defaultMat.Ka[3] = 1.0;
+    defaultMat.Ke[0] = 0.0; defaultMat.Ke[1] = 0.0; defaultMat.Ke[2] = 0.0; defaultMat.Ke[3] = 1.0;
+    defaultMat.Kd[0] = 1.0; defaultMat.Kd[1] = 1.0; defaultMat.Kd[2] = 1.0; defaultMat.Kd[3] = 1.0;
+    defaultMat.Ks[0] = 1.0; defaultMat.Ks[1] = 1.0; defaultMat.Ks[2] = 1.0; defaultMat.Ks[3] = 1.0;
+    defaultMat.Kn = 128;
+    defaultMat.name = "(Default)";
+    return defaultMat;
+  }
+
   // Extract path from a string
   std::string extractPath(const std::string& filepathname)
   {
@@ -33,18 +59,481 @@ namespace
 
     return filepathname.substr(0, pos);
   }
+
+  // Append a file name to a path
+  std::string joinPath(const std::string& path, std::string_view filename)
+  {
+    std::string pathname = path;
+#ifdef Q_OS_WIN32
+    pathname.append("\\");
+#else
+    pathname.append("/");
+#endif
+    pathname.append(filename);
+    return pathname;
+  }
+
+  //------------------------------------------------------------------------------------------------
+  // In place tokenizer helpers (used by the mapped parser)
+  // All of them work on a [p, end) character range and never allocate.
+  inline bool isBlank(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+
+  inline const char* skipBlanks(const char* p, const char* end)
+  {
+    while (p != end && isBlank(*p))
+      ++p;
+    return p;
+  }
+
+  inline const char* skipToken(const char* p, const char* end)
+  {
+    while (p != end && !isBlank(*p))
+      ++p;
+    return p;
+  }
+
+  // Extract the next blank separated token and advance p after it
+  inline std::string_view nextToken(const char*& p, const char* end)
+  {
+    const char* first = skipBlanks(p, end);
+    p = skipToken(first, end);
+    return std::string_view(first, p - first);
+  }
+
+  // Parse a float after optional blanks. On failure, value is left untouched
+  // and false is returned (same behavior as operator>> on a failed stream).
+  inline bool parseFloat(const char*& p, const char* end, float& value)
+  {
+    const char* first = skipBlanks(p, end);
+    // from_chars does not accept an explicit '+' sign
+    if (first != end && *first == '+')
+      ++first;
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result res = std::from_chars(first, end, value);
+    if (res.ec == std::errc::invalid_argument)
+      return false;
+    p = res.ptr;
+    return res.ec == std::errc();
+#else
+    // Floating point from_chars is not available on every standard library:
+    // fall back on strtof with a small copy of the token on the stack.
+    char buffer[64];
+    std::size_t length = std::min<std::size_t>(skipToken(first, end) - first, sizeof(buffer) - 1);
+    std::memcpy(buffer, first, length);
+    buffer[length] = '\0';
+    char* last = nullptr;
+    float v = std::strtof(buffer, &last);
+    if (last == buffer)
+      return false;
+    value = v;
+    p = first + (last - buffer);
+    return true;
+#endif
+  }
+
+  // Parse an OBJ index as written in the file: 1-based, negative values are relative
+  // to the end of the list and 0 means missing
+  inline int parseRawIndex(const char* first, const char* last)
+  {
+    int index = 0;
+    if (std::from_chars(first, last, index).ec != std::errc())
+      return 0;
+    return index;
+  }
+
+  // Convert an OBJ index to a position in a list of count elements (where element 0 is the dummy).
+  // Missing or out of range indices are mapped to the dummy element.
+  inline unsigned int resolveIndex(int index, std::size_t count)
+  {
+    long long resolved = index;
+    if (resolved < 0)
+      resolved += static_cast<long long>(count);
+    if (resolved <= 0 || resolved >= static_cast<long long>(count))
+      return 0;
+    return static_cast<unsigned int>(resolved);
+  }
+
+  // Smoothing group of an s statement ("off" or 0: flat shaded)
+  inline std::uint32_t parseSmoothingGroup(std::string_view token)
+  {
+    std::uint32_t group = 0;
+    if (std::from_chars(token.data(), token.data() + token.size(), group).ec != std::errc())
+      return 0;
+    return group;
+  }
+
+  // Indices of one face corner, as written in the file
+  struct RawCorner
+  {
+    int v, uv, n;
+  };
+
+  // Indices of one face corner in the position, uv and normal lists
+  struct FaceCorner
+  {
+    unsigned int v, uv, n;
+  };
+
+  // Parse a face corner (v, v/vt, v//vn or v/vt/vn)
+  inline RawCorner parseFaceCorner(std::string_view token)
+  {
+    const char* first = token.data();
+    const char* end = first + token.size();
+
+    RawCorner c = { 0, 0, 0 };
+    const char* slash = std::find(first, end, '/');
+    c.v = parseRawIndex(first, slash);
+    if (slash == end)
+      return c;
+
+    first = slash + 1;
+    slash = std::find(first, end, '/');
+    c.uv = parseRawIndex(first, slash);
+    if (slash == end)
+      return c;
+
+    c.n = parseRawIndex(slash + 1, end);
+    return c;
+  }
+
+  inline FaceCorner resolveCorner(const RawCorner& c, std::size_t numVertices, std::size_t numUVs, std::size_t numNormals)
+  {
+    FaceCorner r;
+    r.v = resolveIndex(c.v, numVertices);
+    r.uv = resolveIndex(c.uv, numUVs);
+    r.n = resolveIndex(c.n, numNormals);
+    return r;
+  }
+
+  // Build a mesh vertex from the position, uv and normal lists
+  inline Vertex makeVertex(const FaceCorner& c, const Point3D* vertices, const Point3D* normals, const Point2D* uvs)
+  {
+    Vertex v;
+    v.position[0] = vertices[c.v].x;
+    v.position[1] = vertices[c.v].y;
+    v.position[2] = vertices[c.v].z;
+    v.normal[0] = normals[c.n].x;
+    v.normal[1] = normals[c.n].y;
+    v.normal[2] = normals[c.n].z;
+    v.uv[0] = uvs[c.uv].x;
+    v.uv[1] = uvs[c.uv].y;
+    return v;
+  }
+
+  // Open addressing hash table giving the vertex index of a face corner in an indexed mesh
+  class CornerTable
+  {
+  public:
+    explicit CornerTable(std::size_t maxCorners)
+    {
+      // Keep the load factor under 1/2
+      std::size_t size = 16;
+      while (size < 2 * maxCorners)
+        size *= 2;
+      _entries.resize(size, Entry{ { 0, 0, 0 }, Empty });
+      _mask = size - 1;
+    }
+
+    // Return the index of the corner, or add it with the index newIndex
+    std::uint32_t findOrInsert(const FaceCorner& c, std::uint32_t newIndex)
+    {
+      std::size_t h = hash(c) & _mask;
+      for (;;)
+      {
+        Entry& e = _entries[h];
+        if (e.index == Empty)
+        {
+          e.corner = c;
+          e.index = newIndex;
+          return newIndex;
+        }
+        if (e.corner.v == c.v && e.corner.uv == c.uv && e.corner.n == c.n)
+          return e.index;
+        h = (h + 1) & _mask;
+      }
+    }
+
+  private:
+    static const std::uint32_t Empty = 0xFFFFFFFF;
+
+    struct Entry
+    {
+      FaceCorner corner;
+      std::uint32_t index;
+    };
+
+    static std::size_t hash(const FaceCorner& c)
+    {
+      std::uint64_t h = c.v * 0x9E3779B97F4A7C15ull;
+      h ^= (h >> 29) + c.uv * 0xBF58476D1CE4E5B9ull;
+      h ^= (h >> 31) + c.n * 0x94D049BB133111EBull;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    std::vector<Entry> _entries;
+    std::size_t _mask;
+  };
+
+  // Fill an indexed mesh from the corners of its triangles: the first occurrence of each
+  // (position, uv, normal) triplet creates a vertex, the following ones reuse it.
+  void buildIndexedMesh(const std::vector<FaceCorner>& corners, const Point3D* vertices, const Point3D* normals, const Point2D* uvs, Mesh& mesh)
+  {
+    CornerTable table(corners.size());
+    mesh.vertices.clear();
+    mesh.indices.resize(corners.size());
+    for (std::size_t i = 0; i < corners.size(); ++i)
+    {
+      std::uint32_t newIndex = static_cast<std::uint32_t>(mesh.vertices.size());
+      std::uint32_t index = table.findOrInsert(corners[i], newIndex);
+      if (index == newIndex)
+        mesh.vertices.push_back(makeVertex(corners[i], vertices, normals, uvs));
+      mesh.indices[i] = index;
+    }
+    mesh.vertices.shrink_to_fit();
+  }
+
+  // Number of mesh vertices created by the fan triangulation of a face
+  inline std::size_t triangulatedSize(std::size_t numCorners)
+  {
+    return numCorners < 3 ? 0 : 3 * (numCorners - 2);
+  }
+
+  // Run func(i) for i in [0, count), each call on its own thread
+  template<typename Func>
+  void runOnThreads(std::size_t count, Func func)
+  {
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (std::size_t i = 1; i < count; ++i)
+      threads.emplace_back(func, i);
+    if (count > 0)
+      func(0);
+    for (std::thread& t : threads)
+      t.join();
+  }
+
+  // Build the indexed meshes from their triangle corners (see buildIndexedMesh),
+  // several meshes at the same time when numThreads > 1
+  void buildIndexedMeshes(std::vector<std::vector<FaceCorner>>& meshCorners, const std::vector<Point3D>& vertices, const std::vector<Point3D>& normals, const std::vector<Point2D>& uvs, std::vector<Mesh>& meshes, std::size_t numThreads)
+  {
+    std::atomic<std::size_t> next(0);
+    runOnThreads(std::min(numThreads, meshCorners.size()), [&](std::size_t) {
+      for (std::size_t m = next++; m < meshCorners.size(); m = next++)
+      {
+        buildIndexedMesh(meshCorners[m], vertices.data(), normals.data(), uvs.data(), meshes[m]);
+        std::vector<FaceCorner>().swap(meshCorners[m]);
+      }
+    });
+  }
+
+  // Walk the lines in [p, end) and forward each OBJ statement to the handler:
+  //   position(const Point3D&), normal(const Point3D&), uv(const Point2D&),
+  //   face(const std::vector<RawCorner>&) (only for faces with 3 corners or more),
+  //   useMaterial(std::string_view), group(std::string_view), materialLibrary(std::string_view),
+  //   smoothingGroup(std::string_view)
+  // The line classification follows the stream parser.
+  // When given, bytesRead is increased as the lines are parsed (by steps of ProgressStep bytes),
+  // and the parsing stops at the first step where cancel is set.
+  const std::size_t ProgressStep = 1 << 20;
+
+  template<typename Handler>
+  void parseLines(const char* p, const char* end, Handler& handler, std::atomic<std::size_t>* bytesRead,
+                  const std::atomic<bool>* cancel)
+  {
+    // Face corners of the current face (reused between lines)
+    std::vector<RawCorner> corners;
+    const char* reported = p;
+
+    while (p != end)
+    {
+      if (std::size_t(p - reported) >= ProgressStep)
+      {
+        if (bytesRead != nullptr)
+          bytesRead->fetch_add(p - reported, std::memory_order_relaxed);
+        reported = p;
+        if (cancel != nullptr && cancel->load(std::memory_order_relaxed))
+          return;
+      }
+
+      // Current line is [p, eol)
+      const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      if (eol == nullptr)
+        eol = end;
+      const char* line = p;
+      p = (eol == end) ? end : eol + 1;
+
+      const std::size_t length = eol - line;
+      if (length == 0)
+        continue;
+
+      const char c0 = line[0];
+      const char c1 = length > 1 ? line[1] : '\0';
+      if (c0 == '#')
+      {
+        // Comments... just ignore the line
+        continue;
+      }
+      else if (c0 == 'v' && c1 == ' ')
+      {
+        // Vertex!
+        Point3D v;
+        const char* it = line + 2;
+        parseFloat(it, eol, v.x) && parseFloat(it, eol, v.y) && parseFloat(it, eol, v.z);
+        handler.position(v);
+      }
+      else if (c0 == 'v' && c1 == 'n')
+      {
+        // Normal!
+        Point3D n;
+        const char* it = line + 2;
+        parseFloat(it, eol, n.x) && parseFloat(it, eol, n.y) && parseFloat(it, eol, n.z);
+        handler.normal(n);
+      }
+      else if (c0 == 'v' && c1 == 't')
+      {
+        // Tex coord!
+        Point2D uv;
+        const char* it = line + 2;
+        parseFloat(it, eol, uv.x) && parseFloat(it, eol, uv.y);
+        handler.uv(uv);
+      }
+      else if (c0 == 'u')
+      {
+        // usemtl! Get the material's name
+        const char* it = line;
+        nextToken(it, eol);
+        handler.useMaterial(nextToken(it, eol));
+      }
+      else if (c0 == 'g')
+      {
+        // Group! Get its name
+        const char* it = line;
+        nextToken(it, eol);
+        handler.group(nextToken(it, eol));
+      }
+      else if (c0 == 'f')
+      {
+        // Face! Get its vertices data
+        corners.clear();
+        const char* it = line + 1;
+        for (std::string_view token = nextToken(it, eol); !token.empty(); token = nextToken(it, eol))
+          corners.push_back(parseFaceCorner(token));
+
+        if (corners.size() >= 3)
+          handler.face(corners);
+      }
+      else if (c0 == 'm')
+      {
+        // mtllib! Get the file name
+        const char* it = line;
+        nextToken(it, eol);
+        handler.materialLibrary(nextToken(it, eol));
+      }
+      else if (c0 == 's' && isBlank(c1))
+      {
+        // Smoothing group! Get its number
+        const char* it = line + 1;
+        handler.smoothingGroup(nextToken(it, eol));
+      }
+    }
+
+    if (bytesRead != nullptr)
+      bytesRead->fetch_add(end - reported, std::memory_order_relaxed);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bounds of a list of vertices
+Bounds OBJLoader::computeBounds(const Vertex* vertices, std::size_t count)
+{
+  Bounds b;
+  for (int k = 0; k < 3; ++k)
+  {
+    b.min[k] = std::numeric_limits<float>::max();
+    b.max[k] = -std::numeric_limits<float>::max();
+  }
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      b.min[k] = std::min(b.min[k], vertices[i].position[k]);
+      b.max[k] = std::max(b.max[k], vertices[i].position[k]);
+    }
+  }
+  return b;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sphere centered on the bounds: the center of the box and the farthest vertex from it
+BoundingSphere OBJLoader::computeBoundingSphere(const Vertex* vertices, std::size_t count, const Bounds& bounds)
+{
+  BoundingSphere s = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+  if (count == 0)
+    return s;
+  for (int k = 0; k < 3; ++k)
+    s.center[k] = 0.5f * (bounds.min[k] + bounds.max[k]);
+  float radius2 = 0.0f;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const float* p = vertices[i].position;
+    const float d[3] = { p[0] - s.center[0], p[1] - s.center[1], p[2] - s.center[2] };
+    radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  }
+  s.radius = std::sqrt(radius2);
+  return s;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Indices stored with the smallest type
+std::vector<std::uint8_t> Mesh::packedIndices() const
+{
+  const std::size_t size = indexSize();
+  std::vector<std::uint8_t> packed(totalIndices() * size);
+  std::size_t offset = 0;
+  auto pack = [&](const std::vector<std::uint32_t>& source) {
+    if (size == 4)
+    {
+      if (!source.empty())
+        std::memcpy(packed.data() + offset, source.data(), source.size() * 4);
+    }
+    else
+    {
+      for (std::size_t i = 0; i < source.size(); ++i)
+      {
+        std::uint16_t index = static_cast<std::uint16_t>(source[i]);
+        std::memcpy(packed.data() + offset + 2 * i, &index, 2);
+      }
+    }
+    offset += source.size() * size;
+  };
+
+  pack(indices);
+  for (const MeshLod& lod : lods)
+    pack(lod.indices);
+  return packed;
+}
+
+std::size_t Mesh::totalIndices() const
+{
+  std::size_t count = indices.size();
+  for (const MeshLod& lod : lods)
+    count += lod.indices.size();
+  return count;
 }
 
 //--------------------------------------------------------------------------------------------------
 // Constructors / Destructors
 Loader::Loader()
-  : _isLoaded(false)
+  : _isLoaded(false), _threadCount(0), _indexed(false), _creaseAngle(DefaultCreaseAngle), _bytesRead(nullptr), _cancel(nullptr)
 {}
 
-Loader::Loader(const std::string& filename)
-  : _isLoaded(false)
+Loader::Loader(const std::string& filename, ParseMode mode)
+  : _isLoaded(false), _threadCount(0), _indexed(false), _creaseAngle(DefaultCreaseAngle), _bytesRead(nullptr), _cancel(nullptr)
 {
-  loadFile(filename);
+  loadFile(filename, mode);
 }
 
 Loader::~Loader()
@@ -52,46 +541,144 @@ Loader::~Loader()
 
 //--------------------------------------------------------------------------------------------------
 // Load file
-bool Loader::loadFile(const std::string& filename)
+bool Loader::loadFile(const std::string& filename, ParseMode mode)
 {
   // Clear current data
   unload();
 
-  // Open the input file
-  std::ifstream file(filename.c_str(), std::ifstream::in);
-  if (!file.is_open())
-  {
-    std::cout << "Error: Failed to open file " << filename << " for reading!" << std::endl;
-    return false;
-  }
-
   // Extract path. It will be useful later when loading the mtl file
   std::string path = extractPath(filename);
 
   // Create the default material
-  Material defaultMat;
-  defaultMat.Ka[0] = 1.0; defaultMat.Ka[1] = 1.0; defaultMat.Ka[2] = 1.0; defaultMat.Ka[3] = 1.0;
-  defaultMat.Ke[0] = 0.0; defaultMat.Ke[1] = 0.0; defaultMat.Ke[2] = 0.0; defaultMat.Ke[3] = 1.0;
-  defaultMat.Kd[0] = 1.0; defaultMat.Kd[1] = 1.0; defaultMat.Kd[2] = 1.0; defaultMat.Kd[3] = 1.0;
-  defaultMat.Ks[0] = 1.0; defaultMat.Ks[1] = 1.0; defaultMat.Ks[2] = 1.0; defaultMat.Ks[3] = 1.0;
-  defaultMat.Kn = 128;
-  defaultMat.name = "(Default)";
-  _materials.push_back(defaultMat);
-
-
-  std::size_t currentMaterial = 0;
+  _materials.push_back(defaultMaterial());
 
   // Create default mesh (default group)
   Mesh defaultMesh;
   _meshes.push_back(defaultMesh);
 
+  // Read file
+  bool success = false;
+  switch (mode)
+  {
+  case ParseMode::Stream:   success = parseStream(filename, path); break;
+  case ParseMode::Mapped:   success = parseMapped(filename, path); break;
+  case ParseMode::Parallel: success = parseParallel(filename, path); break;
+  }
+  if (!success || isCanceled())
+  {
+    unload();
+    return false;
+  }
+
+  // Generate the normals missing from the file
+  std::size_t numThreads = (_threadCount != 0) ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+  _smoothingGroups.resize(_meshes.size());
+  for (std::size_t m = 0; m < _meshes.size() && !isCanceled(); ++m)
+  {
+    const std::vector<std::uint32_t>& groups = _smoothingGroups[m];
+    const bool complete = groups.size() == _meshes[m].numElements() / 3;
+    OBJLoader::generateNormals(_meshes[m], complete ? groups.data() : nullptr, _creaseAngle, numThreads);
+  }
+  std::vector<std::vector<std::uint32_t>>().swap(_smoothingGroups);
+  if (isCanceled())
+  {
+    unload();
+    return false;
+  }
+
+  // Everything is loaded! Now remove empty meshes (this generally happens with the default group)
+  std::vector<Mesh>::iterator it = _meshes.begin();
+  while (it != _meshes.end())
+  {
+    if ((*it).vertices.size() == 0)
+    {
+      it = _meshes.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  // Bounding volumes, for culling (the later steps keep the positions)
+  for (Mesh& mesh : _meshes)
+  {
+    mesh.bounds = computeBounds(mesh.vertices.data(), mesh.vertices.size());
+    mesh.sphere = computeBoundingSphere(mesh.vertices.data(), mesh.vertices.size(), mesh.bounds);
+  }
+
+  _isLoaded = true;
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the levels of detail of the loaded meshes
+void Loader::generateLods(std::size_t maxLods, float ratio)
+{
+  std::size_t numThreads = (_threadCount != 0) ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+  std::atomic<std::size_t> next(0);
+  runOnThreads(std::min(numThreads, _meshes.size()), [&](std::size_t) {
+    for (std::size_t m = next++; m < _meshes.size() && !isCanceled(); m = next++)
+      OBJLoader::generateLods(_meshes[m], maxLods, ratio);
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split the loaded meshes in clusters
+void Loader::buildClusters(std::size_t maxVertices, std::size_t maxTriangles)
+{
+  std::size_t numThreads = (_threadCount != 0) ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+  std::atomic<std::size_t> next(0);
+  runOnThreads(std::min(numThreads, _meshes.size()), [&](std::size_t) {
+    for (std::size_t m = next++; m < _meshes.size() && !isCanceled(); m = next++)
+      OBJLoader::buildClusters(_meshes[m], maxVertices, maxTriangles);
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Optimize the loaded meshes for the GPU caches
+void Loader::optimizeMeshes(std::vector<MeshOptimizationStats>* stats)
+{
+  if (stats)
+    stats->assign(_meshes.size(), MeshOptimizationStats());
+
+  std::size_t numThreads = (_threadCount != 0) ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+  std::atomic<std::size_t> next(0);
+  runOnThreads(std::min(numThreads, _meshes.size()), [&](std::size_t) {
+    for (std::size_t m = next++; m < _meshes.size() && !isCanceled(); m = next++)
+    {
+      MeshOptimizationStats meshStats = optimizeMesh(_meshes[m]);
+      if (stats)
+        (*stats)[m] = meshStats;
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the OBJ file line by line with string streams
+bool Loader::parseStream(const std::string& filename, const std::string& path)
+{
+  // Open the input file
+  std::ifstream file(filename.c_str(), std::ifstream::in);
+  if (!file.is_open())
+  {
+    std::cout << "Error: Failed to open file " << filename << " for reading!" << std::endl;
+    return false;
+  }
+
+  std::size_t currentMaterial = 0;
   std::size_t currentMesh = 0;
+  std::uint32_t currentSmoothingGroup = DefaultSmoothingGroup;
 
   // Create vertices' position, normal, and uv lists with default values
   std::vector<Point3D> vertices(1);
   std::vector<Point3D> normals(1);
   std::vector<Point2D> uvs(1);
 
+  // Triangle corners of each mesh (indexed output only)
+  std::vector<std::vector<FaceCorner>> meshCorners;
+
   // Read file
   std::string line;
   while (std::getline(file, line))
@@ -171,18 +758,42 @@ bool Loader::loadFile(const std::string& filename)
         std::stringstream ss2(stringVal);
         ss2 >> vertexIDs[index];
 
+        stringVal.clear();
         std::getline(ss, stringVal, '/');
         std::stringstream ss3(stringVal);
         ss3 >> uvIDs[index];
 
+        stringVal.clear();
         std::getline(ss, stringVal, '/');
         std::stringstream ss4(stringVal);
         ss4 >> normalIDs[index];
+
+        // Missing (v or v/vt) or out of range indices use the default values
+        if (vertexIDs[index] >= vertices.size())
+          vertexIDs[index] = 0;
+        if (uvIDs[index] >= uvs.size())
+          uvIDs[index] = 0;
+        if (normalIDs[index] >= normals.size())
+          normalIDs[index] = 0;
       }
 
       // Create first triangle
       if (vertexIDs.size() < 3)
         continue;
+      addSmoothingGroup(currentMesh, currentSmoothingGroup, vertexIDs.size() - 2);
+
+      // Indexed output: keep the corners, the vertices are created at the end
+      if (_indexed)
+      {
+        meshCorners.resize(_meshes.size());
+        for (unsigned int i=2; i<vertexIDs.size(); ++i)
+        {
+          meshCorners[currentMesh].push_back({ vertexIDs[0], uvIDs[0], normalIDs[0] });
+          meshCorners[currentMesh].push_back({ vertexIDs[i-1], uvIDs[i-1], normalIDs[i-1] });
+          meshCorners[currentMesh].push_back({ vertexIDs[i], uvIDs[i], normalIDs[i] });
+        }
+        continue;
+      }
 
       for (unsigned int i=0; i<3; ++i)
       {
@@ -252,46 +863,544 @@ bool Loader::loadFile(const std::string& filename)
       std::stringstream ss(line);
       ss >> dummy >> filename;
 
-      // Add path to filename
-      std::string pathname = path;
-#ifdef Q_OS_WIN32
-      pathname.append("\\");
-#else
-      pathname.append("/");
-#endif
-      pathname.append(filename);
+      // Add path to filename and load file
+      loadMtlFile(joinPath(path, filename));
+    }
+    else if (line[0] == 's' && line[1] == ' ')
+    {
+      // Smoothing group! Get its number
+      std::string dummy;
+      std::string name;
+      std::stringstream ss(line);
+      ss >> dummy >> name;
 
-      // Load file
-      loadMtlFile(pathname);
+      currentSmoothingGroup = parseSmoothingGroup(name);
     }
   }
 
-  // Everything is loaded! Now remove empty meshes (this generally happens with the default group)
-  std::vector<Mesh>::iterator it = _meshes.begin();
-  while (it != _meshes.end())
+  // Close file
+  file.close();
+
+  if (_indexed)
   {
-    if ((*it).vertices.size() == 0)
+    meshCorners.resize(_meshes.size());
+    buildIndexedMeshes(meshCorners, vertices, normals, uvs, _meshes, 1);
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the OBJ file mapped in memory. Lines are tokenized in place and numbers are
+// parsed with std::from_chars, so no memory is allocated per line.
+// Produces the same meshes as parseStream.
+bool Loader::parseMapped(const std::string& filename, const std::string& path)
+{
+  // Map the input file
+  MappedFile file(filename);
+  if (!file.isOpen())
+  {
+    std::cout << "Error: Failed to open file " << filename << " for reading!" << std::endl;
+    return false;
+  }
+
+  struct Handler
+  {
+    Loader& loader;
+    const std::string& path;
+
+    std::size_t currentMaterial = 0;
+    std::size_t currentMesh = 0;
+    std::uint32_t currentSmoothingGroup = DefaultSmoothingGroup;
+
+    // Create vertices' position, normal, and uv lists with default values
+    std::vector<Point3D> vertices = std::vector<Point3D>(1);
+    std::vector<Point3D> normals = std::vector<Point3D>(1);
+    std::vector<Point2D> uvs = std::vector<Point2D>(1);
+
+    // Triangle corners of each mesh (indexed output only)
+    std::vector<std::vector<FaceCorner>> meshCorners = {};
+
+    void position(const Point3D& v) { vertices.push_back(v); }
+    void normal(const Point3D& n) { normals.push_back(n); }
+    void uv(const Point2D& uv) { uvs.push_back(uv); }
+
+    void useMaterial(std::string_view name)
     {
-      it = _meshes.erase(it);
+      // Find it, and attach it to the current mesh
+      currentMaterial = loader.findMaterial(name);
+      loader._meshes[currentMesh].materialID = currentMaterial;
     }
-    else
+
+    void group(std::string_view name)
     {
-      ++it;
+      // Set it as the current mesh
+      currentMesh = loader.getMesh(name);
+      loader._meshes[currentMesh].materialID = currentMaterial;
+    }
+
+    void smoothingGroup(std::string_view name)
+    {
+      currentSmoothingGroup = parseSmoothingGroup(name);
+    }
+
+    void face(const std::vector<RawCorner>& corners)
+    {
+      loader.addSmoothingGroup(currentMesh, currentSmoothingGroup, corners.size() - 2);
+
+      // Triangulate the face with a fan around its first vertex
+      FaceCorner first = resolveCorner(corners[0], vertices.size(), uvs.size(), normals.size());
+      FaceCorner previous = resolveCorner(corners[1], vertices.size(), uvs.size(), normals.size());
+      if (loader._indexed)
+      {
+        // Keep the corners, the vertices are created at the end
+        meshCorners.resize(loader._meshes.size());
+        std::vector<FaceCorner>& c = meshCorners[currentMesh];
+        for (std::size_t i = 2; i < corners.size(); ++i)
+        {
+          FaceCorner current = resolveCorner(corners[i], vertices.size(), uvs.size(), normals.size());
+          c.push_back(first);
+          c.push_back(previous);
+          c.push_back(current);
+          previous = current;
+        }
+        return;
+      }
+
+      std::vector<Vertex>& meshVertices = loader._meshes[currentMesh].vertices;
+      for (std::size_t i = 2; i < corners.size(); ++i)
+      {
+        FaceCorner current = resolveCorner(corners[i], vertices.size(), uvs.size(), normals.size());
+        meshVertices.push_back(makeVertex(first, vertices.data(), normals.data(), uvs.data()));
+        meshVertices.push_back(makeVertex(previous, vertices.data(), normals.data(), uvs.data()));
+        meshVertices.push_back(makeVertex(current, vertices.data(), normals.data(), uvs.data()));
+        previous = current;
+      }
+    }
+
+    void materialLibrary(std::string_view filename)
+    {
+      // Add path to filename and load file
+      loader.loadMtlFile(joinPath(path, filename));
     }
+  };
+
+  Handler handler{ *this, path };
+  parseLines(file.begin(), file.end(), handler, _bytesRead, _cancel);
+
+  if (_indexed)
+  {
+    handler.meshCorners.resize(_meshes.size());
+    buildIndexedMeshes(handler.meshCorners, handler.vertices, handler.normals, handler.uvs, _meshes, 1);
   }
 
+  return true;
+}
 
-  // Close file
-  file.close();
-  _isLoaded = true;
+//--------------------------------------------------------------------------------------------------
+// Read the OBJ file mapped in memory with several threads. Produces the same meshes as parseMapped.
+//  1. The file is split in newline aligned chunks. Each thread parses one chunk and keeps its
+//     positions, normals and uvs, its faces (with the unresolved indices) and its g/usemtl/mtllib
+//     statements.
+//  2. The statements are replayed in file order on the calling thread: it assigns each run of
+//     faces to a mesh and reserves its place in the mesh vertices. This keeps the group and
+//     material handling deterministic.
+//  3. Each thread resolves the indices of its faces and writes the triangles at their place.
+bool Loader::parseParallel(const std::string& filename, const std::string& path)
+{
+  // Map the input file
+  MappedFile file(filename);
+  if (!file.isOpen())
+  {
+    std::cout << "Error: Failed to open file " << filename << " for reading!" << std::endl;
+    return false;
+  }
+
+  // Avoid tiny chunks: below this size, the threads cost more than they save
+  const std::size_t minChunkSize = 1 << 20;
+  std::size_t numChunks = (_threadCount != 0) ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+  numChunks = std::max<std::size_t>(1, std::min(numChunks, file.size() / minChunkSize));
+
+  // Split the file at line boundaries
+  std::vector<const char*> bounds(numChunks + 1, file.end());
+  bounds[0] = file.begin();
+  for (std::size_t c = 1; c < numChunks; ++c)
+  {
+    const char* p = std::max(bounds[c-1], file.begin() + file.size() / numChunks * c);
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', file.end() - p));
+    bounds[c] = (eol == nullptr) ? file.end() : eol + 1;
+  }
+
+  // Data gathered on one chunk
+  struct Statement
+  {
+    enum Type { UseMaterial, Group, MaterialLibrary, SmoothingGroup } type;
+    std::size_t face;      // Number of faces of the chunk before the statement
+    std::string_view name; // Points in the mapped file
+  };
+  struct Face
+  {
+    std::size_t firstCorner; // First corner in Chunk::corners
+    std::size_t firstOutput; // Number of mesh vertices created by the previous faces of the chunk
+    std::size_t numVertices, numUVs, numNormals; // Size of the chunk lists when the face is read
+  };
+  struct Chunk
+  {
+    std::vector<Point3D> vertices;
+    std::vector<Point3D> normals;
+    std::vector<Point2D> uvs;
+    std::vector<RawCorner> corners;
+    std::vector<Face> faces;
+    std::vector<Statement> statements;
+    std::size_t numOutput = 0;
+
+    void position(const Point3D& v) { vertices.push_back(v); }
+    void normal(const Point3D& n) { normals.push_back(n); }
+    void uv(const Point2D& uv) { uvs.push_back(uv); }
+    void useMaterial(std::string_view name) { statements.push_back({ Statement::UseMaterial, faces.size(), name }); }
+    void group(std::string_view name) { statements.push_back({ Statement::Group, faces.size(), name }); }
+    void materialLibrary(std::string_view name) { statements.push_back({ Statement::MaterialLibrary, faces.size(), name }); }
+    void smoothingGroup(std::string_view name) { statements.push_back({ Statement::SmoothingGroup, faces.size(), name }); }
+    void face(const std::vector<RawCorner>& c)
+    {
+      faces.push_back({ corners.size(), numOutput, vertices.size(), uvs.size(), normals.size() });
+      corners.insert(corners.end(), c.begin(), c.end());
+      numOutput += triangulatedSize(c.size());
+    }
+  };
+
+  // 1. Parse the chunks
+  std::vector<Chunk> chunks(numChunks);
+  runOnThreads(numChunks, [&](std::size_t c) {
+    parseLines(bounds[c], bounds[c+1], chunks[c], _bytesRead, _cancel);
+  });
+
+  // Merge the position, normal, and uv lists (with default values first)
+  // and remember where each chunk starts in them
+  std::vector<std::size_t> vertexBase(numChunks), uvBase(numChunks), normalBase(numChunks);
+  std::vector<Point3D> vertices(1);
+  std::vector<Point3D> normals(1);
+  std::vector<Point2D> uvs(1);
+  for (std::size_t c = 0; c < numChunks; ++c)
+  {
+    vertexBase[c] = vertices.size();
+    uvBase[c] = uvs.size();
+    normalBase[c] = normals.size();
+    vertices.insert(vertices.end(), chunks[c].vertices.begin(), chunks[c].vertices.end());
+    normals.insert(normals.end(), chunks[c].normals.begin(), chunks[c].normals.end());
+    uvs.insert(uvs.end(), chunks[c].uvs.begin(), chunks[c].uvs.end());
+    std::vector<Point3D>().swap(chunks[c].vertices);
+    std::vector<Point3D>().swap(chunks[c].normals);
+    std::vector<Point2D>().swap(chunks[c].uvs);
+  }
+
+  // 2. Replay the statements in order. Each run of faces between two statements
+  // goes to the current mesh, at the current end of its vertices.
+  struct FaceRun
+  {
+    std::size_t firstFace, lastFace; // Faces [firstFace, lastFace) of the chunk
+    std::size_t mesh;
+    std::size_t output;              // Position of the first vertex in the mesh
+    std::uint32_t smoothingGroup;
+  };
+  std::vector<std::vector<FaceRun>> runs(numChunks);
+  std::vector<std::size_t> meshSizes(_meshes.size(), 0);
+  std::size_t currentMaterial = 0;
+  std::size_t currentMesh = 0;
+  std::uint32_t currentSmoothingGroup = DefaultSmoothingGroup;
+  for (std::size_t c = 0; c < numChunks; ++c)
+  {
+    const Chunk& chunk = chunks[c];
+    std::size_t face = 0;
+    for (std::size_t s = 0; s <= chunk.statements.size(); ++s)
+    {
+      // Faces before this statement (or until the end of the chunk)
+      std::size_t lastFace = (s < chunk.statements.size()) ? chunk.statements[s].face : chunk.faces.size();
+      if (lastFace > face)
+      {
+        std::size_t lastOutput = (lastFace < chunk.faces.size()) ? chunk.faces[lastFace].firstOutput : chunk.numOutput;
+        runs[c].push_back({ face, lastFace, currentMesh, meshSizes[currentMesh], currentSmoothingGroup });
+        meshSizes[currentMesh] += lastOutput - chunk.faces[face].firstOutput;
+        face = lastFace;
+      }
+      if (s == chunk.statements.size())
+        break;
+
+      const Statement& statement = chunk.statements[s];
+      switch (statement.type)
+      {
+      case Statement::UseMaterial:
+        // Find it, and attach it to the current mesh
+        currentMaterial = findMaterial(statement.name);
+        _meshes[currentMesh].materialID = currentMaterial;
+        break;
+      case Statement::Group:
+        // Set it as the current mesh
+        currentMesh = getMesh(statement.name);
+        _meshes[currentMesh].materialID = currentMaterial;
+        meshSizes.resize(_meshes.size(), 0);
+        break;
+      case Statement::MaterialLibrary:
+        // Add path to filename and load file
+        loadMtlFile(joinPath(path, statement.name));
+        break;
+      case Statement::SmoothingGroup:
+        currentSmoothingGroup = parseSmoothingGroup(statement.name);
+        break;
+      }
+    }
+  }
+
+  // Reserve the triangles (or their corners for indexed output) and their smoothing groups
+  std::vector<std::vector<FaceCorner>> meshCorners(_indexed ? _meshes.size() : 0);
+  _smoothingGroups.resize(_meshes.size());
+  for (std::size_t m = 0; m < _meshes.size(); ++m)
+  {
+    _smoothingGroups[m].resize(meshSizes[m] / 3);
+    if (_indexed)
+      meshCorners[m].resize(meshSizes[m]);
+    else
+      _meshes[m].vertices.resize(meshSizes[m]);
+  }
+
+  // 3. Create the triangles of each chunk
+  runOnThreads(numChunks, [&](std::size_t c) {
+    const Chunk& chunk = chunks[c];
+    for (const FaceRun& run : runs[c])
+    {
+      Vertex* out = _indexed ? nullptr : _meshes[run.mesh].vertices.data() + run.output;
+      FaceCorner* outCorners = _indexed ? meshCorners[run.mesh].data() + run.output : nullptr;
+      std::uint32_t* outGroups = _smoothingGroups[run.mesh].data() + run.output / 3;
+      for (std::size_t f = run.firstFace; f < run.lastFace; ++f)
+      {
+        const Face& face = chunk.faces[f];
+        const std::size_t lastCorner = (f + 1 < chunk.faces.size()) ? chunk.faces[f+1].firstCorner : chunk.corners.size();
+        // Size of the lists when this face was read in a sequential parse
+        const std::size_t numVertices = vertexBase[c] + face.numVertices;
+        const std::size_t numUVs = uvBase[c] + face.numUVs;
+        const std::size_t numNormals = normalBase[c] + face.numNormals;
+
+        // Triangulate the face with a fan around its first vertex
+        const RawCorner* corners = chunk.corners.data() + face.firstCorner;
+        FaceCorner first = resolveCorner(corners[0], numVertices, numUVs, numNormals);
+        FaceCorner previous = resolveCorner(corners[1], numVertices, numUVs, numNormals);
+        for (std::size_t i = 2; i < lastCorner - face.firstCorner; ++i)
+        {
+          FaceCorner current = resolveCorner(corners[i], numVertices, numUVs, numNormals);
+          *outGroups++ = run.smoothingGroup;
+          if (_indexed)
+          {
+            *outCorners++ = first;
+            *outCorners++ = previous;
+            *outCorners++ = current;
+          }
+          else
+          {
+            *out++ = makeVertex(first, vertices.data(), normals.data(), uvs.data());
+            *out++ = makeVertex(previous, vertices.data(), normals.data(), uvs.data());
+            *out++ = makeVertex(current, vertices.data(), normals.data(), uvs.data());
+          }
+          previous = current;
+        }
+      }
+    }
+  });
+
+  // 4. Create the vertices of the indexed meshes (one mesh per thread)
+  if (_indexed)
+    buildIndexedMeshes(meshCorners, vertices, normals, uvs, _meshes, numChunks);
 
   return true;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Read the OBJ file mapped in memory and deliver its triangles by batches
+bool Loader::streamFile(const std::string& filename, const BatchCallback& callback,
+                        std::size_t batchTriangles, std::size_t memoryCap)
+{
+  // Clear current data
+  unload();
+
+  // Map the input file
+  MappedFile file(filename);
+  if (!file.isOpen())
+  {
+    std::cout << "Error: Failed to open file " << filename << " for reading!" << std::endl;
+    return false;
+  }
+
+  // Extract path. It will be useful later when loading the mtl file
+  std::string path = extractPath(filename);
+  _materials.push_back(defaultMaterial());
+
+  // Batches must fit in the memory cap
+  const std::size_t triangleSize = 3 * sizeof(Vertex);
+  if (memoryCap != 0)
+    batchTriangles = std::min(batchTriangles, memoryCap / triangleSize);
+  batchTriangles = std::max<std::size_t>(batchTriangles, 1);
+
+  struct Handler
+  {
+    Loader& loader;
+    const std::string& path;
+    const BatchCallback& callback;
+    const std::size_t batchVertices;
+    const std::size_t memoryCap;
+
+    // Groups seen so far (the default group has an empty name)
+    std::vector<std::string> groups = std::vector<std::string>(1);
+
+    // Triangles waiting to be delivered, one buffer per (group, material)
+    struct Pending
+    {
+      std::size_t group;
+      std::size_t material;
+      std::vector<Vertex> vertices;
+    };
+    std::vector<Pending> pendings = {};
+    std::size_t pendingBytes = 0; // Memory reserved by the pending buffers
+    std::size_t current = std::size_t(-1);
+    bool stopped = false;
+
+    std::size_t currentGroup = 0;
+    std::size_t currentMaterial = 0;
+
+    // Create vertices' position, normal, and uv lists with default values
+    std::vector<Point3D> vertices = std::vector<Point3D>(1);
+    std::vector<Point3D> normals = std::vector<Point3D>(1);
+    std::vector<Point2D> uvs = std::vector<Point2D>(1);
+
+    // Deliver the triangles of a pending buffer
+    void flush(Pending& p)
+    {
+      if (p.vertices.empty())
+        return;
+      if (!stopped)
+      {
+        TriangleBatch batch;
+        batch.vertices = p.vertices.data();
+        batch.numTriangles = p.vertices.size() / 3;
+        batch.groupID = p.group;
+        batch.groupName = groups[p.group];
+        batch.materialID = p.material;
+        stopped = !callback(batch);
+      }
+      p.vertices.clear();
+    }
+
+    // Deliver and free the largest pending buffer (other than the current one)
+    bool releaseLargest()
+    {
+      std::size_t largest = std::size_t(-1);
+      for (std::size_t i = 0; i < pendings.size(); ++i)
+      {
+        if (i != current && pendings[i].vertices.capacity() != 0 &&
+            (largest == std::size_t(-1) || pendings[i].vertices.size() > pendings[largest].vertices.size()))
+          largest = i;
+      }
+      if (largest == std::size_t(-1))
+        return false;
+
+      flush(pendings[largest]);
+      pendingBytes -= pendings[largest].vertices.capacity() * sizeof(Vertex);
+      std::vector<Vertex>().swap(pendings[largest].vertices);
+      return true;
+    }
+
+    // Pending buffer of the current group and material
+    Pending& currentPending()
+    {
+      if (current == std::size_t(-1))
+      {
+        for (std::size_t i = 0; i < pendings.size() && current == std::size_t(-1); ++i)
+        {
+          if (pendings[i].group == currentGroup && pendings[i].material == currentMaterial)
+            current = i;
+        }
+        if (current == std::size_t(-1))
+        {
+          current = pendings.size();
+          pendings.push_back({ currentGroup, currentMaterial, std::vector<Vertex>() });
+        }
+      }
+
+      // Allocate a full batch at once, after making room for it
+      Pending& p = pendings[current];
+      if (p.vertices.capacity() == 0)
+      {
+        const std::size_t bytes = batchVertices * sizeof(Vertex);
+        while (memoryCap != 0 && pendingBytes + bytes > memoryCap && releaseLargest())
+          ;
+        p.vertices.reserve(batchVertices);
+        pendingBytes += p.vertices.capacity() * sizeof(Vertex);
+      }
+      return p;
+    }
+
+    void position(const Point3D& v) { vertices.push_back(v); }
+    void normal(const Point3D& n) { normals.push_back(n); }
+    void uv(const Point2D& uv) { uvs.push_back(uv); }
+
+    void useMaterial(std::string_view name)
+    {
+      currentMaterial = loader.findMaterial(name);
+      current = std::size_t(-1);
+    }
+
+    void group(std::string_view name)
+    {
+      std::size_t id = std::find(groups.begin(), groups.end(), name) - groups.begin();
+      if (id == groups.size())
+        groups.push_back(std::string(name));
+      currentGroup = id;
+      current = std::size_t(-1);
+    }
+
+    // The normals are not generated: the triangles are delivered before their neighbors are known
+    void smoothingGroup(std::string_view) {}
+
+    void face(const std::vector<RawCorner>& corners)
+    {
+      // Triangulate the face with a fan around its first vertex
+      FaceCorner first = resolveCorner(corners[0], vertices.size(), uvs.size(), normals.size());
+      FaceCorner previous = resolveCorner(corners[1], vertices.size(), uvs.size(), normals.size());
+      for (std::size_t i = 2; i < corners.size(); ++i)
+      {
+        FaceCorner corner = resolveCorner(corners[i], vertices.size(), uvs.size(), normals.size());
+        Pending& p = currentPending();
+        p.vertices.push_back(makeVertex(first, vertices.data(), normals.data(), uvs.data()));
+        p.vertices.push_back(makeVertex(previous, vertices.data(), normals.data(), uvs.data()));
+        p.vertices.push_back(makeVertex(corner, vertices.data(), normals.data(), uvs.data()));
+        if (p.vertices.size() >= batchVertices)
+          flush(p);
+        previous = corner;
+      }
+    }
+
+    void materialLibrary(std::string_view filename)
+    {
+      loader.loadMtlFile(joinPath(path, filename));
+    }
+  };
+
+  Handler handler{ *this, path, callback, 3 * batchTriangles, memoryCap };
+  parseLines(file.begin(), file.end(), handler, _bytesRead, _cancel);
+  if (isCanceled())
+    return false;
+
+  // Deliver the remaining triangles (in order of first appearance)
+  for (Handler::Pending& p : handler.pendings)
+    handler.flush(p);
+
+  return !handler.stopped;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Load material file
 void Loader::loadMtlFile(const std::string& filename)
 {
+  _materialLibraries.push_back(filename);
+
   // Open the input file
   std::ifstream file(filename.c_str(), std::ifstream::in);
   if (!file.is_open())
@@ -383,7 +1492,7 @@ void Loader::loadMtlFile(const std::string& filename)
 
 //--------------------------------------------------------------------------------------------------
 // Find a material by its name
-std::size_t Loader::findMaterial(const std::string& name)
+std::size_t Loader::findMaterial(std::string_view name)
 {
   std::size_t id = 0;
   for (std::size_t i=0; i<_materials.size(); ++i)
@@ -401,7 +1510,7 @@ std::size_t Loader::findMaterial(const std::string& name)
 
 //--------------------------------------------------------------------------------------------------
 // Find a mesh by its name
-std::size_t Loader::getMesh(const std::string& name)
+std::size_t Loader::getMesh(std::string_view name)
 {
   std::size_t id = 0;
   bool found = false;
@@ -418,7 +1527,7 @@ std::size_t Loader::getMesh(const std::string& name)
   if (!found)
   {
     Mesh newMesh;
-    newMesh.name = name;
+    newMesh.name = std::string(name);
 
     id = _meshes.size();
     _meshes.push_back(newMesh);
@@ -427,6 +1536,14 @@ std::size_t Loader::getMesh(const std::string& name)
   return id;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Record the smoothing group of the next triangles of a mesh
+void Loader::addSmoothingGroup(std::size_t mesh, std::uint32_t group, std::size_t numTriangles)
+{
+  _smoothingGroups.resize(_meshes.size());
+  _smoothingGroups[mesh].insert(_smoothingGroups[mesh].end(), numTriangles, group);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Clear data
 void Loader::unload()
@@ -434,5 +1551,7 @@ void Loader::unload()
   // Clear everything!
   _meshes.clear();
   _materials.clear();
+  _materialLibraries.clear();
+  std::vector<std::vector<std::uint32_t>>().swap(_smoothingGroups);
   _isLoaded = false;
 }
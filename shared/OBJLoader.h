@@ -1,8 +1,12 @@
 #ifndef OBJLOADER_H
 #define OBJLOADER_H
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace OBJLoader
 {
@@ -26,41 +30,184 @@ namespace OBJLoader
     float uv[2];
   };
 
+  // Axis aligned bounding box
+  struct Bounds
+  {
+    float min[3];
+    float max[3];
+  };
+
+  // Bounds of a list of vertices (empty list: min > max)
+  Bounds computeBounds(const Vertex* vertices, std::size_t count);
+
+  // Bounding sphere, for frustum culling (see Camera::cullSpheres)
+  struct BoundingSphere
+  {
+    float center[3];
+    float radius;
+  };
+
+  // Sphere centered on bounds enclosing a list of vertices (empty list: radius 0)
+  BoundingSphere computeBoundingSphere(const Vertex* vertices, std::size_t count, const Bounds& bounds);
+
+  // Simplified version of a mesh, drawn with the vertices of the mesh (see generateLods)
+  struct MeshLod
+  {
+    std::vector<std::uint32_t> indices;
+    float error; // Estimated distance to the original surface, in object space
+  };
+
+  // Cluster of neighbor triangles of a mesh, with its culling data (see buildClusters).
+  // Same layout as struct { vec4 sphere; vec4 cone; uvec4 range; } in a std430 GLSL buffer.
+  struct MeshCluster
+  {
+    float center[3];  // Bounding sphere
+    float radius;
+    float coneAxis[3]; // Normal cone: all the triangles face away from a viewpoint p when
+    float coneCutoff;  // dot(center - p, coneAxis) >= coneCutoff * (|center - p| + radius) + radius
+                       // (coneCutoff = 1: never)
+    std::uint32_t firstIndex; // Triangles: indices[firstIndex, firstIndex + numIndices)
+    std::uint32_t numIndices;
+    std::uint32_t padding[2];
+  };
+
   // Structure used to store a mesh data.
-  // Each triplet of vertices forms a triangle.
+  // Without indices, each triplet of vertices forms a triangle.
+  // With indices (see Loader::setIndexed), each triplet of indices forms a triangle.
   struct Mesh
   {
-    Mesh() : materialID(0), name("") {}
+    Mesh() : bounds(), sphere(), materialID(0), name("") {}
+
+    bool isIndexed() const { return !indices.empty(); }
+    // Number of vertices to draw (glDrawArrays or glDrawElements count)
+    std::size_t numElements() const { return isIndexed() ? indices.size() : vertices.size(); }
+    // Smallest index size (2 or 4 bytes) able to address all the vertices
+    std::size_t indexSize() const { return vertices.size() <= 0x10000 ? 2 : 4; }
+    // Indices stored on indexSize() bytes each, ready to be copied in an element buffer.
+    // The indices of the levels of detail follow, in order.
+    std::vector<std::uint8_t> packedIndices() const;
+    // Number of indices, levels of detail included
+    std::size_t totalIndices() const;
 
     std::vector<Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<MeshLod> lods; // Levels of detail, coarser and coarser (indexed meshes only)
+    std::vector<MeshCluster> clusters; // Partition of the indices for culling (indexed meshes only)
+    Bounds         bounds; // Of the vertices, computed when loading
+    BoundingSphere sphere;
     std::size_t  materialID;
     std::string   name;
   };
 
+  // Batch of triangles delivered by Loader::streamFile.
+  // The vertices are only valid during the callback.
+  struct TriangleBatch
+  {
+    const Vertex*    vertices;     // Each triplet of vertices forms a triangle
+    std::size_t      numTriangles;
+    std::size_t      groupID;      // Groups are numbered in order of appearance (0: default group)
+    std::string_view groupName;
+    std::size_t      materialID;   // Index in Loader::getMaterials()
+  };
+
+  // Called for each batch, return false to stop the loading
+  using BatchCallback = std::function<bool(const TriangleBatch&)>;
+
+  // ACMR/ATVR of an optimized mesh (see MeshOptimizer.h)
+  struct MeshOptimizationStats;
+
+  // Parser used to read the OBJ file
+  enum class ParseMode
+  {
+    Stream, // Line by line with std::getline and std::stringstream (reference parser)
+    Mapped,  // File mapped in memory and tokenized in place, without per-line allocation
+    Parallel // Same as Mapped, but the file is split in chunks parsed by several threads
+  };
+
   // Class responsible for loading all the meshes included in an OBJ file
   class Loader
   {
   public:
     Loader();
-    Loader(const std::string& filename);
+    Loader(const std::string& filename, ParseMode mode = ParseMode::Mapped);
     ~Loader();
 
-    bool loadFile(const std::string& filename);
+    bool loadFile(const std::string& filename, ParseMode mode = ParseMode::Mapped);
+
+    // Read the file without keeping its meshes: the triangles are delivered by batches of
+    // at most batchTriangles triangles sharing the same group and material.
+    // memoryCap (in bytes, 0: none) bounds the triangles waiting to be delivered: when it is
+    // reached, the largest pending batch is delivered early. Only the positions, normals and
+    // uvs of the file are kept until the end. getMaterials() is valid during the callbacks.
+    // Missing normals are not generated (left to zero).
+    bool streamFile(const std::string& filename, const BatchCallback& callback,
+                    std::size_t batchTriangles = 65536, std::size_t memoryCap = 0);
     bool isLoaded() const { return _isLoaded; }
     void unload();
 
     const std::vector<Mesh>& getMeshes() const { return _meshes; }
     const std::vector<Material>& getMaterials() const { return _materials; }
+    // Material files (mtllib statements) read by the last load, found or not
+    const std::vector<std::string>& getMaterialLibraries() const { return _materialLibraries; }
+
+    // Produce indexed meshes: each unique (position, uv, normal) triplet of the file
+    // becomes one vertex, referenced by Mesh::indices. Disabled by default.
+    void setIndexed(bool indexed) { _indexed = indexed; }
+    bool indexed() const { return _indexed; }
+
+    // Normals missing from the file are generated when loading (see generateNormals in
+    // NormalGenerator.h), smoothed across the edges of the same smoothing group (s statement)
+    // where the faces make an angle smaller than the crease angle (in degrees, 60 by default)
+    void setCreaseAngle(float degrees) { _creaseAngle = degrees; }
+    float creaseAngle() const { return _creaseAngle; }
+
+    // Number of threads used by ParseMode::Parallel and the normal generation (0: one per hardware thread)
+    void setThreadCount(unsigned int count) { _threadCount = count; }
+    unsigned int threadCount() const { return _threadCount; }
+
+    // Reorder the triangles and vertices of the loaded indexed meshes for the GPU vertex
+    // cache, overdraw and vertex fetches (see optimizeMesh), several meshes at the same time.
+    // The vertex cache statistics of each mesh are stored in stats (if not nullptr).
+    void optimizeMeshes(std::vector<MeshOptimizationStats>* stats = nullptr);
+
+    // Build the levels of detail of the loaded indexed meshes (see generateLods in
+    // MeshSimplifier.h), several meshes at the same time. Call it before optimizeMeshes.
+    void generateLods(std::size_t maxLods = 4, float ratio = 0.5f);
+
+    // Split the loaded indexed meshes in clusters (see buildClusters in MeshClusters.h),
+    // several meshes at the same time. Call it after optimizeMeshes.
+    void buildClusters(std::size_t maxVertices = 64, std::size_t maxTriangles = 124);
+
+    // Counter increased with the number of bytes parsed (Mapped and Parallel modes, streamFile),
+    // so another thread can follow the loading progress. nullptr to disable.
+    void setProgressCounter(std::atomic<std::size_t>* bytesRead) { _bytesRead = bytesRead; }
+
+    // Flag set by another thread to abandon the loading: checked every ProgressStep bytes
+    // parsed (Mapped and Parallel modes) and between the meshes of the other steps, which
+    // then stop early (loadFile and streamFile fail). nullptr to disable.
+    void setCancelFlag(const std::atomic<bool>* cancel) { _cancel = cancel; }
+    bool isCanceled() const { return _cancel != nullptr && _cancel->load(std::memory_order_relaxed); }
 
   private:
+    bool parseStream(const std::string& filename, const std::string& path);
+    bool parseMapped(const std::string& filename, const std::string& path);
+    bool parseParallel(const std::string& filename, const std::string& path);
     void loadMtlFile(const std::string& filename);
-    std::size_t findMaterial(const std::string& name);
-    std::size_t getMesh(const std::string& name);
+    std::size_t findMaterial(std::string_view name);
+    std::size_t getMesh(std::string_view name);
+    void addSmoothingGroup(std::size_t mesh, std::uint32_t group, std::size_t numTriangles);
 
     std::vector<Mesh>     _meshes;
     std::vector<Material> _materials;
+    std::vector<std::string> _materialLibraries;
+    std::vector<std::vector<std::uint32_t>> _smoothingGroups; // Per triangle, while loading
 
     bool                  _isLoaded;
+    unsigned int          _threadCount;
+    bool                  _indexed;
+    float                 _creaseAngle;
+    std::atomic<std::size_t>* _bytesRead;
+    const std::atomic<bool>* _cancel;
   };
 }
 
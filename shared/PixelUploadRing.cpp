@@ -0,0 +1,135 @@
+#include "PixelUploadRing.h"
+#include "CacheFile.h"
+
+#include <iostream>
+
+bool PixelUploadRing::create(std::size_t size)
+{
+    destroy();
+
+    // Written by the CPU only, visible to the commands issued after the writes without any flush
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_size = CacheFile::alignUp(size, Alignment);
+    glCreateBuffers(1, &m_buffer);
+    glNamedBufferStorage(m_buffer, GLsizeiptr(m_size), nullptr, flags);
+    m_mapped = static_cast<char*>(glMapNamedBufferRange(m_buffer, 0, GLsizeiptr(m_size), flags));
+    if (m_mapped == nullptr) {
+        std::cerr << "Unable to map the pixel upload ring" << std::endl;
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+void PixelUploadRing::destroy()
+{
+    if (m_buffer == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Region& region : m_regions) {
+        if (region.fence != nullptr)
+            glDeleteSync(region.fence);
+    }
+    m_regions.clear();
+    glUnmapNamedBuffer(m_buffer);
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+    m_mapped = nullptr;
+    m_size = 0;
+    m_head = 0;
+    m_used = 0;
+}
+
+bool PixelUploadRing::allocate(std::size_t size, std::size_t& offset)
+{
+    size = CacheFile::alignUp(size, Alignment);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_buffer == 0 || size == 0 || size > m_size)
+        return false;
+    if (m_regions.empty())
+        m_head = 0;
+
+    // The regions in use go from tail to head (the ring is full when they meet)
+    const std::size_t tail = m_regions.empty() ? 0 : m_regions.front().offset;
+    if (!m_regions.empty() && m_head == tail)
+        return false;
+
+    if (m_regions.empty() || m_head > tail) {
+        if (m_size - m_head >= size) {
+            offset = m_head;
+        }
+        else if (tail >= size) {
+            // Wrap around: the end of the ring goes with the last region
+            m_used += m_size - m_head;
+            m_regions.back().end = m_size;
+            offset = 0;
+        }
+        else {
+            return false;
+        }
+    }
+    else if (tail - m_head >= size) {
+        offset = m_head;
+    }
+    else {
+        return false;
+    }
+
+    m_regions.push_back({ offset, offset + size });
+    m_head = (offset + size) % m_size;
+    m_used += size;
+    return true;
+}
+
+PixelUploadRing::Region* PixelUploadRing::find(std::size_t offset)
+{
+    for (Region& region : m_regions) {
+        if (region.offset == offset)
+            return &region;
+    }
+    return nullptr;
+}
+
+void PixelUploadRing::retire(std::size_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (Region* region = find(offset))
+        region->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void PixelUploadRing::discard(std::size_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (Region* region = find(offset))
+        region->done = true;
+}
+
+void PixelUploadRing::reclaim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_regions.empty()) {
+        Region& region = m_regions.front();
+        if (region.fence != nullptr) {
+            // Poll, without waiting
+            const GLenum status = glClientWaitSync(region.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(region.fence);
+        }
+        else if (!region.done) {
+            break; // Still filled, or waiting for its copies
+        }
+        m_used -= region.end - region.offset;
+        m_regions.pop_front();
+    }
+}
+
+std::size_t PixelUploadRing::used() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Ring of staging memory for the texture uploads: a pixel unpack buffer mapped
+// once for all (glNamedBufferStorage with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT).
+//
+// - Any thread reserves a region with allocate() and fills it through data()
+//   (the copy from the decoded image happens on the worker threads).
+// - The rendering thread issues the copies to the textures with the buffer bound
+//   to GL_PIXEL_UNPACK_BUFFER (the "pixels" of glTextureSubImage2D are then an
+//   offset), then calls retire(): a fence is inserted after the copies.
+// - reclaim() frees, in allocation order, the regions whose fence is signaled.
+//   The driver copies in the background and never waits for the CPU.
+class PixelUploadRing
+{
+public:
+    static const std::size_t DefaultSize = 32 << 20;
+    // Offsets of the regions (and of the levels in the regions)
+    static const std::size_t Alignment = 64;
+
+    PixelUploadRing() = default;
+    // The buffer is not deleted here, see destroy()
+    ~PixelUploadRing() = default;
+
+    PixelUploadRing(const PixelUploadRing&) = delete;
+    PixelUploadRing& operator=(const PixelUploadRing&) = delete;
+
+    // ------------------------------------------------------------------------
+    // create and map the buffer (rendering thread)
+    bool create(std::size_t size = DefaultSize);
+    // ------------------------------------------------------------------------
+    // unmap and delete the buffer, no region must be in use (rendering thread)
+    void destroy();
+    bool isCreated() const { return m_buffer != 0; }
+
+    // ------------------------------------------------------------------------
+    // reserve size bytes (any thread)
+    // return false if the ring has no room for them now (or never: larger than the ring)
+    bool allocate(std::size_t size, std::size_t& offset);
+    // Mapped memory of the buffer, written through a region reserved by allocate
+    char* data(std::size_t offset) const { return m_mapped + offset; }
+
+    // ------------------------------------------------------------------------
+    // the copies from the region at offset are issued (rendering thread)
+    void retire(std::size_t offset);
+    // ------------------------------------------------------------------------
+    // the region at offset is not used (rendering thread)
+    void discard(std::size_t offset);
+    // ------------------------------------------------------------------------
+    // free the regions whose copies are complete (rendering thread)
+    void reclaim();
+
+    GLuint buffer() const { return m_buffer; }
+    std::size_t size() const { return m_size; }
+    // Bytes reserved and not reclaimed yet
+    std::size_t used() const;
+
+private:
+    struct Region
+    {
+        std::size_t offset;
+        std::size_t end;         // Where the next region starts (the wasted end of the ring included)
+        GLsync fence = nullptr;  // Inserted by retire()
+        bool done = false;       // Discarded: free without waiting
+    };
+
+    Region* find(std::size_t offset);
+
+private:
+    GLuint m_buffer = 0;
+    char* m_mapped = nullptr;
+    std::size_t m_size = 0;
+
+    mutable std::mutex m_mutex;
+    std::deque<Region> m_regions; // Allocation order
+    std::size_t m_head = 0;       // Next allocation
+    std::size_t m_used = 0;
+};
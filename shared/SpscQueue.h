@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for one producer thread and one consumer thread.
+// push() is only called by the producer and pop() only by the consumer.
+// Everything written by the producer before a push() is visible to the
+// consumer after the matching pop().
+template<typename T>
+class SpscQueue
+{
+public:
+    // The capacity is rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity = 1024)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    // Add a value, return false if the queue is full (producer only)
+    bool push(const T& value)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_buffer[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Remove the oldest value, return false if the queue is empty (consumer only)
+    bool pop(T& value)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        value = m_buffer[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> m_buffer;
+    std::size_t m_mask;
+    // Separate cache lines: the producer writes m_tail, the consumer writes m_head
+    alignas(64) std::atomic<std::size_t> m_head{ 0 };
+    alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+};
@@ -0,0 +1,240 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "TextureLoader.h"
+
+#include <stb_image.h>
+#include <stb_image_resize.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+namespace
+{
+    int roundUp(int value, int multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+}
+
+TextureAtlas::TextureAtlas(int padding) :
+    m_padding(1)
+{
+    while (m_padding < padding)
+        m_padding *= 2;
+}
+
+int TextureAtlas::add(const unsigned char* pixels, int width, int height, const glm::vec4& tint, int maxSize)
+{
+    Sprite sprite;
+    sprite.width = width;
+    sprite.height = height;
+    sprite.maxSize = maxSize;
+    sprite.pixels.assign(pixels, pixels + std::size_t(width) * height * 4);
+    if (tint != glm::vec4(1.0f)) {
+        for (std::size_t i = 0; i < sprite.pixels.size(); ++i)
+            sprite.pixels[i] = (unsigned char)std::min(255.0f, sprite.pixels[i] * tint[int(i % 4)] + 0.5f);
+    }
+    m_sprites.push_back(std::move(sprite));
+    return int(m_sprites.size()) - 1;
+}
+
+int TextureAtlas::add(const std::string& imageFilename, const glm::vec4& tint, int maxSize)
+{
+    // First row at the bottom, like TextureCache (per thread setting)
+    stbi_set_flip_vertically_on_load_thread(true);
+    int width, height, nrComponents;
+    unsigned char* pixels = stbi_load(imageFilename.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
+    if (pixels == nullptr) {
+        std::cerr << "Atlas sprite failed to load at path: " << imageFilename << std::endl;
+        return -1;
+    }
+    const int index = add(pixels, width, height, tint, maxSize);
+    stbi_image_free(pixels);
+    return index;
+}
+
+int TextureAtlas::addFlipbook(const std::string& imageFilename, int columns, int rows)
+{
+    stbi_set_flip_vertically_on_load_thread(true);
+    int width, height, nrComponents;
+    unsigned char* pixels = stbi_load(imageFilename.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
+    if (pixels == nullptr || columns < 1 || rows < 1 || width < columns || height < rows) {
+        std::cerr << "Atlas flipbook failed to load at path: " << imageFilename << std::endl;
+        stbi_image_free(pixels);
+        return -1;
+    }
+
+    // The rows of the image are flipped: the first frame is at the top of the buffer
+    const int frameWidth = width / columns;
+    const int frameHeight = height / rows;
+    std::vector<unsigned char> frame(std::size_t(frameWidth) * frameHeight * 4);
+    const int first = numSprites();
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            const int y0 = height - (r + 1) * frameHeight;
+            for (int y = 0; y < frameHeight; ++y) {
+                std::memcpy(frame.data() + std::size_t(y) * frameWidth * 4,
+                    pixels + (std::size_t(y0 + y) * width + std::size_t(c) * frameWidth) * 4,
+                    std::size_t(frameWidth) * 4);
+            }
+            add(frame.data(), frameWidth, frameHeight);
+        }
+    }
+    stbi_image_free(pixels);
+    return first;
+}
+
+bool TextureAtlas::build(TextureCache::ColorSpace colorSpace, int maxSize, TextureCache::Format format)
+{
+    m_levels.clear();
+    m_rects.clear();
+    if (m_sprites.empty())
+        return false;
+
+    // The sprites larger than their display size first, filtered like the levels
+    const stbir_colorspace space = (colorSpace == TextureCache::ColorSpace::SRGB) ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+    for (Sprite& sprite : m_sprites) {
+        const int largest = std::max(sprite.width, sprite.height);
+        if (sprite.maxSize <= 0 || largest <= sprite.maxSize)
+            continue;
+        const int width = std::max(1, sprite.width * sprite.maxSize / largest);
+        const int height = std::max(1, sprite.height * sprite.maxSize / largest);
+        std::vector<unsigned char> pixels(std::size_t(width) * height * 4);
+        if (!stbir_resize_uint8_generic(sprite.pixels.data(), sprite.width, sprite.height, 0,
+                pixels.data(), width, height, 0, 4, 3, 0, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, space, nullptr))
+            return false;
+        sprite.width = width;
+        sprite.height = height;
+        sprite.pixels = std::move(pixels);
+    }
+
+    // The cells are packed in units of padding texels: their corners stay aligned
+    // on the texels of all the levels
+    const int unit = m_padding;
+    std::vector<stbrp_rect> cells(m_sprites.size());
+    long long area = 0;
+    int minWidth = 1, minHeight = 1;
+    for (std::size_t i = 0; i < m_sprites.size(); ++i) {
+        cells[i] = stbrp_rect();
+        cells[i].id = int(i);
+        cells[i].w = roundUp(m_sprites[i].width + 2 * m_padding, unit) / unit;
+        cells[i].h = roundUp(m_sprites[i].height + 2 * m_padding, unit) / unit;
+        area += (long long)cells[i].w * cells[i].h * unit * unit;
+        minWidth = std::max(minWidth, cells[i].w * unit);
+        minHeight = std::max(minHeight, cells[i].h * unit);
+    }
+
+    // Smallest power of two size where they fit, growing the width and the height in turn
+    int width = 1, height = 1;
+    while (width < minWidth || width < unit)
+        width *= 2;
+    while (height < minHeight || height < unit)
+        height *= 2;
+    while ((long long)width * height < area) {
+        if (width <= height)
+            width *= 2;
+        else
+            height *= 2;
+    }
+    for (;;) {
+        if (width > maxSize || height > maxSize) {
+            std::cerr << "Atlas: the sprites do not fit in " << maxSize << "x" << maxSize << " texels" << std::endl;
+            return false;
+        }
+        std::vector<stbrp_node> nodes(std::size_t(width / unit));
+        stbrp_context context;
+        stbrp_init_target(&context, width / unit, height / unit, nodes.data(), int(nodes.size()));
+        if (stbrp_pack_rects(&context, cells.data(), int(cells.size())))
+            break;
+        if (width <= height)
+            width *= 2;
+        else
+            height *= 2;
+    }
+    m_width = width;
+    m_height = height;
+
+    // Level 0: each cell filled with its sprite, the gutter repeating the edges.
+    // Levels 1 to log2(padding) only
+    int numLevels = 1;
+    while ((1 << (numLevels - 1)) < unit)
+        ++numLevels;
+    m_levels.resize(std::size_t(numLevels));
+    m_levels[0].assign(std::size_t(width) * height * 4, 0);
+    m_rects.resize(m_sprites.size());
+    for (const stbrp_rect& cell : cells) {
+        Sprite& sprite = m_sprites[std::size_t(cell.id)];
+        const int cellX = cell.x * unit, cellY = cell.y * unit;
+        sprite.x = cellX + m_padding;
+        sprite.y = cellY + m_padding;
+        for (int y = 0; y < cell.h * unit; ++y) {
+            const int sy = std::min(std::max(y - m_padding, 0), sprite.height - 1);
+            for (int x = 0; x < cell.w * unit; ++x) {
+                const int sx = std::min(std::max(x - m_padding, 0), sprite.width - 1);
+                std::memcpy(&m_levels[0][(std::size_t(cellY + y) * width + cellX + x) * 4],
+                    &sprite.pixels[(std::size_t(sy) * sprite.width + sx) * 4], 4);
+            }
+        }
+        m_rects[std::size_t(cell.id)] = glm::vec4(float(sprite.x) / width, float(sprite.y) / height,
+            float(sprite.x + sprite.width) / width, float(sprite.y + sprite.height) / height);
+    }
+
+    // Next levels: each cell filtered on its own (it halves exactly)
+    for (int l = 1; l < numLevels; ++l) {
+        const int srcWidth = width >> (l - 1), dstWidth = width >> l;
+        m_levels[l].assign(std::size_t(dstWidth) * (height >> l) * 4, 0);
+        for (const stbrp_rect& cell : cells) {
+            const int x = (cell.x * unit) >> l, y = (cell.y * unit) >> l;
+            const int w = (cell.w * unit) >> l, h = (cell.h * unit) >> l;
+            if (!stbir_resize_uint8_generic(&m_levels[l - 1][(std::size_t(2 * y) * srcWidth + 2 * x) * 4], 2 * w, 2 * h, srcWidth * 4,
+                    &m_levels[l][(std::size_t(y) * dstWidth + x) * 4], w, h, dstWidth * 4,
+                    4, 3, 0, STBIR_EDGE_CLAMP, STBIR_FILTER_BOX, space, nullptr)) {
+                m_levels.clear();
+                m_rects.clear();
+                return false;
+            }
+        }
+    }
+
+    // Block compressed once all the levels are filtered
+    m_format = format;
+    if (format != TextureCache::Format::RGBA8) {
+        for (int l = 0; l < numLevels; ++l) {
+            std::vector<unsigned char> blocks(TextureCache::levelBytes(format, width >> l, height >> l));
+            TextureCache::compressLevel(m_levels[l].data(), width >> l, height >> l, format, blocks.data());
+            m_levels[l] = std::move(blocks);
+        }
+    }
+    return true;
+}
+
+GLuint TextureAtlas::createTexture() const
+{
+    GLuint texture = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    const GLenum internalFormat = TextureLoader::internalFormat(m_format);
+    glTextureStorage2D(texture, numLevels(), internalFormat, m_width, m_height);
+    for (int l = 0; l < numLevels(); ++l) {
+        if (m_format == TextureCache::Format::RGBA8)
+            glTextureSubImage2D(texture, l, 0, 0, m_width >> l, m_height >> l, GL_RGBA, GL_UNSIGNED_BYTE, m_levels[l].data());
+        else
+            glCompressedTextureSubImage2D(texture, l, 0, 0, m_width >> l, m_height >> l, internalFormat, GLsizei(m_levels[l].size()), m_levels[l].data());
+    }
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, numLevels() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+GLuint TextureAtlas::createRectBuffer() const
+{
+    GLuint buffer = 0;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, GLsizeiptr(m_rects.size() * sizeof(glm::vec4)), m_rects.data(), 0);
+    return buffer;
+}
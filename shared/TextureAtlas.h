@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "TextureCache.h"
+
+// Sprites (particles, grass species, flipbook frames) packed with stb_rect_pack
+// in a single texture, so the draws using several of them need one binding and
+// one draw call. The shaders map their quad coordinates in the rectangle of a
+// sprite, read in the UV-rect table:
+//
+//     layout(std430, binding = ...) readonly buffer SpriteRects { vec4 spriteRects[]; }; // (u0, v0, u1, v1)
+//     vec2 uv = mix(spriteRects[sprite].xy, spriteRects[sprite].zw, quadUV);
+//
+// - Each sprite is surrounded by a gutter of padding texels, repeating its edges
+//   (like GL_CLAMP_TO_EDGE), so the bilinear filtering never reads a neighbour.
+// - Mip safe: the cells (sprite and gutter) are placed and sized in multiples of
+//   the padding (a power of two), so the texels of the levels 1 to log2(padding)
+//   never straddle two cells, and each level keeps a gutter of one texel at least.
+//   The texture only has these levels (filtered like TextureCache: 2x2 box, in
+//   linear space for the sRGB sprites, weighted by the alpha): a padding as large
+//   as the sprites gives them their full mip chain.
+// - The sprites larger than their display size (maxSize of add) are downscaled
+//   first, so a large image does not inflate the atlas.
+// - The levels are RGBA8 or block compressed like TextureCache. The 4x4 blocks
+//   with texels of a sprite stay in its cell while the gutter is 2 texels at
+//   least: only the last level may mix the colors of two cells.
+// - The first row is the bottom one (OpenGL convention).
+class TextureAtlas
+{
+public:
+    // padding: gutter around each sprite, in texels (rounded up to a power of two)
+    explicit TextureAtlas(int padding = 8);
+
+    // ------------------------------------------------------------------------
+    // add a sprite from an image file, its texels multiplied by tint
+    // (variants of one image), return its index or -1 if the image cannot be read.
+    // maxSize: largest side of the sprite in the atlas (0: its image size)
+    int add(const std::string& imageFilename, const glm::vec4& tint = glm::vec4(1.0f), int maxSize = 0);
+    // add a sprite from RGBA8 texels, the first row being the bottom one
+    int add(const unsigned char* pixels, int width, int height, const glm::vec4& tint = glm::vec4(1.0f), int maxSize = 0);
+    // ------------------------------------------------------------------------
+    // add the frames of a flipbook (columns x rows frames of the same size, from
+    // the top left corner, row by row), return the index of the first one or -1
+    int addFlipbook(const std::string& imageFilename, int columns, int rows);
+
+    // ------------------------------------------------------------------------
+    // pack the sprites in the smallest power of two texture (up to maxSize x maxSize)
+    // and build its levels, stored in format. Return false if they do not fit.
+    bool build(TextureCache::ColorSpace colorSpace = TextureCache::ColorSpace::SRGB, int maxSize = 4096,
+        TextureCache::Format format = TextureCache::Format::RGBA8);
+    bool isBuilt() const { return !m_levels.empty(); }
+
+    // ------------------------------------------------------------------------
+    // create the texture of the built atlas (clamped to its edges, trilinear filtering)
+    GLuint createTexture() const;
+    // ------------------------------------------------------------------------
+    // create the shader storage buffer of the UV-rect table (one vec4 by sprite)
+    GLuint createRectBuffer() const;
+
+    int padding() const { return m_padding; }
+    int numSprites() const { return int(m_sprites.size()); }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int numLevels() const { return int(m_levels.size()); }
+    TextureCache::Format format() const { return m_format; }
+    // (u0, v0, u1, v1) of each sprite, its gutter excluded
+    const std::vector<glm::vec4>& rects() const { return m_rects; }
+    // RGBA8 texels or 4x4 blocks of a level, tightly packed
+    const std::vector<unsigned char>& level(int l) const { return m_levels[l]; }
+
+private:
+    struct Sprite
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels; // RGBA8, tinted
+        int maxSize = 0;                   // Downscaled by build above it (0: never)
+        int x = 0;                         // Bottom left corner in the atlas, gutter excluded
+        int y = 0;
+    };
+
+private:
+    int m_padding;
+    std::vector<Sprite> m_sprites;
+
+    int m_width = 0;
+    int m_height = 0;
+    TextureCache::Format m_format = TextureCache::Format::RGBA8;
+    std::vector<std::vector<unsigned char>> m_levels;
+    std::vector<glm::vec4> m_rects;
+};
@@ -0,0 +1,300 @@
+#include "TextureCache.h"
+#include "CacheFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+// The implementation of stb_image, for all the programs using the shared files
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+namespace
+{
+    // File layout (native endianness, the cache is a local file):
+    //   FileHeader
+    //   LevelRecord[numLevels]
+    //   pixels (or blocks) of each level, from the full size to 1x1 (each aligned on BlobAlignment bytes)
+    const char          Magic[8] = { 'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E' };
+    const std::uint32_t Version = 2;
+    const std::size_t   BlobAlignment = 64;
+
+    struct FileHeader
+    {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t colorSpace;
+        std::uint64_t sourceSize;
+        std::int64_t  sourceTime;
+        std::uint32_t numLevels;
+        std::uint32_t format;
+    };
+
+    struct LevelRecord
+    {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    // Compress the rows of blocks [firstRow, lastRow) of an RGBA8 level (the partial blocks
+    // of the right and top edges repeat the last column and row)
+    void compressRows(const unsigned char* pixels, int width, int height, TextureCache::Format format,
+        int firstRow, int lastRow, unsigned char* blocks)
+    {
+        const std::size_t blockSize = TextureCache::blockBytes(format);
+        const int blocksPerRow = (width + 3) / 4;
+        unsigned char rgba[16 * 4];
+        unsigned char rg[16 * 2];
+        for (int by = firstRow; by < lastRow; ++by) {
+            for (int bx = 0; bx < blocksPerRow; ++bx) {
+                for (int i = 0; i < 16; ++i) {
+                    const int x = std::min(bx * 4 + i % 4, width - 1);
+                    const int y = std::min(by * 4 + i / 4, height - 1);
+                    const unsigned char* p = pixels + (std::size_t(y) * width + x) * 4;
+                    std::memcpy(rgba + i * 4, p, 4);
+                    rg[i * 2] = p[0];
+                    rg[i * 2 + 1] = p[1];
+                    if (format == TextureCache::Format::BC1)
+                        rgba[i * 4 + 3] = 255; // Alpha ignored, but must be constant
+                }
+                unsigned char* dest = blocks + (std::size_t(by) * blocksPerRow + bx) * blockSize;
+                if (format == TextureCache::Format::BC5)
+                    stb_compress_bc5_block(dest, rg);
+                else
+                    stb_compress_dxt_block(dest, rgba, format == TextureCache::Format::BC3 ? 1 : 0, STB_DXT_HIGHQUAL);
+            }
+        }
+    }
+
+    // Content of the cache file: the image and its mip chain, each level filtered from the previous one
+    // (2x2 box for the even sizes, in linear space for the sRGB images, weighted by the alpha),
+    // then block compressed if requested
+    bool buildCache(const unsigned char* pixels, int width, int height, TextureCache::ColorSpace colorSpace,
+        TextureCache::Format format, FileHeader header, std::vector<char>& buffer)
+    {
+        const int numLevels = TextureCache::numLevels(width, height);
+        header.numLevels = std::uint32_t(numLevels);
+        header.format = std::uint32_t(format);
+
+        // Uncompressed mip chain
+        std::vector<std::vector<unsigned char>> levels(numLevels);
+        levels[0].assign(pixels, pixels + std::size_t(width) * height * 4);
+        const stbir_colorspace space = (colorSpace == TextureCache::ColorSpace::SRGB) ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+        for (int l = 1; l < numLevels; ++l) {
+            const int srcWidth = std::max(1, width >> (l - 1)), srcHeight = std::max(1, height >> (l - 1));
+            const int dstWidth = std::max(1, width >> l), dstHeight = std::max(1, height >> l);
+            levels[l].resize(std::size_t(dstWidth) * dstHeight * 4);
+            if (!stbir_resize_uint8_generic(levels[l - 1].data(), srcWidth, srcHeight, 0,
+                    levels[l].data(), dstWidth, dstHeight, 0,
+                    4, 3, 0, STBIR_EDGE_CLAMP, STBIR_FILTER_BOX, space, nullptr))
+                return false;
+        }
+
+        std::vector<LevelRecord> records(numLevels);
+        std::size_t offset = sizeof(FileHeader) + numLevels * sizeof(LevelRecord);
+        for (int l = 0; l < numLevels; ++l) {
+            records[l].width = std::uint32_t(std::max(1, width >> l));
+            records[l].height = std::uint32_t(std::max(1, height >> l));
+            records[l].size = TextureCache::levelBytes(format, int(records[l].width), int(records[l].height));
+            records[l].offset = CacheFile::alignUp(offset, BlobAlignment);
+            offset = records[l].offset + records[l].size;
+        }
+
+        buffer.assign(offset, 0);
+        std::memcpy(buffer.data(), &header, sizeof(FileHeader));
+        std::memcpy(buffer.data() + sizeof(FileHeader), records.data(), records.size() * sizeof(LevelRecord));
+        for (int l = 0; l < numLevels; ++l) {
+            unsigned char* dest = reinterpret_cast<unsigned char*>(buffer.data() + records[l].offset);
+            if (format == TextureCache::Format::RGBA8)
+                std::memcpy(dest, levels[l].data(), records[l].size);
+            else
+                TextureCache::compressLevel(levels[l].data(), int(records[l].width), int(records[l].height), format, dest);
+        }
+        return true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Cache file associated with an image file
+std::string TextureCache::cacheFilename(const std::string& imageFilename)
+{
+    return imageFilename + ".texcache";
+}
+
+std::size_t TextureCache::blockBytes(Format format)
+{
+    switch (format) {
+    case Format::BC1: return 8;
+    case Format::BC3:
+    case Format::BC5: return 16;
+    default: return 4; // One pixel
+    }
+}
+
+std::size_t TextureCache::levelBytes(Format format, int width, int height)
+{
+    if (format == Format::RGBA8)
+        return std::size_t(width) * height * 4;
+    return std::size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+int TextureCache::numLevels(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+// Compress an RGBA8 level, the rows of blocks are split between the hardware threads
+void TextureCache::compressLevel(const unsigned char* pixels, int width, int height, Format format, unsigned char* blocks)
+{
+    const int numRows = (height + 3) / 4;
+    const int rowsPerTask = 16; // Not worth a thread below 64 rows of pixels
+    const int numThreads = std::clamp((numRows + rowsPerTask - 1) / rowsPerTask, 1, int(std::max(1u, std::thread::hardware_concurrency())));
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) {
+        threads.emplace_back(compressRows, pixels, width, height, format,
+            numRows * t / numThreads, numRows * (t + 1) / numThreads, blocks);
+    }
+    compressRows(pixels, width, height, format, 0, numRows / numThreads, blocks);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Open the cache, (re)building it when needed
+bool TextureCache::load(const std::string& imageFilename, ColorSpace colorSpace, Format format)
+{
+    if (open(imageFilename, colorSpace, format))
+        return true;
+
+    // Missing or outdated: decode the image and write a new cache
+    if (!decode(imageFilename, colorSpace, format))
+        return false;
+
+    std::vector<char> buffer = std::move(m_memory);
+    unload();
+    if (CacheFile::writeOrKeep(cacheFilename(imageFilename), buffer, m_memory))
+        return open(imageFilename, colorSpace, format);
+
+    // Read-only directory: the levels are used from memory
+    return parse(m_memory.data(), m_memory.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Decode the image and build its levels in memory
+bool TextureCache::decode(const std::string& imageFilename, ColorSpace colorSpace, Format format)
+{
+    unload();
+
+    FileHeader header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.colorSpace = std::uint32_t(colorSpace);
+    if (!CacheFile::sourceStamp(imageFilename, header.sourceSize, header.sourceTime))
+        return false;
+
+    // This is necessary as TexImage2D assume "The first element corresponds to the lower left corner of the texture image"
+    // whereas stb_image load the image such "the first pixel pointed to is top-left-most in the image"
+    // (per thread setting: the loaders running on other threads are not affected)
+    stbi_set_flip_vertically_on_load_thread(true);
+    int width, height, nrComponents;
+    unsigned char* pixels = stbi_load(imageFilename.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
+    if (pixels == nullptr)
+        return false;
+    const bool built = buildCache(pixels, width, height, colorSpace, format, header, m_memory);
+    stbi_image_free(pixels);
+    if (!built || !parse(m_memory.data(), m_memory.size())) {
+        unload();
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the cache file
+bool TextureCache::open(const std::string& imageFilename, ColorSpace colorSpace, Format format)
+{
+    unload();
+
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceTime = 0;
+    if (!CacheFile::sourceStamp(imageFilename, sourceSize, sourceTime))
+        return false;
+
+    const std::string filename = cacheFilename(imageFilename);
+    std::error_code ec;
+    if (!std::filesystem::exists(filename, ec))
+        return false;
+    if (!m_file.open(filename))
+        return false;
+
+    // Validate the header
+    FileHeader header;
+    if (m_file.size() < sizeof(FileHeader)) {
+        unload();
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(FileHeader));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        std::cout << "Warning: Invalid texture cache " << filename << std::endl;
+        unload();
+        return false;
+    }
+    if (header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+        header.colorSpace != std::uint32_t(colorSpace) || header.format != std::uint32_t(format)) {
+        // Outdated
+        unload();
+        return false;
+    }
+
+    if (!parse(m_file.data(), m_file.size())) {
+        std::cout << "Warning: Truncated texture cache " << filename << std::endl;
+        unload();
+        return false;
+    }
+    return true;
+}
+
+bool TextureCache::parse(const char* data, std::size_t size)
+{
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(FileHeader));
+    if (header.numLevels == 0 || header.format > std::uint32_t(Format::BC5) ||
+        !CacheFile::inFile(sizeof(FileHeader), header.numLevels * sizeof(LevelRecord), size))
+        return false;
+    m_format = Format(header.format);
+
+    for (std::uint32_t l = 0; l < header.numLevels; ++l) {
+        LevelRecord r;
+        std::memcpy(&r, data + sizeof(FileHeader) + l * sizeof(LevelRecord), sizeof(LevelRecord));
+        if (r.size != levelBytes(m_format, int(r.width), int(r.height)) || !CacheFile::inFile(r.offset, r.size, size)) {
+            m_levels.clear();
+            return false;
+        }
+        m_levels.push_back({ reinterpret_cast<const unsigned char*>(data + r.offset), int(r.width), int(r.height), std::size_t(r.size) });
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Clear data
+void TextureCache::unload()
+{
+    m_levels.clear();
+    m_memory.clear();
+    m_file.close();
+}
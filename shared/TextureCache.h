@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Decoded image with its whole mip chain, stored in a cache file written next to
+// the image ("image.png.texcache") the first time it is loaded.
+//
+// - The levels are flipped so the first row is the bottom one (OpenGL texture
+//   convention), from the full size down to 1x1. They are filtered on the CPU
+//   with stb_image_resize, in linear space for the sRGB images, then stored as
+//   RGBA8 or block compressed with stb_dxt (the blocks of a level are split
+//   between the hardware threads).
+// - Each level is stored raw at an aligned offset: the file is mapped and the
+//   levels are given as is to glTextureSubImage2D, without decoding the image
+//   or generating the mipmaps again.
+// - The cache is outdated (and rebuilt by load) when the size or the
+//   modification time of the image changes, or for another color space or format.
+class TextureCache
+{
+public:
+    // How the levels are filtered
+    enum class ColorSpace
+    {
+        SRGB,  // Colors (diffuse, sky, sprites): averaged once converted to linear
+        Linear // Data (normal, roughness/metallic, flow maps): averaged as is
+    };
+
+    // Storage of the levels
+    enum class Format
+    {
+        RGBA8, // Uncompressed
+        BC1,   // RGB, 4 bits per pixel (alpha dropped): opaque colors
+        BC3,   // RGBA, 8 bits per pixel: colors with alpha
+        BC5    // RG, 8 bits per pixel: normal maps (z = sqrt(1 - x^2 - y^2) in the shader)
+    };
+
+    struct Level
+    {
+        const unsigned char* pixels; // RGBA8 pixels or 4x4 blocks, tightly packed
+        int width;
+        int height;
+        std::size_t size;            // In bytes (glCompressedTextureSubImage2D imageSize)
+    };
+
+    // ------------------------------------------------------------------------
+    // open the cache of an image file, (re)building it from the image when needed.
+    // If the cache cannot be written, the levels are kept in memory.
+    bool load(const std::string& imageFilename, ColorSpace colorSpace, Format format = Format::RGBA8);
+    // map the cache of an image file. Fails if it is missing, invalid or outdated.
+    bool open(const std::string& imageFilename, ColorSpace colorSpace, Format format = Format::RGBA8);
+    // decode an image file and keep its levels in memory, without reading or
+    // writing its cache (for the files derived from the levels, see TiledImage)
+    bool decode(const std::string& imageFilename, ColorSpace colorSpace, Format format = Format::RGBA8);
+    bool isLoaded() const { return !m_levels.empty(); }
+    void unload();
+
+    // From the full size to 1x1
+    const std::vector<Level>& levels() const { return m_levels; }
+    int width() const { return m_levels.empty() ? 0 : m_levels[0].width; }
+    int height() const { return m_levels.empty() ? 0 : m_levels[0].height; }
+    Format format() const { return m_format; }
+
+    // Cache file associated with an image file
+    static std::string cacheFilename(const std::string& imageFilename);
+    // Number of levels of a full mip chain
+    static int numLevels(int width, int height);
+    // Size of a 4x4 block (of a pixel for RGBA8), and of a level
+    static std::size_t blockBytes(Format format);
+    static std::size_t levelBytes(Format format, int width, int height);
+    // Block compress an RGBA8 level (BC1, BC3 or BC5) in blocks (levelBytes bytes),
+    // the partial blocks of the edges repeat the last column and row
+    static void compressLevel(const unsigned char* pixels, int width, int height, Format format, unsigned char* blocks);
+
+private:
+    // Point the levels in the content of a cache file (mapped or in memory)
+    // once its header is validated
+    bool parse(const char* data, std::size_t size);
+
+private:
+    MappedFile m_file;
+    std::vector<char> m_memory; // Content of the cache when it cannot be written
+    std::vector<Level> m_levels;
+    Format m_format = Format::RGBA8;
+};
@@ -0,0 +1,377 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+
+// S3TC formats (EXT_texture_compression_s3tc, not in the OpenGL core profile headers,
+// but exposed by all the desktop drivers)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace
+{
+    bool usesMipmaps(GLint minMode)
+    {
+        return minMode == GL_NEAREST_MIPMAP_NEAREST || minMode == GL_LINEAR_MIPMAP_NEAREST ||
+            minMode == GL_NEAREST_MIPMAP_LINEAR || minMode == GL_LINEAR_MIPMAP_LINEAR;
+    }
+}
+
+GLenum TextureLoader::internalFormat(TextureCache::Format format)
+{
+    switch (format) {
+    case TextureCache::Format::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureCache::Format::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureCache::Format::BC5: return GL_COMPRESSED_RG_RGTC2;
+    default: return GL_RGBA8;
+    }
+}
+
+TextureLoader::TextureLoader(unsigned int numThreads, std::size_t ringSize) :
+    m_ringSize(ringSize)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < numThreads; ++i)
+        m_workers.emplace_back(&TextureLoader::run, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_jobAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+void TextureLoader::run()
+{
+    for (;;) {
+        Decoded image;
+        TextureCache::ColorSpace colorSpace;
+        TextureCache::Format format;
+        bool mipmaps;
+        bool streaming;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+            if (m_quit)
+                return;
+            image.path = std::move(m_jobs.front().path);
+            colorSpace = m_jobs.front().colorSpace;
+            format = m_jobs.front().format;
+            mipmaps = m_jobs.front().mipmaps;
+            streaming = m_jobs.front().streaming;
+            m_jobs.pop_front();
+        }
+
+        // Mapped from the cache file, or decoded (and the cache written) the first time.
+        // The streamed levels are copied in the ring when they are uploaded: the
+        // whole image would hold its region for many frames
+        if (image.cache.load(image.path, colorSpace, format) && !streaming)
+            stage(image, mipmaps);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decoded.push_back(std::move(image));
+        }
+        m_imageDecoded.notify_one();
+    }
+}
+
+void TextureLoader::stage(Decoded& image, bool mipmaps)
+{
+    const std::vector<TextureCache::Level>& levels = image.cache.levels();
+    const std::size_t numLevels = mipmaps ? levels.size() : 1;
+    std::size_t size = 0;
+    for (std::size_t l = 0; l < numLevels; ++l) {
+        image.levelOffsets.push_back(size);
+        size += (levels[l].size + PixelUploadRing::Alignment - 1) / PixelUploadRing::Alignment * PixelUploadRing::Alignment;
+    }
+
+    // Ring full (or image larger than the ring): uploaded from the cache by the rendering thread
+    if (!m_ring.allocate(size, image.ringOffset)) {
+        image.levelOffsets.clear();
+        return;
+    }
+    for (std::size_t l = 0; l < numLevels; ++l)
+        std::memcpy(m_ring.data(image.ringOffset + image.levelOffsets[l]), levels[l].pixels, levels[l].size);
+    image.staged = true;
+}
+
+GLuint TextureLoader::acquire(const std::string& path, GLint uvMode, GLint minMode, GLint magMode,
+    TextureCache::ColorSpace colorSpace, TextureCache::Format format)
+{
+    auto found = m_entries.find(path);
+    if (found != m_entries.end()) {
+        ++found->second.refCount;
+        return found->second.texture;
+    }
+
+    // Created with the first texture: the constructor may run before the OpenGL context exists
+    if (!m_ring.isCreated() && m_ringSize != 0)
+        m_ring.create(m_ringSize);
+
+    // OpenGL 4.6 -- need to specify the texture type
+    Entry entry;
+    glCreateTextures(GL_TEXTURE_2D, 1, &entry.texture);
+    entry.refCount = 1;
+    entry.minMode = minMode;
+    entry.streaming = m_streaming && usesMipmaps(minMode);
+    glTextureParameteri(entry.texture, GL_TEXTURE_WRAP_S, uvMode);
+    glTextureParameteri(entry.texture, GL_TEXTURE_WRAP_T, uvMode);
+    glTextureParameteri(entry.texture, GL_TEXTURE_MIN_FILTER, minMode);
+    glTextureParameteri(entry.texture, GL_TEXTURE_MAG_FILTER, magMode);
+    m_entries.emplace(path, entry);
+    m_paths.emplace(entry.texture, path);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back({ path, colorSpace, format, usesMipmaps(minMode), entry.streaming });
+    }
+    m_jobAvailable.notify_one();
+    ++m_numPending;
+    return entry.texture;
+}
+
+void TextureLoader::release(GLuint texture)
+{
+    auto path = m_paths.find(texture);
+    if (path == m_paths.end())
+        return;
+    auto found = m_entries.find(path->second);
+    if (--found->second.refCount > 0)
+        return;
+
+    // An image still being decoded is dropped by uploadQueued
+    glDeleteTextures(1, &texture);
+    m_entries.erase(found);
+    m_paths.erase(path);
+}
+
+std::size_t TextureLoader::update(std::size_t budgetBytes)
+{
+    m_ring.reclaim();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::move(m_decoded.begin(), m_decoded.end(), std::back_inserter(m_queued));
+        m_decoded.clear();
+    }
+    std::size_t uploaded = 0;
+    const std::size_t ready = uploadQueued(budgetBytes, uploaded);
+    streamLevels(budgetBytes, uploaded);
+    return ready;
+}
+
+bool TextureLoader::finish()
+{
+    while (m_numPending != 0) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_queued.empty())
+                m_imageDecoded.wait(lock, [this] { return !m_decoded.empty(); });
+            std::move(m_decoded.begin(), m_decoded.end(), std::back_inserter(m_queued));
+            m_decoded.clear();
+        }
+        std::size_t uploaded = 0;
+        uploadQueued(std::numeric_limits<std::size_t>::max(), uploaded);
+        m_ring.reclaim();
+    }
+
+    return std::none_of(m_entries.begin(), m_entries.end(),
+        [](const auto& entry) { return entry.second.state == State::Failed; });
+}
+
+std::size_t TextureLoader::uploadQueued(std::size_t budgetBytes, std::size_t& uploaded)
+{
+    std::size_t ready = 0;
+    while (!m_queued.empty() && uploaded < budgetBytes) {
+        Decoded image = std::move(m_queued.front());
+        m_queued.pop_front();
+        --m_numPending;
+
+        auto found = m_entries.find(image.path);
+        // Released (or loaded again) while the image was decoded
+        if (found == m_entries.end() || found->second.state != State::Loading) {
+            if (image.staged)
+                m_ring.discard(image.ringOffset);
+            continue;
+        }
+
+        if (image.cache.isLoaded()) {
+            Entry& entry = found->second;
+            uploaded += upload(entry, image);
+            entry.state = State::Ready;
+            ++ready;
+            std::cout << "Texture loaded at path: " << image.path << std::endl;
+            // The finer levels are streamed from the cache by the next updates
+            if (entry.residentLevel > 0)
+                entry.source = std::make_shared<Decoded>(std::move(image));
+        }
+        else {
+            found->second.state = State::Failed;
+            std::cerr << "Texture failed to load at path: " << image.path << std::endl;
+        }
+    }
+    return ready;
+}
+
+std::size_t TextureLoader::upload(Entry& entry, const Decoded& image)
+{
+    // The mip chain comes from the cache: no glGenerateTextureMipmap
+    const std::vector<TextureCache::Level>& levels = image.cache.levels();
+    const int numLevels = usesMipmaps(entry.minMode) ? int(levels.size()) : 1;
+    glTextureStorage2D(entry.texture, numLevels, internalFormat(image.cache.format()), levels[0].width, levels[0].height);
+
+    // Streamed: only the levels up to StreamingTail (at least the last one) for now
+    int first = 0;
+    if (entry.streaming) {
+        first = numLevels - 1;
+        while (first > 0 && std::max(levels[first - 1].width, levels[first - 1].height) <= StreamingTail)
+            --first;
+    }
+
+    std::size_t bytes = 0;
+    for (int l = first; l < numLevels; ++l)
+        bytes += uploadLevel(entry.texture, image, l);
+    if (image.staged)
+        m_ring.retire(image.ringOffset);
+
+    // The sampling ignores the levels above the base one, still empty
+    entry.residentLevel = first;
+    if (first > 0)
+        glTextureParameteri(entry.texture, GL_TEXTURE_BASE_LEVEL, first);
+    return bytes;
+}
+
+std::size_t TextureLoader::uploadLevel(GLuint texture, const Decoded& image, int level)
+{
+    const TextureCache::Level& data = image.cache.levels()[level];
+    const GLenum format = internalFormat(image.cache.format());
+
+    // From the ring, the pixels are an offset in it and the driver copies them
+    // asynchronously: staged by the worker, or copied now when there is room
+    std::size_t offset = 0;
+    bool fromRing = image.staged;
+    if (image.staged) {
+        offset = image.ringOffset + image.levelOffsets[level];
+    }
+    else if (m_ring.allocate(data.size, offset)) {
+        std::memcpy(m_ring.data(offset), data.pixels, data.size);
+        fromRing = true;
+    }
+
+    if (fromRing)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_ring.buffer());
+    const void* pixels = fromRing ? reinterpret_cast<const void*>(offset) : data.pixels;
+    if (format == GL_RGBA8)
+        glTextureSubImage2D(texture, level, 0, 0, data.width, data.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    else
+        glCompressedTextureSubImage2D(texture, level, 0, 0, data.width, data.height, format, GLsizei(data.size), pixels);
+    if (fromRing) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        // The staged regions are retired once all their levels are issued
+        if (!image.staged)
+            m_ring.retire(offset);
+    }
+    return data.size;
+}
+
+void TextureLoader::streamLevels(std::size_t budgetBytes, std::size_t& uploaded)
+{
+    std::vector<Entry*> streamed;
+    for (auto& entry : m_entries) {
+        if (entry.second.source && entry.second.residentLevel > wantedLevel(entry.second))
+            streamed.push_back(&entry.second);
+    }
+    std::sort(streamed.begin(), streamed.end(),
+        [](const Entry* a, const Entry* b) { return a->screenSize > b->screenSize; });
+
+    for (Entry* entry : streamed) {
+        if (uploaded >= budgetBytes)
+            break;
+        // From the coarse levels to the fine ones: the base level always has its pixels
+        const int wanted = wantedLevel(*entry);
+        while (entry->residentLevel > wanted && uploaded < budgetBytes) {
+            uploaded += uploadLevel(entry->texture, *entry->source, entry->residentLevel - 1);
+            --entry->residentLevel;
+        }
+        glTextureParameteri(entry->texture, GL_TEXTURE_BASE_LEVEL, entry->residentLevel);
+        if (entry->residentLevel == 0)
+            entry->source.reset();
+    }
+}
+
+int TextureLoader::wantedLevel(const Entry& entry)
+{
+    const std::vector<TextureCache::Level>& levels = entry.source->cache.levels();
+    const float size = float(std::max(levels[0].width, levels[0].height));
+    // Magnified (or not given): full resolution
+    if (!(entry.screenSize < size))
+        return 0;
+    // Each level halves the size
+    const int level = int(std::floor(std::log2(size / std::max(entry.screenSize, 1.0f))));
+    return std::min(level, int(levels.size()) - 1);
+}
+
+void TextureLoader::clear()
+{
+    // Wait for the images being decoded: the workers write in the ring
+    while (m_numPending != 0) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_queued.empty())
+                m_imageDecoded.wait(lock, [this] { return !m_decoded.empty(); });
+            std::move(m_decoded.begin(), m_decoded.end(), std::back_inserter(m_queued));
+            m_decoded.clear();
+        }
+        for (const Decoded& image : m_queued) {
+            if (image.staged)
+                m_ring.discard(image.ringOffset);
+        }
+        m_numPending -= m_queued.size();
+        m_queued.clear();
+    }
+    m_ring.destroy();
+
+    for (const auto& entry : m_entries)
+        glDeleteTextures(1, &entry.second.texture);
+    m_entries.clear();
+    m_paths.clear();
+}
+
+bool TextureLoader::isReady(GLuint texture) const
+{
+    auto path = m_paths.find(texture);
+    return path != m_paths.end() && m_entries.at(path->second).state == State::Ready;
+}
+
+bool TextureLoader::hasFailed(GLuint texture) const
+{
+    auto path = m_paths.find(texture);
+    return path != m_paths.end() && m_entries.at(path->second).state == State::Failed;
+}
+
+void TextureLoader::requestSize(GLuint texture, float screenSize)
+{
+    auto path = m_paths.find(texture);
+    if (path != m_paths.end())
+        m_entries.at(path->second).screenSize = screenSize;
+}
+
+int TextureLoader::residentLevel(GLuint texture) const
+{
+    auto path = m_paths.find(texture);
+    return path == m_paths.end() ? -1 : m_entries.at(path->second).residentLevel;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "PixelUploadRing.h"
+#include "TextureCache.h"
+
+// Load 2D textures from image files (anything stb_image reads): the images are
+// decoded in parallel on a pool of worker threads, and the OpenGL textures are
+// created on the rendering thread (glTextureStorage2D / glTextureSubImage2D).
+// The images and their mip chains come from their TextureCache: after the first
+// launch, the workers only map the cache files. The workers then copy the levels
+// in a PixelUploadRing, and the rendering thread only issues the copies from it
+// (images that do not fit in the ring are uploaded from the cache).
+//
+// - acquire() returns the texture name at once; the texture gets its storage and
+//   its pixels in a later update() (or finish()), and stays incomplete until then.
+// - The textures are shared by path: acquiring the same file again returns the
+//   same texture and increases its reference count, release() decreases it and
+//   deletes the texture when it drops to zero.
+// - With setStreaming(true), the storage of the whole mip chain is allocated at
+//   once but only its small levels are uploaded first, the texture is then ready
+//   with GL_TEXTURE_BASE_LEVEL clamped to them. The finer levels follow over the
+//   next update() calls, the textures largest on screen first (see requestSize):
+//   the first frame no longer waits for the full resolution images.
+// - All the functions, except the constructor and the destructor, are called on
+//   the rendering thread, with the OpenGL context current.
+class TextureLoader
+{
+public:
+    static const std::size_t DefaultBudget = 8 << 20;
+    // Streamed textures: levels up to this size uploaded with the image
+    static const int StreamingTail = 64;
+
+    // Worker threads (0: one per hardware thread), size of the upload ring (0: no ring)
+    explicit TextureLoader(unsigned int numThreads = 0, std::size_t ringSize = PixelUploadRing::DefaultSize);
+    // Stop the worker threads (the OpenGL objects are not deleted here, see clear())
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // ------------------------------------------------------------------------
+    // texture of the image file, flipped so the first row is the bottom one
+    // (texture coordinates convention), stored as GL_RGBA8 or block compressed
+    // (see TextureCache::Format). The full mip chain of the cache is uploaded
+    // when minMode uses the mipmaps.
+    // The sampling modes are the ones of the first acquire of the path.
+    GLuint acquire(const std::string& path,
+        GLint uvMode = GL_REPEAT,                // UV/ST wrap mode
+        GLint minMode = GL_LINEAR_MIPMAP_LINEAR, // Minification
+        GLint magMode = GL_LINEAR,               // Magnification
+        TextureCache::ColorSpace colorSpace = TextureCache::ColorSpace::SRGB, // Filtering of the mip chain
+        TextureCache::Format format = TextureCache::Format::RGBA8);
+
+    // ------------------------------------------------------------------------
+    // give back a texture of acquire(); deleted when no longer used
+    void release(GLuint texture);
+
+    // ------------------------------------------------------------------------
+    // stream the mip chain of the textures acquired from now on (see above)
+    void setStreaming(bool streaming) { m_streaming = streaming; }
+    bool isStreaming() const { return m_streaming; }
+
+    // ------------------------------------------------------------------------
+    // on-screen size of a streamed texture in pixels, from the distance of the
+    // objects using it (Camera::projectedSize) or from its UV derivatives.
+    // Only the levels down to this size are streamed, the largest textures
+    // first. By default, the whole mip chain is streamed.
+    void requestSize(GLuint texture, float screenSize);
+    // Finest level uploaded so far (GL_TEXTURE_BASE_LEVEL), -1 until ready
+    int residentLevel(GLuint texture) const;
+
+    // ------------------------------------------------------------------------
+    // upload the images decoded so far, then the next levels of the streamed
+    // textures, about budgetBytes per call (at least one image or level)
+    // return the number of textures that became ready
+    std::size_t update(std::size_t budgetBytes = DefaultBudget);
+
+    // ------------------------------------------------------------------------
+    // wait for all the requested images and upload them (the streamed textures
+    // only get their small levels)
+    // return false if one of them cannot be loaded
+    bool finish();
+
+    // ------------------------------------------------------------------------
+    // delete all the textures (acquired or not) and the upload ring
+    void clear();
+
+    bool isReady(GLuint texture) const;
+    bool hasFailed(GLuint texture) const;
+    // Textures waiting for their image
+    std::size_t numPending() const { return m_numPending; }
+
+    // OpenGL internal format of the levels of a TextureCache format
+    static GLenum internalFormat(TextureCache::Format format);
+
+private:
+    enum class State { Loading, Ready, Failed };
+
+    // Image loaded by a worker (not loaded if it cannot be read)
+    struct Decoded
+    {
+        std::string path;
+        TextureCache cache;
+        bool staged = false;                  // Levels copied in the ring
+        std::size_t ringOffset = 0;
+        std::vector<std::size_t> levelOffsets; // From ringOffset
+    };
+
+    struct Entry
+    {
+        GLuint texture = 0;
+        int refCount = 0;
+        State state = State::Loading;
+        GLint minMode = GL_LINEAR; // Mip chain allocated for the mipmap filters
+        bool streaming = false;
+        int residentLevel = -1;    // Finest level uploaded (GL_TEXTURE_BASE_LEVEL)
+        float screenSize = std::numeric_limits<float>::infinity(); // See requestSize
+        std::shared_ptr<Decoded> source; // Streamed: image of the levels still to upload
+    };
+
+    struct Job
+    {
+        std::string path;
+        TextureCache::ColorSpace colorSpace;
+        TextureCache::Format format;
+        bool mipmaps;   // Whole mip chain uploaded
+        bool streaming; // Not staged: the levels are uploaded over several updates
+    };
+
+    // Worker threads
+    void run();
+
+    // Copy the levels of a loaded image in the ring (worker threads)
+    void stage(Decoded& image, bool mipmaps);
+
+    // Create the storage of the texture and fill it (only the small levels when
+    // streamed), return the uploaded bytes (rendering thread)
+    std::size_t upload(Entry& entry, const Decoded& image);
+    // Copy a level of the image to the texture, from its staged region, a new
+    // region of the ring or the cache. Return the uploaded bytes
+    std::size_t uploadLevel(GLuint texture, const Decoded& image, int level);
+    // Upload the queued images and mark their textures as ready or failed
+    std::size_t uploadQueued(std::size_t budgetBytes, std::size_t& uploaded);
+    // Upload the next levels of the streamed textures, the largest on screen first
+    void streamLevels(std::size_t budgetBytes, std::size_t& uploaded);
+    // Finest level a streamed texture needs for its size on screen
+    static int wantedLevel(const Entry& entry);
+
+private:
+    std::vector<std::thread> m_workers;
+
+    // Shared with the workers
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_imageDecoded;
+    std::deque<Job> m_jobs;         // Images to decode
+    std::vector<Decoded> m_decoded; // Waiting for update()
+    bool m_quit = false;
+    PixelUploadRing m_ring;         // Filled by the workers (thread safe)
+    std::size_t m_ringSize;
+
+    // Rendering thread only
+    std::unordered_map<std::string, Entry> m_entries;     // By path
+    std::unordered_map<GLuint, std::string> m_paths;      // Path of each texture
+    std::deque<Decoded> m_queued; // Waiting for their upload
+    std::size_t m_numPending = 0;
+    bool m_streaming = false;
+};
@@ -0,0 +1,188 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+
+TextureResidency::TextureResidency(int texturesPerMaterial, std::size_t budgetBytes) :
+    m_texturesPerMaterial(std::max(1, texturesPerMaterial)),
+    m_budget(budgetBytes),
+    m_fallbacks(std::size_t(m_texturesPerMaterial), -1)
+{
+}
+
+std::size_t TextureResidency::textureBytes(GLuint texture)
+{
+    GLint numLevels = 0;
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &numLevels);
+    std::size_t bytes = 0;
+    for (GLint l = 0; l < std::max(numLevels, 1); ++l) {
+        GLint width = 0, height = 0, compressed = 0;
+        glGetTextureLevelParameteriv(texture, l, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(texture, l, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureLevelParameteriv(texture, l, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTextureLevelParameteriv(texture, l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            bytes += std::size_t(size);
+        }
+        else {
+            bytes += std::size_t(width) * height * 4;
+        }
+    }
+    return bytes;
+}
+
+int TextureResidency::addTexture(GLuint texture, std::size_t bytes)
+{
+    Texture entry;
+    entry.handle = glGetTextureHandleARB(texture);
+    entry.bytes = bytes != 0 ? bytes : textureBytes(texture);
+    m_textures.push_back(entry);
+    return int(m_textures.size()) - 1;
+}
+
+int TextureResidency::addMaterial(const std::vector<int>& textures)
+{
+    for (int s = 0; s < m_texturesPerMaterial; ++s)
+        m_materials.push_back(s < int(textures.size()) ? textures[s] : -1);
+    return int(numMaterials()) - 1;
+}
+
+void TextureResidency::setFallback(int slot, int texture)
+{
+    Texture& entry = m_textures[texture];
+    entry.pinned = true;
+    if (!entry.resident)
+        makeResident(entry);
+    m_fallbacks[slot] = texture;
+}
+
+void TextureResidency::useMaterial(int material)
+{
+    m_used.push_back(material);
+}
+
+void TextureResidency::makeResident(Texture& texture)
+{
+    glMakeTextureHandleResidentARB(texture.handle);
+    texture.resident = true;
+    ++m_numResident;
+    m_residentBytes += texture.bytes;
+    ++m_madeResident;
+    ++m_churn;
+}
+
+void TextureResidency::makeNonResident(Texture& texture)
+{
+    glMakeTextureHandleNonResidentARB(texture.handle);
+    texture.resident = false;
+    --m_numResident;
+    m_residentBytes -= texture.bytes;
+    ++m_madeNonResident;
+    ++m_churn;
+}
+
+void TextureResidency::update()
+{
+    m_madeResident = 0;
+    m_madeNonResident = 0;
+
+    // Textures of this frame, in the order of their first use
+    std::vector<int> needed;
+    for (int material : m_used) {
+        for (int s = 0; s < m_texturesPerMaterial; ++s) {
+            const int texture = m_materials[std::size_t(material) * m_texturesPerMaterial + s];
+            if (texture >= 0 && m_textures[texture].lastUsed != m_frame) {
+                m_textures[texture].lastUsed = m_frame;
+                needed.push_back(texture);
+            }
+        }
+    }
+    m_used.clear();
+
+    // The ones that can make room: not used this frame, the least recently used first
+    std::vector<int> evictable;
+    for (int t = 0; t < int(m_textures.size()); ++t) {
+        const Texture& texture = m_textures[t];
+        if (texture.resident && !texture.pinned && texture.lastUsed < m_frame)
+            evictable.push_back(t);
+    }
+    std::sort(evictable.begin(), evictable.end(),
+        [this](int a, int b) { return m_textures[a].lastUsed < m_textures[b].lastUsed; });
+    std::size_t next = 0;
+
+    for (int t : needed) {
+        Texture& texture = m_textures[t];
+        if (texture.resident)
+            continue;
+        while (m_residentBytes + texture.bytes > m_budget && next < evictable.size())
+            makeNonResident(m_textures[evictable[next++]]);
+        // Still too large: sampled through the fallback until the budget has room
+        if (m_residentBytes + texture.bytes <= m_budget)
+            makeResident(texture);
+    }
+    // The budget was lowered: then down to the textures of this frame, the last used first
+    while (m_residentBytes > m_budget && next < evictable.size())
+        makeNonResident(m_textures[evictable[next++]]);
+    for (auto t = needed.rbegin(); m_residentBytes > m_budget && t != needed.rend(); ++t) {
+        Texture& texture = m_textures[*t];
+        if (texture.resident && !texture.pinned)
+            makeNonResident(texture);
+    }
+
+    // Publish the handles, or the ones of the fallbacks
+    std::vector<GLuint64> published(m_materials.size(), 0);
+    for (std::size_t i = 0; i < m_materials.size(); ++i) {
+        const int texture = m_materials[i];
+        const int fallback = m_fallbacks[i % m_texturesPerMaterial];
+        if (texture >= 0 && m_textures[texture].resident)
+            published[i] = m_textures[texture].handle;
+        else if (fallback >= 0)
+            published[i] = m_textures[fallback].handle;
+    }
+    if (numMaterials() > m_bufferCapacity) {
+        if (m_buffer != 0)
+            glDeleteBuffers(1, &m_buffer);
+        m_bufferCapacity = std::max(numMaterials(), m_bufferCapacity * 2);
+        glCreateBuffers(1, &m_buffer);
+        glNamedBufferStorage(m_buffer, GLsizeiptr(m_bufferCapacity * m_texturesPerMaterial * sizeof(GLuint64)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        m_published.clear();
+    }
+    // Only the range that changed
+    std::size_t first = 0;
+    std::size_t last = published.size();
+    if (m_published.size() == published.size()) {
+        while (first < last && published[first] == m_published[first])
+            ++first;
+        while (last > first && published[last - 1] == m_published[last - 1])
+            --last;
+    }
+    if (first < last)
+        glNamedBufferSubData(m_buffer, GLintptr(first * sizeof(GLuint64)), GLsizeiptr((last - first) * sizeof(GLuint64)), published.data() + first);
+    m_published = std::move(published);
+
+    ++m_frame;
+}
+
+void TextureResidency::bind(GLuint binding) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_buffer);
+}
+
+void TextureResidency::clear()
+{
+    for (Texture& texture : m_textures) {
+        if (texture.resident)
+            glMakeTextureHandleNonResidentARB(texture.handle);
+    }
+    if (m_buffer != 0)
+        glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+    m_bufferCapacity = 0;
+    m_textures.clear();
+    m_materials.clear();
+    m_fallbacks.assign(std::size_t(m_texturesPerMaterial), -1);
+    m_used.clear();
+    m_published.clear();
+    m_numResident = 0;
+    m_residentBytes = 0;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bindless textures (ARB_bindless_texture) of many materials, made resident on
+// demand within a memory budget, and published to the shaders in a material
+// shader storage buffer:
+//
+//     struct Material { uvec2 textures[texturesPerMaterial]; }; // sampler2D(textures[i])
+//     layout(std430, binding = ...) readonly buffer Materials { Material materials[]; };
+//
+// - The handle of each texture is created once by addTexture (its sampling
+//   parameters can no longer change). Only the resident handles may be sampled.
+// - Each frame, useMaterial() marks the materials of the draws, then update()
+//   makes their textures resident, in the order of the calls. Above the budget,
+//   the resident textures the least recently used are made non-resident (LRU),
+//   not the ones of the current frame: what still does not fit waits for a
+//   later frame. Only a lowered budget evicts textures of the current frame.
+// - A material whose texture is not resident gets the fallback texture of its
+//   slot instead (always resident), so the draws never sample a non-resident
+//   handle. The draws then only need the index of their material, without any
+//   texture binding.
+// - All the functions are called on the rendering thread.
+class TextureResidency
+{
+public:
+    static const std::size_t DefaultBudget = 256 << 20;
+
+    explicit TextureResidency(int texturesPerMaterial = 2, std::size_t budgetBytes = DefaultBudget);
+    // The handles are not released here, see clear()
+    ~TextureResidency() = default;
+
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+    // ------------------------------------------------------------------------
+    // register a texture with its complete storage, return its index.
+    // bytes: video memory used by the texture (0: computed from its levels)
+    int addTexture(GLuint texture, std::size_t bytes = 0);
+    // ------------------------------------------------------------------------
+    // register a material (one texture index by slot), return its index
+    int addMaterial(const std::vector<int>& textures);
+    // ------------------------------------------------------------------------
+    // texture of a slot while the one of a material is not resident (kept resident)
+    void setFallback(int slot, int texture);
+
+    // ------------------------------------------------------------------------
+    // the material is used by a draw of this frame
+    void useMaterial(int material);
+    // ------------------------------------------------------------------------
+    // make the textures of the used materials resident, evict within the budget,
+    // then upload the changed materials and start a new frame
+    void update();
+    // ------------------------------------------------------------------------
+    // bind the material buffer to a GL_SHADER_STORAGE_BUFFER binding point
+    void bind(GLuint binding) const;
+
+    // ------------------------------------------------------------------------
+    // make all the handles non-resident and delete the material buffer
+    // (the textures belong to the caller)
+    void clear();
+
+    void setBudget(std::size_t budgetBytes) { m_budget = budgetBytes; }
+    std::size_t budget() const { return m_budget; }
+    GLuint64 handle(int texture) const { return m_textures[texture].handle; }
+    bool isResident(int texture) const { return m_textures[texture].resident; }
+
+    std::size_t numTextures() const { return m_textures.size(); }
+    std::size_t numMaterials() const { return m_materials.size() / m_texturesPerMaterial; }
+    std::size_t numResident() const { return m_numResident; }
+    std::size_t residentBytes() const { return m_residentBytes; }
+    // Residency changes of the last update, and since the start
+    std::size_t madeResident() const { return m_madeResident; }
+    std::size_t madeNonResident() const { return m_madeNonResident; }
+    std::size_t churn() const { return m_churn; }
+
+    // Video memory of a texture, from the sizes of its levels (compressed or RGBA8)
+    static std::size_t textureBytes(GLuint texture);
+
+private:
+    struct Texture
+    {
+        GLuint64 handle = 0;
+        std::size_t bytes = 0;
+        std::uint64_t lastUsed = 0; // Frame of the last draw using it
+        bool resident = false;
+        bool pinned = false;        // Fallback
+    };
+
+    void makeResident(Texture& texture);
+    void makeNonResident(Texture& texture);
+
+private:
+    int m_texturesPerMaterial;
+    std::size_t m_budget;
+
+    std::vector<Texture> m_textures;
+    std::vector<int> m_materials;         // Texture indices, texturesPerMaterial by material
+    std::vector<int> m_fallbacks;         // Texture index by slot (-1: none)
+    std::vector<int> m_used;              // Materials used this frame
+    std::vector<GLuint64> m_published;    // Content of the material buffer
+    GLuint m_buffer = 0;
+    std::size_t m_bufferCapacity = 0;     // In materials
+
+    std::uint64_t m_frame = 1;
+    std::size_t m_numResident = 0;
+    std::size_t m_residentBytes = 0;
+    std::size_t m_madeResident = 0;
+    std::size_t m_madeNonResident = 0;
+    std::size_t m_churn = 0;
+};
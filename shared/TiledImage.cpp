@@ -0,0 +1,221 @@
+#include "TiledImage.h"
+#include "CacheFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    // File layout (native endianness, the file is a local cache):
+    //   FileHeader
+    //   LevelRecord[numLevels]
+    //   pages of all the levels, row by row, from pagesOffset (each one aligned on BlobAlignment bytes)
+    const char          Magic[8] = { 'T', 'E', 'X', 'T', 'I', 'L', 'E', 'S' };
+    const std::uint32_t Version = 1;
+    const std::size_t   BlobAlignment = 64;
+
+    struct FileHeader
+    {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t colorSpace;
+        std::uint64_t sourceSize;
+        std::int64_t  sourceTime;
+        std::uint32_t pageSize;
+        std::uint32_t border;
+        std::uint32_t numLevels;
+        std::uint32_t numPages;
+        std::uint64_t pagesOffset;
+    };
+
+    struct LevelRecord
+    {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t pagesX;
+        std::uint32_t pagesY;
+        std::uint64_t firstPage;
+    };
+
+    // Content of the tiles file: the pages of each level of the mip chain, with their border
+    void buildTiles(const TextureCache& cache, int pageSize, int border, FileHeader header, std::vector<char>& buffer)
+    {
+        std::vector<LevelRecord> records;
+        std::uint64_t numPages = 0;
+        for (const TextureCache::Level& level : cache.levels()) {
+            LevelRecord r;
+            r.width = std::uint32_t(level.width);
+            r.height = std::uint32_t(level.height);
+            r.pagesX = std::uint32_t((level.width + pageSize - 1) / pageSize);
+            r.pagesY = std::uint32_t((level.height + pageSize - 1) / pageSize);
+            r.firstPage = numPages;
+            records.push_back(r);
+            numPages += std::uint64_t(r.pagesX) * r.pagesY;
+            // The coarser levels are never paged
+            if (r.pagesX == 1 && r.pagesY == 1)
+                break;
+        }
+
+        const int slotSize = pageSize + 2 * border;
+        const std::size_t pageBytes = std::size_t(slotSize) * slotSize * 4;
+        const std::size_t pageStride = CacheFile::alignUp(pageBytes, BlobAlignment);
+        header.pageSize = std::uint32_t(pageSize);
+        header.border = std::uint32_t(border);
+        header.numLevels = std::uint32_t(records.size());
+        header.numPages = std::uint32_t(numPages);
+        header.pagesOffset = CacheFile::alignUp(sizeof(FileHeader) + records.size() * sizeof(LevelRecord), BlobAlignment);
+
+        buffer.assign(header.pagesOffset + numPages * pageStride, 0);
+        std::memcpy(buffer.data(), &header, sizeof(FileHeader));
+        std::memcpy(buffer.data() + sizeof(FileHeader), records.data(), records.size() * sizeof(LevelRecord));
+
+        for (std::size_t l = 0; l < records.size(); ++l) {
+            const TextureCache::Level& level = cache.levels()[l];
+            const LevelRecord& r = records[l];
+            for (std::uint32_t py = 0; py < r.pagesY; ++py) {
+                for (std::uint32_t px = 0; px < r.pagesX; ++px) {
+                    char* dest = buffer.data() + header.pagesOffset + (r.firstPage + std::uint64_t(py) * r.pagesX + px) * pageStride;
+                    for (int y = 0; y < slotSize; ++y) {
+                        // Wrap around: the border of the edge pages comes from the opposite edge
+                        const int ly = ((int(py) * pageSize + y - border) % level.height + level.height) % level.height;
+                        for (int x = 0; x < slotSize; ++x) {
+                            const int lx = ((int(px) * pageSize + x - border) % level.width + level.width) % level.width;
+                            std::memcpy(dest + (std::size_t(y) * slotSize + x) * 4, level.pixels + (std::size_t(ly) * level.width + lx) * 4, 4);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tiles file associated with an image file
+std::string TiledImage::tilesFilename(const std::string& imageFilename)
+{
+    return imageFilename + ".tiles";
+}
+
+const unsigned char* TiledImage::page(int level, int x, int y) const
+{
+    const Level& l = m_levels[level];
+    return reinterpret_cast<const unsigned char*>(m_pages + (l.firstPage + std::size_t(y) * l.pagesX + x) * m_pageStride);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Open the tiles file, (re)building it when needed
+bool TiledImage::load(const std::string& imageFilename, TextureCache::ColorSpace colorSpace, int pageSize, int border)
+{
+    if (open(imageFilename, colorSpace, pageSize, border))
+        return true;
+
+    // Missing or outdated: cut the levels of the image, decoded and filtered by a
+    // TextureCache (in memory: its cache file may be the one of another format)
+    FileHeader header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.colorSpace = std::uint32_t(colorSpace);
+    if (pageSize <= 0 || border < 0 || !CacheFile::sourceStamp(imageFilename, header.sourceSize, header.sourceTime))
+        return false;
+    TextureCache cache;
+    if (!cache.decode(imageFilename, colorSpace))
+        return false;
+
+    std::vector<char> buffer;
+    buildTiles(cache, pageSize, border, header, buffer);
+    cache.unload();
+
+    if (CacheFile::writeOrKeep(tilesFilename(imageFilename), buffer, m_memory))
+        return open(imageFilename, colorSpace, pageSize, border);
+
+    // Read-only directory: the pages are used from memory
+    return parse(m_memory.data(), m_memory.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the tiles file
+bool TiledImage::open(const std::string& imageFilename, TextureCache::ColorSpace colorSpace, int pageSize, int border)
+{
+    unload();
+
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceTime = 0;
+    if (!CacheFile::sourceStamp(imageFilename, sourceSize, sourceTime))
+        return false;
+
+    const std::string filename = tilesFilename(imageFilename);
+    std::error_code ec;
+    if (!std::filesystem::exists(filename, ec))
+        return false;
+    if (!m_file.open(filename))
+        return false;
+
+    // Validate the header
+    FileHeader header;
+    if (m_file.size() < sizeof(FileHeader)) {
+        unload();
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(FileHeader));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        std::cout << "Warning: Invalid texture tiles " << filename << std::endl;
+        unload();
+        return false;
+    }
+    if (header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+        header.colorSpace != std::uint32_t(colorSpace) ||
+        header.pageSize != std::uint32_t(pageSize) || header.border != std::uint32_t(border)) {
+        // Outdated
+        unload();
+        return false;
+    }
+
+    if (!parse(m_file.data(), m_file.size())) {
+        std::cout << "Warning: Truncated texture tiles " << filename << std::endl;
+        unload();
+        return false;
+    }
+    return true;
+}
+
+bool TiledImage::parse(const char* data, std::size_t size)
+{
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(FileHeader));
+    if (header.numLevels == 0 || header.pageSize == 0 ||
+        !CacheFile::inFile(sizeof(FileHeader), header.numLevels * sizeof(LevelRecord), size))
+        return false;
+
+    m_pageSize = int(header.pageSize);
+    m_border = int(header.border);
+    m_pageStride = CacheFile::alignUp(pageBytes(), BlobAlignment);
+    m_numPages = header.numPages;
+    if (!CacheFile::inFile(header.pagesOffset, std::uint64_t(m_numPages) * m_pageStride, size))
+        return false;
+    m_pages = data + header.pagesOffset;
+
+    for (std::uint32_t l = 0; l < header.numLevels; ++l) {
+        LevelRecord r;
+        std::memcpy(&r, data + sizeof(FileHeader) + l * sizeof(LevelRecord), sizeof(LevelRecord));
+        if (r.pagesX == 0 || r.pagesY == 0 || r.firstPage + std::uint64_t(r.pagesX) * r.pagesY > m_numPages) {
+            m_levels.clear();
+            return false;
+        }
+        m_levels.push_back({ int(r.width), int(r.height), int(r.pagesX), int(r.pagesY), std::size_t(r.firstPage) });
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Clear data
+void TiledImage::unload()
+{
+    m_levels.clear();
+    m_memory.clear();
+    m_file.close();
+    m_pages = nullptr;
+    m_numPages = 0;
+}
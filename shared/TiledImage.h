@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureCache.h"
+
+// Image cut in square pages for the virtual textures (see VirtualTexture), stored
+// in a file written next to the image ("image.png.tiles") the first time it is loaded.
+//
+// - The levels are decoded and filtered by TextureCache (RGBA8, flipped so the
+//   first row is the bottom one), from the full size down to the first level
+//   held by a single page.
+// - Each page is pageSize x pageSize texels of a level, surrounded by a border of
+//   the neighbouring texels (wrapping around the edges of the level, like
+//   GL_REPEAT) so it is filtered without seams once copied in a slot of the
+//   physical texture. The pages are stored raw at aligned offsets: the file is
+//   mapped and a page is uploaded as is, without decoding anything.
+// - The file is outdated (and rebuilt by load) when the size or the modification
+//   time of the image changes, or for another color space or page layout.
+class TiledImage
+{
+public:
+    struct Level
+    {
+        int width;             // In texels
+        int height;
+        int pagesX;            // Pages of the level, the last ones partially used
+        int pagesY;
+        std::size_t firstPage; // Index of the page (0, 0), the pages are stored row by row
+    };
+
+    // ------------------------------------------------------------------------
+    // open the pages of an image file, (re)building them from the image when needed.
+    // If the file cannot be written, the pages are kept in memory.
+    bool load(const std::string& imageFilename, TextureCache::ColorSpace colorSpace, int pageSize = 128, int border = 1);
+    // map the pages of an image file. Fails if the file is missing, invalid or outdated.
+    bool open(const std::string& imageFilename, TextureCache::ColorSpace colorSpace, int pageSize = 128, int border = 1);
+    bool isLoaded() const { return !m_levels.empty(); }
+    void unload();
+
+    // From the full size to the single page
+    const std::vector<Level>& levels() const { return m_levels; }
+    int pageSize() const { return m_pageSize; }
+    int border() const { return m_border; }
+    // Texels of a stored page on each side (border included)
+    int slotSize() const { return m_pageSize + 2 * m_border; }
+    // RGBA8 texels of a stored page, tightly packed
+    std::size_t pageBytes() const { return std::size_t(slotSize()) * slotSize() * 4; }
+    std::size_t numPages() const { return m_numPages; }
+    // Texels of a page, the first row is the bottom one (border included)
+    const unsigned char* page(int level, int x, int y) const;
+
+    // Tiles file associated with an image file
+    static std::string tilesFilename(const std::string& imageFilename);
+
+private:
+    // Point the levels in the content of a tiles file (mapped or in memory)
+    // once its header is validated
+    bool parse(const char* data, std::size_t size);
+
+private:
+    MappedFile m_file;
+    std::vector<char> m_memory; // Content of the file when it cannot be written
+    std::vector<Level> m_levels;
+    const char* m_pages = nullptr;
+    std::size_t m_pageStride = 0;
+    std::size_t m_numPages = 0;
+    int m_pageSize = 0;
+    int m_border = 0;
+};
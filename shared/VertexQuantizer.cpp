@@ -0,0 +1,145 @@
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace OBJLoader;
+
+namespace
+{
+  // Extent of the box on each axis (1 on flat axes, so the division stays valid)
+  float extent(const Bounds& bounds, int k)
+  {
+    const float e = bounds.max[k] - bounds.min[k];
+    return (e > 0.0f) ? e : 1.0f;
+  }
+
+  std::int16_t toSnorm16(float v)
+  {
+    return static_cast<std::int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Quantize vertices relative to a box
+std::vector<QuantizedVertex> OBJLoader::quantizeVertices(const Vertex* vertices, std::size_t count, const Bounds& bounds)
+{
+  std::vector<QuantizedVertex> quantized(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const Vertex& v = vertices[i];
+    QuantizedVertex& q = quantized[i];
+    for (int k = 0; k < 3; ++k)
+    {
+      const float t = (v.position[k] - bounds.min[k]) / extent(bounds, k);
+      q.position[k] = static_cast<std::uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+    q.padding = 0;
+
+    float e[2];
+    octahedralEncode(v.normal, e);
+    q.normal[0] = toSnorm16(e[0]);
+    q.normal[1] = toSnorm16(e[1]);
+
+    q.uv[0] = floatToHalf(v.uv[0]);
+    q.uv[1] = floatToHalf(v.uv[1]);
+  }
+  return quantized;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Transform from the quantized positions to the original ones
+void OBJLoader::dequantizationTransform(const Bounds& bounds, float offset[3], float scale[3])
+{
+  for (int k = 0; k < 3; ++k)
+  {
+    offset[k] = bounds.min[k];
+    scale[k] = extent(bounds, k);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Octahedral encoding: project on the octahedron |x| + |y| + |z| = 1, then fold the lower half
+void OBJLoader::octahedralEncode(const float n[3], float e[2])
+{
+  const float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+  if (l1 == 0.0f)
+  {
+    e[0] = e[1] = 0.0f;
+    return;
+  }
+  float x = n[0] / l1, y = n[1] / l1;
+  if (n[2] < 0.0f)
+  {
+    const float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = fx;
+    y = fy;
+  }
+  e[0] = x;
+  e[1] = y;
+}
+
+void OBJLoader::octahedralDecode(const float e[2], float n[3])
+{
+  n[0] = e[0];
+  n[1] = e[1];
+  n[2] = 1.0f - std::abs(e[0]) - std::abs(e[1]);
+  const float t = std::max(-n[2], 0.0f);
+  n[0] += (n[0] >= 0.0f) ? -t : t;
+  n[1] += (n[1] >= 0.0f) ? -t : t;
+  const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  for (int k = 0; k < 3; ++k)
+    n[k] /= length;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Half floats
+std::uint16_t OBJLoader::floatToHalf(float value)
+{
+  std::uint32_t f;
+  std::memcpy(&f, &value, sizeof(f));
+  const std::uint16_t sign = static_cast<std::uint16_t>((f >> 16) & 0x8000);
+  const std::uint32_t absolute = f & 0x7FFFFFFF;
+
+  if (absolute >= 0x7F800000) // Inf or NaN
+    return sign | 0x7C00 | ((absolute > 0x7F800000) ? 0x200 : 0);
+  if (absolute >= 0x477FF000) // Rounds above the largest half (65504)
+    return sign | 0x7C00;
+  if (absolute < 0x38800000) // Subnormal half (or zero)
+  {
+    float magnitude;
+    std::memcpy(&magnitude, &absolute, sizeof(magnitude));
+    return sign | static_cast<std::uint16_t>(std::lrint(magnitude * 16777216.0f)); // 2^24
+  }
+
+  // Normal: rebias the exponent, round the mantissa to nearest even
+  const std::uint32_t rounded = absolute + 0xFFF + ((absolute >> 13) & 1);
+  return sign | static_cast<std::uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+float OBJLoader::halfToFloat(std::uint16_t value)
+{
+  const std::uint32_t sign = std::uint32_t(value & 0x8000) << 16;
+  const std::uint32_t exponent = (value >> 10) & 0x1F;
+  const std::uint32_t mantissa = value & 0x3FF;
+
+  float magnitude;
+  if (exponent == 0)
+  {
+    magnitude = float(mantissa) / 16777216.0f; // 2^24
+  }
+  else
+  {
+    const std::uint32_t f = (exponent == 0x1F) ? (0x7F800000 | (mantissa << 13)) : (((exponent + 112) << 23) | (mantissa << 13));
+    std::memcpy(&magnitude, &f, sizeof(magnitude));
+  }
+
+  std::uint32_t f;
+  std::memcpy(&f, &magnitude, sizeof(f));
+  f |= sign;
+  float result;
+  std::memcpy(&result, &f, sizeof(result));
+  return result;
+}
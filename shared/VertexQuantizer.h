@@ -0,0 +1,48 @@
+#ifndef VERTEXQUANTIZER_H
+#define VERTEXQUANTIZER_H
+
+#include "OBJLoader.h"
+
+namespace OBJLoader
+{
+  // Compact version of Vertex (16 bytes instead of 32) for the GPU vertex buffers:
+  // - position: 16 bit unsigned normalized, relative to a box (see quantizeVertices),
+  // - normal: octahedral encoding, 2 x 16 bit signed normalized,
+  // - uv: half floats.
+  // Vertex shader decoding (attributes: position GL_UNSIGNED_SHORT normalized,
+  // normal GL_SHORT normalized, uv GL_HALF_FLOAT):
+  //
+  //   in vec3 vPosition; // In [0, 1]: apply dequantizationTransform (e.g. in the model matrix)
+  //   in vec2 vNormal;
+  //   vec3 octDecode(vec2 e) {
+  //     vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  //     float t = max(-n.z, 0.0);
+  //     n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  //     return normalize(n);
+  //   }
+  struct QuantizedVertex
+  {
+    std::uint16_t position[3];
+    std::uint16_t padding;     // Keeps the vertices 4 bytes aligned
+    std::int16_t  normal[2];
+    std::uint16_t uv[2];
+  };
+
+  // Quantize vertices with positions inside bounds (usually the bounds of the mesh, or of all
+  // the meshes of a file so the vertices they share stay at the same place)
+  std::vector<QuantizedVertex> quantizeVertices(const Vertex* vertices, std::size_t count, const Bounds& bounds);
+
+  // Transform from the quantized positions (in [0, 1]) to the original ones:
+  // position = offset + scale * quantized (translate(offset) * scale(scale) as a matrix)
+  void dequantizationTransform(const Bounds& bounds, float offset[3], float scale[3]);
+
+  // Unit vector to/from its octahedral encoding (2 values in [-1, 1])
+  void octahedralEncode(const float n[3], float e[2]);
+  void octahedralDecode(const float e[2], float n[3]);
+
+  // IEEE 754 half float conversions (rounded to nearest)
+  std::uint16_t floatToHalf(float value);
+  float halfToFloat(std::uint16_t value);
+}
+
+#endif // VERTEXQUANTIZER_H
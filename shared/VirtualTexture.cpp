@@ -0,0 +1,402 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    int pageLevel(std::uint32_t page) { return int(page >> 24) - 1; }
+    int pageX(std::uint32_t page) { return int(page & 0xFFF); }
+    int pageY(std::uint32_t page) { return int((page >> 12) & 0xFFF); }
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    if (m_worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_feedbackAvailable.notify_all();
+        m_worker.join();
+    }
+}
+
+bool VirtualTexture::create(const std::vector<Layer>& layers, int slotsX, int slotsY, int pageSize)
+{
+    destroy();
+    if (layers.empty() || slotsX <= 0 || slotsY <= 0 || slotsX > 256 || slotsY > 256 || slotsX * slotsY < 2) {
+        std::cerr << "Invalid virtual texture layout" << std::endl;
+        return false;
+    }
+
+    // Pages of the layers, built from the images the first time
+    m_layers.resize(layers.size());
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        if (!m_layers[i].load(layers[i].path, layers[i].colorSpace, pageSize)) {
+            std::cerr << "Unable to load the virtual texture layer: " << layers[i].path << std::endl;
+            m_layers.clear();
+            return false;
+        }
+    }
+    const std::vector<TiledImage::Level>& levels = m_layers[0].levels();
+    const int numLevels = int(levels.size());
+    for (const TiledImage& layer : m_layers) {
+        const std::vector<TiledImage::Level>& other = layer.levels();
+        if (other.size() != levels.size() || other[0].width != levels[0].width || other[0].height != levels[0].height) {
+            std::cerr << "The layers of a virtual texture must have the same size" << std::endl;
+            m_layers.clear();
+            return false;
+        }
+    }
+    const int last = numLevels - 1;
+    if (numLevels > MaxLevels || levels[0].pagesX > 4096 || levels[0].pagesY > 4096 ||
+        levels[0].width % (1 << last) != 0 || levels[0].height % (1 << last) != 0) {
+        std::cerr << "Unsupported virtual texture size: " << levels[0].width << "x" << levels[0].height << std::endl;
+        m_layers.clear();
+        return false;
+    }
+
+    // Physical textures: the slots side by side, each page with its border
+    const int slotSize = m_layers[0].slotSize();
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (slotsX * slotSize > maxSize || slotsY * slotSize > maxSize) {
+        std::cerr << "Virtual texture physical size larger than GL_MAX_TEXTURE_SIZE" << std::endl;
+        m_layers.clear();
+        return false;
+    }
+    m_slotsX = slotsX;
+    m_slotsY = slotsY;
+    m_physical.resize(m_layers.size());
+    glCreateTextures(GL_TEXTURE_2D, GLsizei(m_physical.size()), m_physical.data());
+    for (GLuint texture : m_physical) {
+        glTextureStorage2D(texture, 1, GL_RGBA8, slotsX * slotSize, slotsY * slotSize);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // Page table: the levels side by side, from the full size
+    m_tableOffsets.clear();
+    m_tableWidth = 0;
+    for (const TiledImage::Level& level : levels) {
+        m_tableOffsets.push_back(m_tableWidth);
+        m_tableWidth += level.pagesX;
+    }
+    m_tableHeight = levels[0].pagesY;
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_pageTable);
+    glTextureStorage2D(m_pageTable, 1, GL_RGBA8UI, m_tableWidth, m_tableHeight);
+    glTextureParameteri(m_pageTable, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_pageTable, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(m_pageTable, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_pageTable, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // The coarsest page, in the first slot for good: the fallback of all the others
+    m_slots.assign(std::size_t(slotsX) * slotsY, Slot());
+    const std::uint32_t root = encodePage(last, 0, 0);
+    for (std::size_t i = 0; i < m_layers.size(); ++i) {
+        glTextureSubImage2D(m_physical[i], 0, 0, 0, slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, m_layers[i].page(last, 0, 0));
+    }
+    m_table.assign(std::size_t(m_tableWidth) * m_tableHeight * 4, 255);
+    m_slots[0].page = root;
+    m_resident[root] = 0;
+    m_known.insert(root);
+    mapPage(root, 0);
+    uploadTable();
+
+    m_ring.create(RingSize);
+    m_quit = false;
+    m_worker = std::thread(&VirtualTexture::run, this);
+    return true;
+}
+
+void VirtualTexture::destroy()
+{
+    if (m_worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_feedbackAvailable.notify_all();
+        m_worker.join();
+    }
+
+    for (const Loaded& page : m_loaded)
+        m_ring.discard(page.ringOffset);
+    m_loaded.clear();
+    m_ring.destroy();
+
+    if (!m_physical.empty())
+        glDeleteTextures(GLsizei(m_physical.size()), m_physical.data());
+    if (m_pageTable != 0)
+        glDeleteTextures(1, &m_pageTable);
+    m_physical.clear();
+    m_pageTable = 0;
+    m_layers.clear();
+    m_feedback.clear();
+    m_hasFeedback = false;
+    m_known.clear();
+    m_requested.clear();
+    m_hasRequested = false;
+    m_slots.clear();
+    m_resident.clear();
+    m_table.clear();
+    m_tableOffsets.clear();
+    m_tableDirty = false;
+    m_frame = 0;
+    m_numEvictions = 0;
+    m_numRequested = 0;
+}
+
+void VirtualTexture::requestPages(const std::vector<std::uint32_t>& feedback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_feedback = feedback;
+        m_hasFeedback = true;
+    }
+    m_feedbackAvailable.notify_one();
+}
+
+std::size_t VirtualTexture::layerStride() const
+{
+    const std::size_t bytes = m_layers[0].pageBytes();
+    return (bytes + PixelUploadRing::Alignment - 1) / PixelUploadRing::Alignment * PixelUploadRing::Alignment;
+}
+
+void VirtualTexture::run()
+{
+    const std::vector<TiledImage::Level>& levels = m_layers[0].levels();
+    const int numLevels = int(levels.size());
+    const std::size_t stride = layerStride();
+
+    for (;;) {
+        std::vector<std::uint32_t> feedback;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_feedbackAvailable.wait(lock, [this] { return m_quit || m_hasFeedback; });
+            if (m_quit)
+                return;
+            feedback.swap(m_feedback);
+            m_hasFeedback = false;
+        }
+
+        // The requested pages, and their ancestors: the fallbacks of the shaders until the pages arrive
+        std::sort(feedback.begin(), feedback.end());
+        feedback.erase(std::unique(feedback.begin(), feedback.end()), feedback.end());
+        std::vector<std::uint32_t> pages;
+        for (std::uint32_t page : feedback) {
+            const int level = pageLevel(page);
+            const int x = pageX(page);
+            const int y = pageY(page);
+            if (page == 0 || level < 0 || level >= numLevels || x >= levels[level].pagesX || y >= levels[level].pagesY)
+                continue;
+            for (int l = level; l < numLevels; ++l)
+                pages.push_back(encodePage(l, x >> (l - level), y >> (l - level)));
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+        // The missing ones, the coarse levels first
+        std::vector<std::uint32_t> missing;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (std::uint32_t page : pages) {
+                if (m_known.count(page) == 0)
+                    missing.push_back(page);
+            }
+        }
+        std::stable_sort(missing.begin(), missing.end(),
+            [](std::uint32_t a, std::uint32_t b) { return pageLevel(a) > pageLevel(b); });
+
+        // Copied from the mapped tiles files until the ring is full (the others are requested again by the next feedbacks)
+        std::vector<Loaded> loaded;
+        for (std::uint32_t page : missing) {
+            std::size_t offset = 0;
+            if (!m_ring.allocate(stride * m_layers.size(), offset))
+                break;
+            for (std::size_t i = 0; i < m_layers.size(); ++i)
+                std::memcpy(m_ring.data(offset + i * stride), m_layers[i].page(pageLevel(page), pageX(page), pageY(page)), m_layers[i].pageBytes());
+            loaded.push_back({ page, offset });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const Loaded& page : loaded) {
+                m_known.insert(page.page);
+                m_loaded.push_back(page);
+            }
+            m_requested = std::move(pages);
+            m_hasRequested = true;
+        }
+    }
+}
+
+std::size_t VirtualTexture::update(std::size_t maxPages)
+{
+    if (!isCreated())
+        return 0;
+    m_ring.reclaim();
+
+    std::vector<std::uint32_t> requested;
+    bool hasRequested = false;
+    std::vector<Loaded> loaded;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_hasRequested) {
+            requested.swap(m_requested);
+            hasRequested = true;
+            m_hasRequested = false;
+        }
+        while (!m_loaded.empty() && loaded.size() < maxPages) {
+            loaded.push_back(m_loaded.front());
+            m_loaded.pop_front();
+        }
+    }
+
+    // The resident pages still requested are the most recently used
+    if (hasRequested) {
+        ++m_frame;
+        m_numRequested = requested.size();
+        for (std::uint32_t page : requested) {
+            auto found = m_resident.find(page);
+            if (found != m_resident.end())
+                m_slots[found->second].lastUsed = m_frame;
+        }
+    }
+
+    const int slotSize = m_layers[0].slotSize();
+    const std::size_t stride = layerStride();
+    std::size_t uploaded = 0;
+    if (!loaded.empty())
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_ring.buffer());
+    for (const Loaded& page : loaded) {
+        const int slot = findSlot();
+        if (slot < 0) {
+            // All the slots are used by the last feedback: loaded again while it is still requested
+            m_ring.discard(page.ringOffset);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_known.erase(page.page);
+            continue;
+        }
+        if (m_slots[slot].page != 0) {
+            const std::uint32_t evicted = m_slots[slot].page;
+            unmapPage(evicted);
+            m_resident.erase(evicted);
+            ++m_numEvictions;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_known.erase(evicted);
+        }
+
+        // The pixels are an offset in the ring, the driver copies them asynchronously
+        const int x = (slot % m_slotsX) * slotSize;
+        const int y = (slot / m_slotsX) * slotSize;
+        for (std::size_t i = 0; i < m_physical.size(); ++i) {
+            glTextureSubImage2D(m_physical[i], 0, x, y, slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                reinterpret_cast<const void*>(page.ringOffset + i * stride));
+        }
+        m_ring.retire(page.ringOffset);
+
+        m_slots[slot].page = page.page;
+        m_slots[slot].lastUsed = m_frame;
+        m_resident[page.page] = slot;
+        mapPage(page.page, slot);
+        ++uploaded;
+    }
+    if (!loaded.empty())
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (m_tableDirty)
+        uploadTable();
+    return uploaded;
+}
+
+int VirtualTexture::findSlot() const
+{
+    // The first slot holds the coarsest page
+    int best = -1;
+    std::uint64_t bestUsed = m_frame;
+    for (int i = 1; i < int(m_slots.size()); ++i) {
+        if (m_slots[i].page == 0)
+            return i;
+        if (m_slots[i].lastUsed < bestUsed) {
+            best = i;
+            bestUsed = m_slots[i].lastUsed;
+        }
+    }
+    return best;
+}
+
+unsigned char* VirtualTexture::tableEntry(int level, int x, int y)
+{
+    return &m_table[(std::size_t(y) * m_tableWidth + m_tableOffsets[level] + x) * 4];
+}
+
+void VirtualTexture::mapPage(std::uint32_t page, int slot)
+{
+    const std::vector<TiledImage::Level>& levels = m_layers[0].levels();
+    const int level = pageLevel(page);
+    const unsigned char entry[4] = { (unsigned char)(slot % m_slotsX), (unsigned char)(slot / m_slotsX), (unsigned char)level, 0 };
+
+    // The page covers 2^d x 2^d pages of the level d times finer
+    for (int l = level; l >= 0; --l) {
+        const int d = level - l;
+        const int xEnd = std::min((pageX(page) + 1) << d, levels[l].pagesX);
+        const int yEnd = std::min((pageY(page) + 1) << d, levels[l].pagesY);
+        for (int y = pageY(page) << d; y < yEnd; ++y) {
+            for (int x = pageX(page) << d; x < xEnd; ++x) {
+                unsigned char* e = tableEntry(l, x, y);
+                if (e[2] >= level)
+                    std::memcpy(e, entry, 4);
+            }
+        }
+    }
+    m_tableDirty = true;
+}
+
+void VirtualTexture::unmapPage(std::uint32_t page)
+{
+    const std::vector<TiledImage::Level>& levels = m_layers[0].levels();
+    const int level = pageLevel(page);
+    unsigned char parent[4];
+    std::memcpy(parent, tableEntry(level + 1, pageX(page) >> 1, pageY(page) >> 1), 4);
+
+    for (int l = level; l >= 0; --l) {
+        const int d = level - l;
+        const int xEnd = std::min((pageX(page) + 1) << d, levels[l].pagesX);
+        const int yEnd = std::min((pageY(page) + 1) << d, levels[l].pagesY);
+        for (int y = pageY(page) << d; y < yEnd; ++y) {
+            for (int x = pageX(page) << d; x < xEnd; ++x) {
+                unsigned char* e = tableEntry(l, x, y);
+                if (e[2] == level)
+                    std::memcpy(e, parent, 4);
+            }
+        }
+    }
+    m_tableDirty = true;
+}
+
+void VirtualTexture::uploadTable()
+{
+    glTextureSubImage2D(m_pageTable, 0, 0, 0, m_tableWidth, m_tableHeight, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, m_table.data());
+    m_tableDirty = false;
+}
+
+void VirtualTexture::setUniforms(GLuint program) const
+{
+    // Level l: (first column in the page table, width, height, 0)
+    const std::vector<TiledImage::Level>& levels = m_layers[0].levels();
+    GLint info[MaxLevels * 4] = {};
+    for (std::size_t l = 0; l < levels.size(); ++l) {
+        info[l * 4 + 0] = m_tableOffsets[l];
+        info[l * 4 + 1] = levels[l].width;
+        info[l * 4 + 2] = levels[l].height;
+    }
+    glProgramUniform4iv(program, glGetUniformLocation(program, "vtLevels"), GLsizei(levels.size()), info);
+    glProgramUniform1i(program, glGetUniformLocation(program, "vtNumLevels"), GLint(levels.size()));
+    glProgramUniform1i(program, glGetUniformLocation(program, "vtPageSize"), m_layers[0].pageSize());
+    glProgramUniform1i(program, glGetUniformLocation(program, "vtBorder"), m_layers[0].border());
+}
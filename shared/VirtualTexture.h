@@ -0,0 +1,158 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PixelUploadRing.h"
+#include "TiledImage.h"
+
+// Texture larger than the video memory, paged on demand (virtual texturing).
+//
+// - The levels of the images are cut in pages (TiledImage). Only the pages seen
+//   on screen are copied in the slots of a physical texture of a fixed size. A
+//   page table texture (GL_RGBA8UI, one texel per page of each level) gives the
+//   slot of each page: (slot x, slot y, level, 0), the level being the one of its
+//   finest resident ancestor when the page itself is not resident.
+// - A low resolution feedback pass (VirtualTextureFeedback) writes the page each
+//   pixel needs. Its readback is given to requestPages(): a worker thread gathers
+//   the requested pages and their ancestors, and copies the missing ones from the
+//   mapped tiles files in a PixelUploadRing, the coarse levels first.
+// - update() uploads these pages from the ring and updates the page table. When
+//   the physical texture is full, the page least recently requested is evicted
+//   (LRU); the single page of the coarsest level always stays resident.
+// - The layers (diffuse, ARM, ...) are images of the same size sharing the page
+//   table: a page is resident in all their physical textures, at the same slot.
+// - The shaders sample the layers with the uniforms of setUniforms() (see
+//   exemples/09_Texture/virtual.frag). The edges of the pages wrap around, like GL_REPEAT.
+// - All the functions, except the destructor, are called on the rendering thread.
+class VirtualTexture
+{
+public:
+    // Size of the vtLevels uniform array of the shaders
+    static const int MaxLevels = 16;
+    static const std::size_t RingSize = 8 << 20;
+
+    struct Layer
+    {
+        std::string path;
+        TextureCache::ColorSpace colorSpace;
+    };
+
+    VirtualTexture() = default;
+    // Stop the worker thread (the OpenGL objects are not deleted here, see destroy())
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // ------------------------------------------------------------------------
+    // open the pages of the layers (building their tiles files the first time),
+    // create the textures with slotsX x slotsY slots (256 at most on each side)
+    // and make the coarsest page resident
+    // return false if an image cannot be loaded, if the layers differ in size, or
+    // if the sizes do not halve exactly down to the coarsest page (the pages of a
+    // level must then cover exactly 2x2 pages of the finer one)
+    bool create(const std::vector<Layer>& layers, int slotsX, int slotsY, int pageSize = 128);
+    // ------------------------------------------------------------------------
+    // stop the worker thread, delete the textures and the upload ring
+    void destroy();
+    bool isCreated() const { return m_pageTable != 0; }
+
+    // ------------------------------------------------------------------------
+    // pages written by the feedback pass (encodePage, 0 for none); the previous
+    // feedback is dropped if the worker has not started it yet
+    void requestPages(const std::vector<std::uint32_t>& feedback);
+    // ------------------------------------------------------------------------
+    // upload up to maxPages pages loaded by the worker, evicting the least
+    // recently requested ones, then the page table when it changed
+    // return the number of uploaded pages
+    std::size_t update(std::size_t maxPages = 16);
+
+    // ------------------------------------------------------------------------
+    // set vtLevels, vtNumLevels, vtPageSize and vtBorder in a program
+    void setUniforms(GLuint program) const;
+    GLuint physicalTexture(int layer) const { return m_physical[layer]; }
+    GLuint pageTable() const { return m_pageTable; }
+    const TiledImage& image(int layer) const { return m_layers[layer]; }
+
+    // Value written by the feedback pass, (level + 1) in the top byte so 0 is none
+    static std::uint32_t encodePage(int level, int x, int y)
+    {
+        return (std::uint32_t(level + 1) << 24) | (std::uint32_t(y) << 12) | std::uint32_t(x);
+    }
+
+    std::size_t numSlots() const { return m_slots.size(); }
+    std::size_t numResident() const { return m_resident.size(); }
+    std::size_t numEvictions() const { return m_numEvictions; }
+    // Pages (ancestors included) of the last feedback
+    std::size_t numRequested() const { return m_numRequested; }
+
+private:
+    struct Slot
+    {
+        std::uint32_t page = 0;    // encodePage, 0 when free
+        std::uint64_t lastUsed = 0; // Last feedback requesting the page
+    };
+
+    // Page copied in the ring by the worker, the layers one after the other
+    struct Loaded
+    {
+        std::uint32_t page;
+        std::size_t ringOffset;
+    };
+
+    // Worker thread
+    void run();
+
+    // Free slot, or the least recently used one not requested by the last feedback (-1 if none)
+    int findSlot() const;
+    // Point the page, and its descendants pointing to a coarser level, to a slot
+    void mapPage(std::uint32_t page, int slot);
+    // Point the page, and its descendants pointing to it, back to its parent
+    void unmapPage(std::uint32_t page);
+    unsigned char* tableEntry(int level, int x, int y);
+    void uploadTable();
+    // Distance between the layers of a page in the ring
+    std::size_t layerStride() const;
+
+private:
+    std::vector<TiledImage> m_layers;
+    std::vector<GLuint> m_physical; // One texture by layer
+    GLuint m_pageTable = 0;
+    int m_slotsX = 0;
+    int m_slotsY = 0;
+
+    // Shared with the worker
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_feedbackAvailable;
+    std::vector<std::uint32_t> m_feedback;
+    bool m_hasFeedback = false;
+    bool m_quit = false;
+    std::unordered_set<std::uint32_t> m_known; // Resident, or loaded and waiting for update()
+    std::vector<std::uint32_t> m_requested;    // Gathered from the last feedback
+    bool m_hasRequested = false;
+    std::deque<Loaded> m_loaded;
+    PixelUploadRing m_ring;                    // Filled by the worker (thread safe)
+
+    // Rendering thread only
+    std::vector<Slot> m_slots;
+    std::unordered_map<std::uint32_t, int> m_resident; // Slot of each resident page
+    std::vector<unsigned char> m_table;        // Content of the page table
+    std::vector<int> m_tableOffsets;           // First column of each level in the page table
+    int m_tableWidth = 0;
+    int m_tableHeight = 0;
+    bool m_tableDirty = false;
+    std::uint64_t m_frame = 0;                 // Feedbacks received
+    std::size_t m_numEvictions = 0;
+    std::size_t m_numRequested = 0;
+};
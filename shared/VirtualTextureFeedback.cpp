@@ -0,0 +1,103 @@
+#include "VirtualTextureFeedback.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool VirtualTextureFeedback::create(int width, int height, int downscale)
+{
+    destroy();
+
+    downscale = std::max(1, downscale);
+    m_width = std::max(1, width / downscale);
+    m_height = std::max(1, height / downscale);
+    m_lodBias = std::log2(float(downscale));
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_pages);
+    glTextureStorage2D(m_pages, 1, GL_R32UI, m_width, m_height);
+    glCreateRenderbuffers(1, &m_depth);
+    glNamedRenderbufferStorage(m_depth, GL_DEPTH_COMPONENT24, m_width, m_height);
+    glCreateFramebuffers(1, &m_framebuffer);
+    glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_pages, 0);
+    glNamedFramebufferRenderbuffer(m_framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+    if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Incomplete virtual texture feedback framebuffer" << std::endl;
+        destroy();
+        return false;
+    }
+
+    // Read by the CPU once the fence is signaled
+    for (Readback& readback : m_readbacks) {
+        glCreateBuffers(1, &readback.buffer);
+        glNamedBufferStorage(readback.buffer, GLsizeiptr(m_width) * m_height * sizeof(std::uint32_t), nullptr, GL_CLIENT_STORAGE_BIT);
+    }
+    return true;
+}
+
+void VirtualTextureFeedback::destroy()
+{
+    for (Readback& readback : m_readbacks) {
+        if (readback.fence != nullptr)
+            glDeleteSync(readback.fence);
+        if (readback.buffer != 0)
+            glDeleteBuffers(1, &readback.buffer);
+        readback = Readback();
+    }
+    if (m_framebuffer != 0)
+        glDeleteFramebuffers(1, &m_framebuffer);
+    if (m_pages != 0)
+        glDeleteTextures(1, &m_pages);
+    if (m_depth != 0)
+        glDeleteRenderbuffers(1, &m_depth);
+    m_framebuffer = 0;
+    m_pages = 0;
+    m_depth = 0;
+    m_next = 0;
+    m_oldest = 0;
+}
+
+void VirtualTextureFeedback::begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_width, m_height);
+    const GLuint none[4] = { 0, 0, 0, 0 };
+    const GLfloat depth = 1.0f;
+    glClearNamedFramebufferuiv(m_framebuffer, GL_COLOR, 0, none);
+    glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &depth);
+}
+
+void VirtualTextureFeedback::end()
+{
+    // All the readbacks in flight: this frame is skipped rather than waiting for the GPU
+    Readback& readback = m_readbacks[m_next];
+    if (readback.fence == nullptr) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glReadPixels(0, 0, m_width, m_height, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_next = (m_next + 1) % NumReadbacks;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool VirtualTextureFeedback::read(std::vector<std::uint32_t>& pages)
+{
+    // In issue order: only the latest complete one is copied
+    int latest = -1;
+    while (m_readbacks[m_oldest].fence != nullptr) {
+        Readback& readback = m_readbacks[m_oldest];
+        const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        latest = m_oldest;
+        m_oldest = (m_oldest + 1) % NumReadbacks;
+    }
+    if (latest < 0)
+        return false;
+
+    pages.resize(std::size_t(m_width) * m_height);
+    glGetNamedBufferSubData(m_readbacks[latest].buffer, 0, GLsizeiptr(pages.size() * sizeof(std::uint32_t)), pages.data());
+    return true;
+}
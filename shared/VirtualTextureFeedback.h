@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+// Render target of the feedback pass of the virtual textures: a low resolution
+// GL_R32UI buffer where each pixel gets the page its fragment needs
+// (VirtualTexture::encodePage, 0 where nothing is drawn).
+//
+// - The pass is drawn between begin() and end(), with a shader writing the pages
+//   (see exemples/09_Texture/feedback.frag) and lodBias() subtracted from its
+//   levels: each of its pixels covers downscale x downscale pixels of the screen.
+// - end() copies the buffer in a pixel pack buffer (glReadPixels) and inserts a
+//   fence; read() polls the fences of the previous frames, without waiting for
+//   the GPU, and gives the latest complete readback (for VirtualTexture::requestPages).
+// - All the functions are called on the rendering thread.
+class VirtualTextureFeedback
+{
+public:
+    // Readbacks in flight: a frame is skipped when all of them are
+    static const int NumReadbacks = 3;
+
+    VirtualTextureFeedback() = default;
+    // The OpenGL objects are not deleted here, see destroy()
+    ~VirtualTextureFeedback() = default;
+
+    VirtualTextureFeedback(const VirtualTextureFeedback&) = delete;
+    VirtualTextureFeedback& operator=(const VirtualTextureFeedback&) = delete;
+
+    // ------------------------------------------------------------------------
+    // create the buffers for a screen of width x height pixels
+    bool create(int width, int height, int downscale = 8);
+    void destroy();
+    bool isCreated() const { return m_framebuffer != 0; }
+
+    // ------------------------------------------------------------------------
+    // bind and clear the framebuffer of the pass, and set its viewport
+    void begin();
+    // ------------------------------------------------------------------------
+    // start the readback of the pass and bind the default framebuffer again
+    // (the viewport of the screen is restored by the caller)
+    void end();
+    // ------------------------------------------------------------------------
+    // latest readback complete since the last call
+    // return false if none
+    bool read(std::vector<std::uint32_t>& pages);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    // log2(downscale)
+    float lodBias() const { return m_lodBias; }
+
+private:
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr; // Pending until signaled and read
+    };
+
+private:
+    GLuint m_framebuffer = 0;
+    GLuint m_pages = 0; // GL_R32UI texture
+    GLuint m_depth = 0; // Renderbuffer
+    int m_width = 0;
+    int m_height = 0;
+    float m_lodBias = 0.0f;
+
+    Readback m_readbacks[NumReadbacks];
+    int m_next = 0;   // Used by the next end()
+    int m_oldest = 0; // Next one to complete
+};